@@ -20,7 +20,7 @@ macro(split_path_into_filename_and_parent_path FULLPATH NAME PATH)
 endmacro()
 
 macro(add_t1_test TEST_SRC_FILE)
-    set(_OPTIONS)
+    set(_OPTIONS PROFILING FUZZING IMPACT)
     set(_SINGLE_VAL_ARGS CPP_VERSION)
     set(_MULTI_VAL_ARGS INCLUDE_DIRS
                         LIBRARIES
@@ -57,6 +57,13 @@ macro(add_t1_test TEST_SRC_FILE)
             target_link_libraries(${TEST_NAME_} ${ADD_TEST_LIBRARIES})
         endif()
 
+        # t1 runs repeated units on multiple threads and uses dladdr to
+        # print allocation sites.
+        if (NOT WIN32)
+            find_package(Threads REQUIRED)
+            target_link_libraries(${TEST_NAME_} Threads::Threads ${CMAKE_DL_LIBS})
+        endif()
+
         if (DEFINED ADD_TEST_COMPILE_FLAGS)
             target_compile_options(${TEST_NAME_} PRIVATE ${ADD_TEST_COMPILE_FLAGS})
         endif()
@@ -69,6 +76,22 @@ macro(add_t1_test TEST_SRC_FILE)
             target_compile_options(${TEST_NAME_} PRIVATE ${ADD_TEST_CPP_WARNINGS})
         endif()
 
+        # --profile walks the stack using frame pointers
+        if (ADD_TEST_PROFILING AND NOT MSVC)
+            target_compile_options(${TEST_NAME_} PRIVATE -fno-omit-frame-pointer)
+        endif()
+
+        # coverage for --fuzz, see define_fuzz_target
+        if (ADD_TEST_FUZZING AND NOT MSVC)
+            target_compile_options(${TEST_NAME_} PRIVATE -fsanitize-coverage=trace-pc,trace-cmp)
+        endif()
+
+        # which functions each unit runs for --record-impact, FUZZING
+        # includes it
+        if (ADD_TEST_IMPACT AND NOT ADD_TEST_FUZZING AND NOT MSVC)
+            target_compile_options(${TEST_NAME_} PRIVATE -fsanitize-coverage=trace-pc)
+        endif()
+
         file(MAKE_DIRECTORY "${TEST_OUTPUT_DIR_}")
         set_target_properties("${TEST_NAME_}" PROPERTIES RUNTIME_OUTPUT_DIRECTORY "${TEST_OUTPUT_DIR_}")
         set_property(TARGET "${TEST_NAME_}" PROPERTY CXX_STANDARD ${ADD_TEST_CPP_VERSION})
@@ -97,10 +120,11 @@ endmacro()
 
 # default macro to add all .cpp files in a directory; use only if possible.
 # also adds all non-main sources of optional arguments as dependencies,
-# can get big quickly.
+# can get big quickly. files that already have a target are skipped, so
+# single tests can be added with different options first.
 # defines TEST_SOURCES
 macro(add_test_directory DIR)
-    set(_OPTIONS)
+    set(_OPTIONS PROFILING FUZZING IMPACT)
     set(_SINGLE_VAL_ARGS CPP_VERSION)
     set(_MULTI_VAL_ARGS INCLUDE_DIRS
                         COMPILE_FLAGS
@@ -119,8 +143,29 @@ macro(add_test_directory DIR)
     find_test_sources(TEST_SOURCES "${DIR}" "${CMAKE_CURRENT_LIST_DIR}" "*.cpp")
     find_test_non_main_source_deps(TEST_DEPS_ ${ADD_TEST_DIRECTORY_SOURCE_DEPS})
     
+    set(ADD_TEST_DIRECTORY_FLAGS_)
+
+    if (ADD_TEST_DIRECTORY_PROFILING)
+        list(APPEND ADD_TEST_DIRECTORY_FLAGS_ PROFILING)
+    endif()
+
+    if (ADD_TEST_DIRECTORY_FUZZING)
+        list(APPEND ADD_TEST_DIRECTORY_FLAGS_ FUZZING)
+    endif()
+
+    if (ADD_TEST_DIRECTORY_IMPACT)
+        list(APPEND ADD_TEST_DIRECTORY_FLAGS_ IMPACT)
+    endif()
+
     foreach(INPUT_FILE ${TEST_SOURCES})
-        add_t1_test("${INPUT_FILE}"
+        # tests added with add_t1_test before keep their own options
+        split_path_into_filename_and_parent_path(${INPUT_FILE} TEST_NAME_ TEST_PATH_)
+
+        if (TARGET "${TEST_NAME_}")
+            continue()
+        endif()
+
+        add_t1_test("${INPUT_FILE}" ${ADD_TEST_DIRECTORY_FLAGS_}
             CPP_VERSION ${ADD_TEST_DIRECTORY_CPP_VERSION}
             CPP_WARNINGS ${ADD_TEST_DIRECTORY_CPP_WARNINGS}
             INCLUDE_DIRS ${ADD_TEST_DIRECTORY_INCLUDE_DIRS}
@@ -131,6 +176,49 @@ macro(add_test_directory DIR)
     endforeach()
 endmacro()
 
+# registers every unit of the test target TARGET as its own CTest test named
+# <prefix><unit> (default prefix: "<target>."), so ctest -j can run units of
+# the same executable in parallel. the units are listed by running the
+# executable with --list after it was built. the tests have the properties
+# T1_UNIT, T1_FILE and T1_LINE.
+# register_tests doesn't add the targets it is called for as single tests,
+# call it before register_tests, e.g.
+#
+#    add_t1_test(tests/parser.cpp)
+#    t1_discover_tests(parser EXTRA_ARGS -c)
+#    register_tests()
+function(t1_discover_tests TARGET)
+    set(_OPTIONS)
+    set(_SINGLE_VAL_ARGS TEST_PREFIX WORKING_DIRECTORY)
+    set(_MULTI_VAL_ARGS EXTRA_ARGS)
+
+    cmake_parse_arguments(DISCOVER "${_OPTIONS}" "${_SINGLE_VAL_ARGS}" "${_MULTI_VAL_ARGS}" ${ARGN})
+
+    if (NOT DEFINED DISCOVER_TEST_PREFIX)
+        set(DISCOVER_TEST_PREFIX "${TARGET}.")
+    endif()
+
+    if (NOT DEFINED DISCOVER_WORKING_DIRECTORY)
+        set(DISCOVER_WORKING_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}")
+    endif()
+
+    set(CTEST_FILE_ "${CMAKE_CURRENT_BINARY_DIR}/${TARGET}_units.cmake")
+
+    add_custom_command(TARGET ${TARGET} POST_BUILD
+        BYPRODUCTS "${CTEST_FILE_}"
+        COMMAND "${CMAKE_COMMAND}"
+                -D "TEST_EXECUTABLE=$<TARGET_FILE:${TARGET}>"
+                -D "TEST_PREFIX=${DISCOVER_TEST_PREFIX}"
+                -D "TEST_WORKING_DIR=${DISCOVER_WORKING_DIRECTORY}"
+                -D "TEST_EXTRA_ARGS=${DISCOVER_EXTRA_ARGS}"
+                -D "CTEST_FILE=${CTEST_FILE_}"
+                -P "${_t1Config_CMAKE_DIR}/t1DiscoverTests.cmake"
+        VERBATIM)
+
+    set_property(DIRECTORY APPEND PROPERTY TEST_INCLUDE_FILES "${CTEST_FILE_}")
+    set_property(GLOBAL APPEND PROPERTY T1_DISCOVERED_TARGETS "${TARGET}")
+endfunction()
+
 # adds a command to build all tests and a command to run all tests
 macro(register_tests)
     if (NOT TARGET tests)
@@ -153,11 +241,17 @@ macro(register_tests)
         add_custom_target(valgrindtests)
     endif()
 
+    # targets of t1_discover_tests already have a test per unit
+    get_property(DISCOVERED_TARGETS_ GLOBAL PROPERTY T1_DISCOVERED_TARGETS)
+
     foreach(EXE ${T1_TEST_EXECUTABLES})
         split_path_into_filename_and_parent_path(${EXE} TEST_NAME_ TEST_PATH_)
 
         if (NOT TARGET "run${TEST_NAME_}")
-            add_test(NAME "${TEST_NAME_}" COMMAND "${EXE}")
+            if (NOT "${TEST_NAME_}" IN_LIST DISCOVERED_TARGETS_)
+                add_test(NAME "${TEST_NAME_}" COMMAND "${EXE}")
+            endif()
+
             add_custom_target("run${TEST_NAME_}" COMMAND "${EXE}")
             add_dependencies(runtests "run${TEST_NAME_}")
 
@@ -0,0 +1,42 @@
+
+# run by t1_discover_tests after a test executable was built, writes a CTest
+# file that adds one test per unit listed by "<executable> --list".
+# expects TEST_EXECUTABLE, TEST_PREFIX, TEST_WORKING_DIR, TEST_EXTRA_ARGS
+# and CTEST_FILE to be defined.
+
+execute_process(COMMAND "${TEST_EXECUTABLE}" --list
+                WORKING_DIRECTORY "${TEST_WORKING_DIR}"
+                OUTPUT_VARIABLE _t1_LIST_OUTPUT
+                RESULT_VARIABLE _t1_LIST_RESULT)
+
+set(_t1_CTEST_CONTENT "")
+
+if (NOT _t1_LIST_RESULT EQUAL 0)
+    message(WARNING "t1: could not list units of ${TEST_EXECUTABLE}, adding it as a single test.")
+    string(APPEND _t1_CTEST_CONTENT
+           "add_test([==[${TEST_PREFIX}all]==] [==[${TEST_EXECUTABLE}]==] ${TEST_EXTRA_ARGS})\n"
+           "set_tests_properties([==[${TEST_PREFIX}all]==] PROPERTIES WORKING_DIRECTORY [==[${TEST_WORKING_DIR}]==])\n")
+else()
+    string(REPLACE "\n" ";" _t1_LINES "${_t1_LIST_OUTPUT}")
+
+    foreach(_t1_LINE IN LISTS _t1_LINES)
+        if (_t1_LINE STREQUAL "")
+            continue()
+        endif()
+
+        # <name>\t<file>\t<line>
+        string(REPLACE "\t" ";" _t1_FIELDS "${_t1_LINE}")
+        list(GET _t1_FIELDS 0 _t1_UNIT)
+        list(GET _t1_FIELDS 1 _t1_FILE)
+        list(GET _t1_FIELDS 2 _t1_UNIT_LINE)
+
+        set(_t1_TEST "${TEST_PREFIX}${_t1_UNIT}")
+
+        string(APPEND _t1_CTEST_CONTENT
+               "add_test([==[${_t1_TEST}]==] [==[${TEST_EXECUTABLE}]==] --filter [==[${_t1_UNIT}]==] ${TEST_EXTRA_ARGS})\n"
+               "set_tests_properties([==[${_t1_TEST}]==] PROPERTIES WORKING_DIRECTORY [==[${TEST_WORKING_DIR}]==]"
+               " T1_UNIT [==[${_t1_UNIT}]==] T1_FILE [==[${_t1_FILE}]==] T1_LINE ${_t1_UNIT_LINE})\n")
+    endforeach()
+endif()
+
+file(WRITE "${CTEST_FILE}" "${_t1_CTEST_CONTENT}")
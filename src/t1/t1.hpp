@@ -10,10 +10,14 @@
 #define access      __builtin_access
 #define close       __builtin_close
 #define open        __builtin_open
+#define openat      __builtin_openat
 #define read        __builtin_read
 #define write       __builtin_write
 #define pread64     __builtin_pread64
 #define pwrite64    __builtin_pwrite64
+#define lseek       __builtin_lseek
+#define mkdir       __builtin_mkdir
+#define mkdirat     __builtin_mkdirat
 #define chown       __builtin_chown
 #define fchown      __builtin_fchown
 #define fchownat    __builtin_fchownat
@@ -101,6 +105,56 @@ typedef PVOID (*t1_f_MapViewOfFile3)(
 #include <sys/syscall.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#endif
+
+#if t1_Linux
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#include <ucontext.h>
+#include <link.h>
+#include <elf.h>
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+#endif
+
+// async tests need C++20 coroutines and epoll
+#if t1_Linux && defined(__cpp_impl_coroutine)
+#define t1_ASYNC 1
+#include <coroutine>
+#include <sys/epoll.h>
+#else
+#define t1_ASYNC 0
+#endif
+
+// guarding allocations needs the allocation hooks
+#if defined(t1_guard_allocations) && !defined(t1_track_allocations)
+#define t1_track_allocations
+#endif
+
+#ifdef t1_track_allocations
+#include <new>
+#if t1_Linux
+#include <malloc.h>
+#include <dlfcn.h>
+#endif
+#endif
+
+#if t1_MSVC
+#include <intrin.h>
 #endif
 
 #ifdef t1_shadow_stdlib
@@ -125,10 +179,14 @@ typedef PVOID (*t1_f_MapViewOfFile3)(
 #undef sync
 #undef truncate
 #undef ftruncate
+#undef mkdirat
+#undef mkdir
+#undef lseek
 #undef pwrite64
 #undef pread64
 #undef write
 #undef read
+#undef openat
 #undef open
 #undef close
 #undef access
@@ -136,8 +194,63 @@ typedef PVOID (*t1_f_MapViewOfFile3)(
 #undef renameat
 #undef rename
 #undef printf
+
+// t1 defines the shadowed functions, see VIRTUAL FILESYSTEM
+#if t1_Linux
+#define t1_VFS 1
+
+// same exception specification as the glibc declarations
+#ifdef __THROW
+#define _t1_THROW __THROW
+#else
+#define _t1_THROW
+#endif
+
+extern "C"
+{
+int rename(const char *old_path, const char *new_path) _t1_THROW;
+int renameat(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path) _t1_THROW;
+int renameat2(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, unsigned int flags) _t1_THROW;
+int access(const char *path, int mode) _t1_THROW;
+int close(int fd);
+int open(const char *path, int flags, ...);
+int openat(int dirfd, const char *path, int flags, ...);
+ssize_t read(int fd, void *buf, size_t size);
+ssize_t write(int fd, const void *buf, size_t size);
+ssize_t pread64(int fd, void *buf, size_t size, off64_t offset);
+ssize_t pwrite64(int fd, const void *buf, size_t size, off64_t offset);
+off_t lseek(int fd, off_t offset, int whence) _t1_THROW;
+int mkdir(const char *path, mode_t mode) _t1_THROW;
+int mkdirat(int dirfd, const char *path, mode_t mode) _t1_THROW;
+int chown(const char *path, uid_t owner, gid_t group) _t1_THROW;
+int fchown(int fd, uid_t owner, gid_t group) _t1_THROW;
+int fchownat(int dirfd, const char *path, uid_t owner, gid_t group, int flags) _t1_THROW;
+int chdir(const char *path) _t1_THROW;
+int fchdir(int fd) _t1_THROW;
+char *getcwd(char *buf, size_t size) _t1_THROW;
+int link(const char *old_path, const char *new_path) _t1_THROW;
+int linkat(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, int flags) _t1_THROW;
+int symlink(const char *target, const char *link_path) _t1_THROW;
+int symlinkat(const char *target, int new_dirfd, const char *link_path) _t1_THROW;
+ssize_t readlink(const char *path, char *buf, size_t size) _t1_THROW;
+ssize_t readlinkat(int dirfd, const char *path, char *buf, size_t size) _t1_THROW;
+int unlink(const char *path) _t1_THROW;
+int unlinkat(int dirfd, const char *path, int flags) _t1_THROW;
+int rmdir(const char *path) _t1_THROW;
+int chroot(const char *path) _t1_THROW;
+int fsync(int fd);
+int fdatasync(int fd);
+void sync() _t1_THROW;
+int truncate(const char *path, off_t length) _t1_THROW;
+int ftruncate(int fd, off_t length) _t1_THROW;
+}
+#endif
 #endif // t1_shadow_stdlib
 
+#ifndef t1_VFS
+#define t1_VFS 0
+#endif
+
 // ---------- MACROS ----------
 #ifndef JOIN
 #define JOIN(X, Y) X##Y
@@ -206,6 +319,22 @@ typedef int t1_io_handle;
 #define _stderr()   STDERR_FILENO
 #endif
 
+// the virtual filesystem and the fault schedule the shadowed I/O functions
+// of this thread use, see VIRTUAL FILESYSTEM and FAULT INJECTION. t1's own
+// I/O suspends both, it always reaches the real files.
+struct t1_vfs;
+struct t1_faults;
+
+static thread_local t1_vfs *_t1_current_vfs = nullptr;
+static thread_local t1_faults *_t1_current_faults = nullptr;
+
+#define _t1_SUSPEND_HOOKS() \
+    t1_vfs *_t1_suspended_vfs = _t1_current_vfs;\
+    t1_faults *_t1_suspended_faults = _t1_current_faults;\
+    _t1_current_vfs = nullptr;\
+    _t1_current_faults = nullptr;\
+    defer { _t1_current_vfs = _t1_suspended_vfs; _t1_current_faults = _t1_suspended_faults; }
+
 static s64 t1_io_write(t1_io_handle h, void *buf, u64 size)
 {
     s64 ret = 0;
@@ -218,6 +347,7 @@ static s64 t1_io_write(t1_io_handle h, void *buf, u64 size)
 
     ret = tmp;
 #else
+    _t1_SUSPEND_HOOKS();
     ret = ::write(h, buf, size);
 #endif
 
@@ -295,6 +425,83 @@ static auto t1_ceil_multiple2(T1 x, T2 multiple)
     return (x + (multiple - 1)) & (-multiple);
 }
 
+// ---------- ATOMICS ----------
+// sequentially consistent, good enough for counters and flags.
+template<typename T>
+static inline T t1_atomic_load(T *x)
+{
+#if t1_MSVC
+    T ret = *(volatile T*)x;
+    _ReadWriteBarrier();
+    return ret;
+#else
+    return __atomic_load_n(x, __ATOMIC_SEQ_CST);
+#endif
+}
+
+template<typename T>
+static inline void t1_atomic_store(T *x, T val)
+{
+#if t1_MSVC
+    _ReadWriteBarrier();
+    *(volatile T*)x = val;
+    MemoryBarrier();
+#else
+    __atomic_store_n(x, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// returns the new value
+template<typename T>
+static inline T t1_atomic_add(T *x, T val)
+{
+#if t1_MSVC
+    if constexpr (sizeof(T) == 8)
+        return (T)_InterlockedExchangeAdd64((volatile long long*)x, (long long)val) + val;
+    else
+        return (T)_InterlockedExchangeAdd((volatile long*)x, (long)val) + val;
+#else
+    return __atomic_add_fetch(x, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// on failure, *expected is set to the current value
+template<typename T>
+static inline bool t1_atomic_compare_exchange(T *x, T *expected, T desired)
+{
+#if t1_MSVC
+    T prev;
+
+    if constexpr (sizeof(T) == 8)
+        prev = (T)_InterlockedCompareExchange64((volatile long long*)x, (long long)desired, (long long)*expected);
+    else if constexpr (sizeof(T) == 4)
+        prev = (T)_InterlockedCompareExchange((volatile long*)x, (long)desired, (long)*expected);
+    else
+        prev = (T)_InterlockedCompareExchange8((volatile char*)x, (char)desired, (char)*expected);
+
+    if (prev == *expected)
+        return true;
+
+    *expected = prev;
+    return false;
+#else
+    return __atomic_compare_exchange_n(x, expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+static void _t1_spin_lock(u32 *lock)
+{
+    u32 expected = 0;
+
+    while (!t1_atomic_compare_exchange(lock, &expected, 1u))
+        expected = 0;
+}
+
+static void _t1_spin_unlock(u32 *lock)
+{
+    t1_atomic_store(lock, 0u);
+}
+
 // ---------- MEMORY ----------
 static void *t1_reallocate_memory(void *ptr, u64 size)
 {
@@ -337,6 +544,7 @@ static bool init(t1_ring_buffer *buf, u64 min_size, u32 mapping_count = 3)
     u64 pagesize = (u64)sysconf(_SC_PAGESIZE);
     u64 actual_size = t1_ceil_multiple2(min_size, pagesize);
 
+    _t1_SUSPEND_HOOKS();
     int anonfd = _memfd_create("t1_ringbuf", 0);
 
     if (anonfd == -1)
@@ -592,6 +800,194 @@ static void free(t1_array<T> *arr)
     arr->reserved_size = 0;
 }
 
+// ---------- THREADS ----------
+typedef void (*t1_thread_function)(void *arg);
+
+struct t1_thread
+{
+#if t1_Windows
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    t1_thread_function function;
+    void *arg;
+};
+
+// frees thread local state of t1, called when threads started with
+// t1_thread_start exit.
+static void _t1_thread_exit_cleanup();
+
+#if t1_Windows
+static DWORD WINAPI _t1_thread_entry(LPVOID param)
+#else
+static void *_t1_thread_entry(void *param)
+#endif
+{
+    t1_thread *t = (t1_thread*)param;
+    t->function(t->arg);
+
+    _t1_thread_exit_cleanup();
+
+#if t1_Windows
+    return 0;
+#else
+    return nullptr;
+#endif
+}
+
+// t must stay valid until t1_thread_join is called.
+static bool t1_thread_start(t1_thread *t, t1_thread_function function, void *arg)
+{
+    t->function = function;
+    t->arg = arg;
+
+#if t1_Windows
+    t->handle = CreateThread(nullptr, 0, _t1_thread_entry, t, 0, nullptr);
+    return t->handle != nullptr;
+#else
+    return pthread_create(&t->handle, nullptr, _t1_thread_entry, t) == 0;
+#endif
+}
+
+static void t1_thread_join(t1_thread *t)
+{
+#if t1_Windows
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#else
+    pthread_join(t->handle, nullptr);
+#endif
+}
+
+static u32 t1_get_processor_count()
+{
+#if t1_Windows
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (u32)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (u32)n : 1;
+#endif
+}
+
+// pins the calling thread to the given processor, returns false if that's
+// not possible (or not supported).
+static bool t1_thread_pin(u32 processor)
+{
+#if t1_Windows
+    if (processor >= 64)
+        return false;
+
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor) != 0;
+#elif t1_Linux
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(processor, &set);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)processor;
+    return false;
+#endif
+}
+
+// the processor the n-th of several pinned threads should run on, one of
+// those the process may run on (its cpuset). -1 if unknown.
+static s32 t1_allowed_processor(u32 n)
+{
+#if t1_Linux
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (sched_getaffinity(::getpid(), sizeof(set), &set) != 0)
+        return -1;
+
+    int count = CPU_COUNT(&set);
+
+    if (count <= 0)
+        return -1;
+
+    n %= (u32)count;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if (CPU_ISSET(cpu, &set) && n-- == 0)
+            return cpu;
+
+    return -1;
+#else
+    return (s32)(n % t1_get_processor_count());
+#endif
+}
+
+static inline void t1_thread_yield()
+{
+#if t1_Windows
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+// hint for spin loops
+static inline void t1_cpu_pause()
+{
+#if t1_MSVC
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+struct t1_barrier
+{
+    u32 count;      // number of threads that wait
+    u32 waiting;
+    u32 generation;
+    u32 max_spins;
+};
+
+static void init(t1_barrier *b, u32 count)
+{
+    b->count = count;
+    b->waiting = 0;
+    b->generation = 0;
+
+    // spinning only helps if every waiting thread has a processor
+    b->max_spins = count <= t1_get_processor_count() ? 4096 : 0;
+}
+
+// blocks until count threads are waiting, then releases all of them at once.
+// spins briefly before yielding, so threads that fit on the processors leave
+// the barrier at very nearly the same time.
+static void t1_barrier_wait(t1_barrier *b)
+{
+    u32 generation = t1_atomic_load(&b->generation);
+
+    if (t1_atomic_add(&b->waiting, 1u) == b->count)
+    {
+        t1_atomic_store(&b->waiting, 0u);
+        t1_atomic_add(&b->generation, 1u);
+        return;
+    }
+
+    u32 spins = 0;
+
+    while (t1_atomic_load(&b->generation) == generation)
+    {
+        if (spins < b->max_spins)
+        {
+            t1_cpu_pause();
+            spins++;
+        }
+        else
+            t1_thread_yield();
+    }
+}
+
 // ---------- STRINGS ----------
 struct t1_string
 {
@@ -600,6 +996,8 @@ struct t1_string
 };
 
 // ---------- FORMAT ----------
+static void _t1_format_buffer_cleanup();
+
 #define t1_TFORMAT_RING_BUFFER_MIN_SIZE 16384
 
 struct t1_tformat_buffer
@@ -608,11 +1006,11 @@ struct t1_tformat_buffer
     u64 offset;
 };
 
-static void _t1_format_buffer_cleanup();
-
+// one buffer per thread, threads started with t1_thread_start free theirs on exit.
 static t1_tformat_buffer *_get_static_format_buffer(bool free_buffer = false)
 {
-    static t1_tformat_buffer _buf{};
+    static thread_local t1_tformat_buffer _buf{};
+    static bool _cleanup_registered = false;
 
     if (free_buffer && _buf.buffer.data != nullptr)
     {
@@ -624,7 +1022,10 @@ static t1_tformat_buffer *_get_static_format_buffer(bool free_buffer = false)
         if (!init(&_buf.buffer, t1_TFORMAT_RING_BUFFER_MIN_SIZE, 2))
             return nullptr;
 
-        ::atexit(_t1_format_buffer_cleanup);
+        bool expected = false;
+
+        if (t1_atomic_compare_exchange(&_cleanup_registered, &expected, true))
+            ::atexit(_t1_format_buffer_cleanup);
     }
 
     return &_buf;
@@ -674,108 +1075,938 @@ static t1_string t1_tprintf(const char *fmt, ...)
     return ret;
 }
 
-// ---------- OUTPUT ----------
-static void t1_printf(const char *fmt, ...)
+// ---------- REPORTER ----------
+// with --async-output the threads running units don't write their output
+// themselves. every thread pushes its formatted output into its own
+// single-producer / single-consumer queue, which is a ring buffer mapped twice
+// so that neither pushing nor popping ever has to wrap around, and a reporter
+// thread drains all queues and does the actual (possibly slow) write calls.
+#define t1_REPORTER_QUEUE_MIN_SIZE 65536
+#define t1_REPORTER_MAX_QUEUES 256
+
+struct t1_spsc_queue
 {
-    va_list args;
+    t1_ring_buffer buffer;
+    u64 head; // total bytes pushed, only written by the producer
+    u64 tail; // total bytes popped, only written by the consumer
+};
 
-    va_start(args, fmt);
-    t1_string ret = t1_tvprintf(fmt, args);
-    va_end(args);
+static bool init(t1_spsc_queue *q, u64 min_size)
+{
+    q->head = 0;
+    q->tail = 0;
 
-    if (ret.size > 0)
-        t1_io_write(_stdout(), ret.data, ret.size);
+    return init(&q->buffer, min_size, 2);
 }
 
-#define printf t1_printf
-
-[[maybe_unused]] static t1_string _t1_to_string(bool x)
+static void free(t1_spsc_queue *q)
 {
-    if (x)
-        return t1_string{(char*)"true", 4};
-    else
-        return t1_string{(char*)"false", 5};
+    free(&q->buffer);
 }
 
-#define define_t1_to_string(TypedVal, Format, ...)\
-[[maybe_unused]] t1_string _t1_to_string(TypedVal)\
-{\
-    return t1_tprintf(Format __VA_OPT__(,) __VA_ARGS__);\
+static void _t1_nap(u32 microseconds)
+{
+#if t1_Windows
+    Sleep(microseconds / 1000 > 0 ? microseconds / 1000 : 1);
+#else
+    ::usleep(microseconds);
+#endif
 }
 
-#define define_direct_t1_to_string(Type, Format)\
-    define_t1_to_string(Type x, Format, x)
+// pushes size bytes, size must not be larger than the queue.
+// waits for the consumer while the queue is full.
+static void t1_spsc_push(t1_spsc_queue *q, const char *data, u64 size)
+{
+    u64 head = q->head;
 
-define_direct_t1_to_string(char,               "%c");
-define_direct_t1_to_string(unsigned char,      "%hhu");
-define_direct_t1_to_string(signed char,        "%hhd");
-define_direct_t1_to_string(short,              "%hd");
-define_direct_t1_to_string(unsigned short,     "%hu");
-define_direct_t1_to_string(int,                "%d");
-define_direct_t1_to_string(unsigned int,       "%u");
-define_direct_t1_to_string(long,               "%ld");
-define_direct_t1_to_string(unsigned long,      "%lu");
-define_direct_t1_to_string(long long,          "%lld");
-define_direct_t1_to_string(unsigned long long, "%llu");
+    while (head + size - t1_atomic_load(&q->tail) > q->buffer.size)
+        _t1_nap(50);
 
-define_direct_t1_to_string(float, "%.f");
-define_direct_t1_to_string(double, "%.lf");
-define_direct_t1_to_string(void*, "%p");
-define_direct_t1_to_string(char*, "%s");
-define_direct_t1_to_string(const char*, "%s");
-#if t1_Windows
-define_direct_t1_to_string(wchar_t*, "%ws");
-define_direct_t1_to_string(const wchar_t *, "%ws");
-#endif
+    ::memcpy(q->buffer.data + (head % q->buffer.size), data, size);
+    t1_atomic_store(&q->head, head + size);
+}
 
-void t1_set_unprintable_was_called();
+// returns all bytes that can currently be read as one contiguous range,
+// call t1_spsc_pop with however many of them were consumed.
+static t1_string t1_spsc_peek(t1_spsc_queue *q)
+{
+    u64 tail = q->tail;
+    u64 head = t1_atomic_load(&q->head);
 
-[[maybe_unused]] static t1_string t1_to_string(...)
+    return t1_string{q->buffer.data + (tail % q->buffer.size), head - tail};
+}
+
+static void t1_spsc_pop(t1_spsc_queue *q, u64 size)
 {
-    static char _unprintable[] = "<unprintable>";
-    t1_set_unprintable_was_called();
-    return t1_string{_unprintable, 13};
+    t1_atomic_store(&q->tail, q->tail + size);
 }
 
-template<typename T>
-static auto t1_to_string(T val)
-    -> decltype(_t1_to_string(val))
+struct _t1_reporter
 {
-    return _t1_to_string(val);
+    bool running;
+    bool stopping;
+    t1_thread thread;
+
+    u32 lock; // guards queues, not the queue contents
+    t1_spsc_queue *queues[t1_REPORTER_MAX_QUEUES];
+    u32 queue_count;
+};
+
+static _t1_reporter *_t1_get_reporter()
+{
+    static _t1_reporter _reporter{};
+    return &_reporter;
 }
 
-// ---------- MISC ----------
-const char *t1_get_filename(const char *path)
+// writes everything that is queued right now, returns the number of bytes written.
+static u64 _t1_reporter_drain(_t1_reporter *r)
 {
-    if (path == nullptr)
-        return nullptr;
+    u64 written = 0;
 
-    const char *last_slash = nullptr;
+    _t1_spin_lock(&r->lock);
 
-    while (*path != '\0')
+    for (u32 i = 0; i < r->queue_count; ++i)
     {
-        bool is_sep = false;
+        t1_spsc_queue *q = r->queues[i];
+        t1_string pending = t1_spsc_peek(q);
 
-#if t1_Windows
-        is_sep = (*path == '/' || *path == '\\');
-#else
-        is_sep = (*path == '/');
-#endif
+        while (pending.size > 0)
+        {
+            s64 n = t1_io_write(_stdout(), pending.data, pending.size);
 
-        if (is_sep)
-            last_slash = path;
-        
-        path++;
+            // the output is gone (e.g. closed pipe), drop it instead of spinning
+            if (n <= 0)
+                n = (s64)pending.size;
+
+            t1_spsc_pop(q, (u64)n);
+            written += (u64)n;
+            pending.data += n;
+            pending.size -= (u64)n;
+        }
     }
 
-    if (last_slash == nullptr)
-        return path;
+    _t1_spin_unlock(&r->lock);
 
-    return last_slash + 1;
+    return written;
 }
 
-// ---------- TESTS ----------
-#if t1_Windows && !defined(__MINGW32__)
+static void _t1_reporter_main(void *arg)
+{
+    _t1_reporter *r = (_t1_reporter*)arg;
+    u32 sleep_us = 50;
+
+    while (true)
+    {
+        // read before draining so nothing pushed before stopping is lost
+        bool stopping = t1_atomic_load(&r->stopping);
+
+        if (_t1_reporter_drain(r) > 0)
+            sleep_us = 50;
+        else if (stopping)
+            break;
+        else
+        {
+            _t1_nap(sleep_us);
+
+            if (sleep_us < 1000)
+                sleep_us *= 2;
+        }
+    }
+}
+
+static bool _t1_reporter_queue_empty(_t1_reporter *r, t1_spsc_queue *q)
+{
+    return !t1_atomic_load(&r->running) || t1_spsc_peek(q).size == 0;
+}
+
+// returns whether it was enabled, see ALLOCATIONS
+static bool _t1_set_allocation_tracking(bool enabled);
+
+// the queue of the calling thread, registered with the reporter on first use.
+// returns nullptr if the reporter isn't running or the queue couldn't be made.
+static t1_spsc_queue *_t1_get_reporter_queue(bool release = false)
+{
+    static thread_local t1_spsc_queue *_queue = nullptr;
+    _t1_reporter *r = _t1_get_reporter();
+
+    if (release)
+    {
+        if (_queue == nullptr)
+            return nullptr;
+
+        while (!_t1_reporter_queue_empty(r, _queue))
+            _t1_nap(50);
+
+        _t1_spin_lock(&r->lock);
+
+        for (u32 i = 0; i < r->queue_count; ++i)
+        if (r->queues[i] == _queue)
+        {
+            r->queues[i] = r->queues[--r->queue_count];
+            break;
+        }
+
+        _t1_spin_unlock(&r->lock);
+
+        free(_queue);
+        ::free(_queue);
+        _queue = nullptr;
+
+        return nullptr;
+    }
+
+    if (!t1_atomic_load(&r->running))
+        return nullptr;
+
+    if (_queue != nullptr)
+        return _queue;
+
+    // the queue is t1's, not an allocation of the unit that prints first
+    bool tracking = _t1_set_allocation_tracking(false);
+    defer { _t1_set_allocation_tracking(tracking); };
+
+    t1_spsc_queue *q = (t1_spsc_queue*)::malloc(sizeof(t1_spsc_queue));
+
+    if (q == nullptr)
+        return nullptr;
+
+    if (!init(q, t1_REPORTER_QUEUE_MIN_SIZE))
+    {
+        ::free(q);
+        return nullptr;
+    }
+
+    bool added = false;
+
+    _t1_spin_lock(&r->lock);
+
+    if (r->queue_count < t1_REPORTER_MAX_QUEUES)
+    {
+        r->queues[r->queue_count++] = q;
+        added = true;
+    }
+
+    _t1_spin_unlock(&r->lock);
+
+    if (!added)
+    {
+        free(q);
+        ::free(q);
+        return nullptr;
+    }
+
+    _queue = q;
+    return _queue;
+}
+
+// waits until everything queued so far has been written.
+// call before anything else writes to or redirects stdout.
+static void t1_reporter_flush()
+{
+    _t1_reporter *r = _t1_get_reporter();
+
+    if (!t1_atomic_load(&r->running))
+        return;
+
+    while (true)
+    {
+        bool empty = true;
+
+        _t1_spin_lock(&r->lock);
+
+        for (u32 i = 0; i < r->queue_count; ++i)
+        if (t1_spsc_peek(r->queues[i]).size > 0)
+        {
+            empty = false;
+            break;
+        }
+
+        _t1_spin_unlock(&r->lock);
+
+        if (empty)
+            break;
+
+        _t1_nap(50);
+    }
+}
+
+static void t1_reporter_stop();
+
+// starts the reporter thread. the reporter is started at most once per process
+// and stopped at exit at the latest.
+static bool t1_reporter_start()
+{
+    _t1_reporter *r = _t1_get_reporter();
+
+    if (t1_atomic_load(&r->running) || r->thread.function != nullptr)
+        return false;
+
+    t1_atomic_store(&r->running, true);
+
+    if (!t1_thread_start(&r->thread, _t1_reporter_main, r))
+    {
+        t1_atomic_store(&r->running, false);
+        return false;
+    }
+
+    ::atexit(t1_reporter_stop);
+
+    return true;
+}
+
+// writes all queued output and joins the reporter thread, output is written
+// directly afterwards.
+static void t1_reporter_stop()
+{
+    _t1_reporter *r = _t1_get_reporter();
+
+    if (!t1_atomic_load(&r->running))
+        return;
+
+    t1_reporter_flush();
+    t1_atomic_store(&r->stopping, true);
+    t1_thread_join(&r->thread);
+
+    _t1_get_reporter_queue(true);
+    t1_atomic_store(&r->running, false);
+
+    // queues of threads that weren't started with t1_thread_start
+    for (u32 i = 0; i < r->queue_count; ++i)
+    {
+        free(r->queues[i]);
+        ::free(r->queues[i]);
+    }
+
+    r->queue_count = 0;
+}
+
+// the reporter thread and the temporary strings are shared with the parent
+// after fork, a forked process that runs units gets its own.
+static void _t1_reset_forked_process()
+{
+    t1_atomic_store(&_t1_get_reporter()->running, false);
+    _t1_format_buffer_cleanup();
+}
+
+// writes output through the reporter if it is running, directly otherwise.
+static void t1_output_write(const char *data, u64 size)
+{
+    if (size == 0)
+        return;
+
+    t1_spsc_queue *q = _t1_get_reporter_queue();
+
+    if (q == nullptr)
+    {
+        t1_io_write(_stdout(), (void*)data, size);
+        return;
+    }
+
+    while (size > 0)
+    {
+        u64 chunk = size < q->buffer.size ? size : q->buffer.size;
+
+        t1_spsc_push(q, data, chunk);
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+// ---------- OUTPUT ----------
+static void t1_printf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    t1_string ret = t1_tvprintf(fmt, args);
+    va_end(args);
+
+    t1_output_write(ret.data, ret.size);
+}
+
+#define printf t1_printf
+
+[[maybe_unused]] static t1_string _t1_to_string(bool x)
+{
+    if (x)
+        return t1_string{(char*)"true", 4};
+    else
+        return t1_string{(char*)"false", 5};
+}
+
+#define define_t1_to_string(TypedVal, Format, ...)\
+[[maybe_unused]] t1_string _t1_to_string(TypedVal)\
+{\
+    return t1_tprintf(Format __VA_OPT__(,) __VA_ARGS__);\
+}
+
+#define define_direct_t1_to_string(Type, Format)\
+    define_t1_to_string(Type x, Format, x)
+
+define_direct_t1_to_string(char,               "%c");
+define_direct_t1_to_string(unsigned char,      "%hhu");
+define_direct_t1_to_string(signed char,        "%hhd");
+define_direct_t1_to_string(short,              "%hd");
+define_direct_t1_to_string(unsigned short,     "%hu");
+define_direct_t1_to_string(int,                "%d");
+define_direct_t1_to_string(unsigned int,       "%u");
+define_direct_t1_to_string(long,               "%ld");
+define_direct_t1_to_string(unsigned long,      "%lu");
+define_direct_t1_to_string(long long,          "%lld");
+define_direct_t1_to_string(unsigned long long, "%llu");
+
+define_direct_t1_to_string(float, "%.f");
+define_direct_t1_to_string(double, "%.lf");
+define_direct_t1_to_string(void*, "%p");
+define_direct_t1_to_string(char*, "%s");
+define_direct_t1_to_string(const char*, "%s");
+#if t1_Windows
+define_direct_t1_to_string(wchar_t*, "%ws");
+define_direct_t1_to_string(const wchar_t *, "%ws");
+#endif
+
+void t1_set_unprintable_was_called();
+
+[[maybe_unused]] static t1_string t1_to_string(...)
+{
+    static char _unprintable[] = "<unprintable>";
+    t1_set_unprintable_was_called();
+    return t1_string{_unprintable, 13};
+}
+
+template<typename T>
+static auto t1_to_string(T val)
+    -> decltype(_t1_to_string(val))
+{
+    return _t1_to_string(val);
+}
+
+// ---------- MISC ----------
+const char *t1_get_filename(const char *path)
+{
+    if (path == nullptr)
+        return nullptr;
+
+    const char *start = path;
+    const char *last_slash = nullptr;
+
+    while (*path != '\0')
+    {
+        bool is_sep = false;
+
+#if t1_Windows
+        is_sep = (*path == '/' || *path == '\\');
+#else
+        is_sep = (*path == '/');
+#endif
+
+        if (is_sep)
+            last_slash = path;
+        
+        path++;
+    }
+
+    if (last_slash == nullptr)
+        return start;
+
+    return last_slash + 1;
+}
+
+// supports * and ?
+static bool t1_glob_match(const char *pattern, const char *str)
+{
+    const char *star = nullptr;
+    const char *backtrack = nullptr;
+
+    while (*str != '\0')
+    {
+        if (*pattern == '*')
+        {
+            star = ++pattern;
+            backtrack = str;
+        }
+        else if (*pattern == '?' || *pattern == *str)
+        {
+            pattern++;
+            str++;
+        }
+        else if (star != nullptr)
+        {
+            pattern = star;
+            str = ++backtrack;
+        }
+        else
+            return false;
+    }
+
+    while (*pattern == '*')
+        pattern++;
+
+    return *pattern == '\0';
+}
+
+// ---------- PERF COUNTERS ----------
+// hardware / software counters of the calling thread, opened as one
+// perf_event group per thread. counters which cannot be opened (e.g. due to
+// perf_event_paranoid or missing PMU in VMs) are marked as unavailable.
+enum t1_perf_counter
+{
+    t1_perf_cycles,
+    t1_perf_instructions,
+    t1_perf_cache_misses,
+    t1_perf_branch_misses,
+    t1_perf_page_faults,
+    t1_perf_counter_count
+};
+
+struct t1_perf_values
+{
+    u64 values[t1_perf_counter_count];
+    bool available[t1_perf_counter_count];
+};
+
+struct t1_perf_group
+{
+    int fds[t1_perf_counter_count];
+    u32 group_index[t1_perf_counter_count]; // index into the group read
+    u32 group_size;
+    int leader;
+    bool opened;
+};
+
+static t1_perf_group *_t1_get_perf_group()
+{
+    static thread_local t1_perf_group _group{};
+    return &_group;
+}
+
+#if t1_Linux
+static int _t1_perf_event_open(u32 type, u64 config, int group_fd)
+{
+    perf_event_attr attr;
+    ::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1 ? 1 : 0;
+    // the times scale counters the kernel multiplexed with other events
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // counting user space only works with perf_event_paranoid <= 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+#endif
+
+// returns false if no counter could be opened
+static bool t1_perf_open(t1_perf_group *g)
+{
+    if (g->opened)
+        return g->leader != -1;
+
+    g->opened = true;
+    g->leader = -1;
+    g->group_size = 0;
+
+    for (u32 i = 0; i < t1_perf_counter_count; ++i)
+        g->fds[i] = -1;
+
+#if t1_Linux
+    static const u32 types[t1_perf_counter_count] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+    };
+
+    static const u64 configs[t1_perf_counter_count] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS
+    };
+
+    for (u32 i = 0; i < t1_perf_counter_count; ++i)
+    {
+        int fd = _t1_perf_event_open(types[i], configs[i], g->leader);
+
+        if (fd == -1)
+            continue;
+
+        if (g->leader == -1)
+            g->leader = fd;
+
+        g->fds[i] = fd;
+        g->group_index[i] = g->group_size;
+        g->group_size++;
+    }
+
+    return g->leader != -1;
+#else
+    return false;
+#endif
+}
+
+static void t1_perf_close(t1_perf_group *g)
+{
+#if t1_Linux
+    // the fds of a group that was never opened are 0, not -1
+    if (g->opened)
+        for (u32 i = 0; i < t1_perf_counter_count; ++i)
+        if (g->fds[i] != -1)
+            ::close(g->fds[i]);
+#endif
+
+    *g = t1_perf_group{};
+}
+
+static void t1_perf_start(t1_perf_group *g)
+{
+#if t1_Linux
+    if (g->leader == -1)
+        return;
+
+    ::ioctl(g->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(g->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static void t1_perf_stop(t1_perf_group *g, t1_perf_values *out)
+{
+    *out = t1_perf_values{};
+
+#if t1_Linux
+    if (g->leader == -1)
+        return;
+
+    ::ioctl(g->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // { u64 nr; u64 time_enabled; u64 time_running; u64 values[nr]; }
+    u64 buf[3 + t1_perf_counter_count];
+
+    if (::read(g->leader, buf, sizeof(buf)) < (s64)(3 * sizeof(u64)))
+        return;
+
+    u64 enabled = buf[1];
+    u64 running = buf[2];
+
+    // the group never got a PMU
+    if (running == 0)
+        return;
+
+    for (u32 i = 0; i < t1_perf_counter_count; ++i)
+    {
+        if (g->fds[i] == -1 || g->group_index[i] >= buf[0])
+            continue;
+
+        u64 value = buf[3 + g->group_index[i]];
+
+        // estimate of the whole time the group was enabled
+        if (running < enabled)
+            value = (u64)((double)value * ((double)enabled / (double)running));
+
+        out->values[i] = value;
+        out->available[i] = true;
+    }
+#endif
+}
+
+static void t1_perf_add(t1_perf_values *sum, const t1_perf_values *v)
+{
+    for (u32 i = 0; i < t1_perf_counter_count; ++i)
+    {
+        sum->values[i] += v->values[i];
+        sum->available[i] = sum->available[i] || v->available[i];
+    }
+}
+
+// prints the values divided by divisor, e.g. to get averages over iterations
+static void t1_print_perf_values(const t1_perf_values *v, u64 divisor = 1)
+{
+    static const char *names[t1_perf_counter_count] = {
+        "cycles", "instructions", "cache misses", "branch misses", "page faults"
+    };
+
+    if (divisor == 0)
+        divisor = 1;
+
+    printf("\n  ");
+
+    for (u32 i = 0; i < t1_perf_counter_count; ++i)
+    {
+        if (v->available[i])
+            printf(" %s %llu", names[i], (unsigned long long)(v->values[i] / divisor));
+        else
+            printf(" %s n/a", names[i]);
+
+        if (i == t1_perf_instructions && v->available[t1_perf_cycles] && v->available[i] && v->values[t1_perf_cycles] > 0)
+            printf(" (IPC %.2f)", (double)v->values[i] / (double)v->values[t1_perf_cycles]);
+
+        if (i + 1 < t1_perf_counter_count)
+            printf(",");
+    }
+}
+
+// ---------- ALLOCATIONS ----------
+// heap calls made by units on their own thread, only counted if
+// t1_track_allocations is defined before including t1.hpp.
+struct t1_allocation_stats
+{
+    u64 allocations;
+    u64 bytes_allocated;
+    s64 live_bytes; // may become negative if memory allocated outside the unit is freed
+    s64 peak_bytes;
+};
+
+// adds the stats of one run of a unit to sum, peak_bytes is the highest peak.
+static void t1_allocation_stats_add(t1_allocation_stats *sum, const t1_allocation_stats *stats)
+{
+    sum->allocations += stats->allocations;
+    sum->bytes_allocated += stats->bytes_allocated;
+
+    if (stats->peak_bytes > sum->peak_bytes)
+        sum->peak_bytes = stats->peak_bytes;
+}
+
+// prints the allocations of a unit, on average if it ran several iterations.
+[[maybe_unused]] static void t1_print_allocation_stats(const t1_allocation_stats *stats, u64 iterations = 1)
+{
+    if (iterations == 0)
+        iterations = 1;
+
+    printf(" %llu allocations%s, peak %lld bytes",
+           (unsigned long long)(stats->allocations / iterations),
+           iterations > 1 ? " per iteration" : "",
+           (long long)stats->peak_bytes);
+}
+
+#define t1_ALLOCATION_SCOPE_MAX_SITES 16
+
+struct t1_allocation_scope;
+
+struct _t1_allocation_state
+{
+    bool enabled;
+    t1_allocation_stats stats;
+    t1_allocation_scope *scope; // innermost active scope
+};
+
+static _t1_allocation_state *_t1_get_allocation_state()
+{
+    static thread_local _t1_allocation_state _state{};
+    return &_state;
+}
+
+static bool _t1_set_allocation_tracking(bool enabled)
+{
+    _t1_allocation_state *state = _t1_get_allocation_state();
+    bool was_enabled = state->enabled;
+    state->enabled = enabled;
+
+    return was_enabled;
+}
+
+// relative paths are relative to the directory of source_file (usually
+// __FILE__) if they don't exist relative to the working directory.
+// returns a temporary string.
+static const char *t1_resolve_path(const char *source_file, const char *path)
+{
+    if (path == nullptr || source_file == nullptr)
+        return path;
+
+    _t1_SUSPEND_HOOKS();
+
+#if t1_Windows
+    bool absolute = path[0] == '/' || path[0] == '\\' || (path[0] != '\0' && path[1] == ':');
+#else
+    bool absolute = path[0] == '/';
+
+    if (!absolute && ::access(path, F_OK) == 0)
+        return path;
+#endif
+
+    if (absolute)
+        return path;
+
+    const char *filename = t1_get_filename(source_file);
+
+    if (filename == source_file)
+        return path;
+
+    return t1_tprintf("%.*s%s", (int)(filename - source_file), source_file, path).data;
+}
+
+// ---------- FILES ----------
+struct t1_mapped_file
+{
+    const char *data;
+    u64 size;
+#if t1_Windows
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+// maps a whole file read-only, empty files are "mapped" with data == nullptr.
+static bool t1_map_file(const char *path, t1_mapped_file *out)
+{
+    _t1_SUSPEND_HOOKS();
+
+    out->data = nullptr;
+    out->size = 0;
+
+#if t1_Windows
+    out->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    out->mapping = nullptr;
+
+    if (out->file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(out->file, &size))
+    {
+        CloseHandle(out->file);
+        return false;
+    }
+
+    out->size = (u64)size.QuadPart;
+
+    if (out->size == 0)
+        return true;
+
+    out->mapping = CreateFileMappingA(out->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (out->mapping == nullptr)
+    {
+        CloseHandle(out->file);
+        return false;
+    }
+
+    out->data = (const char*)MapViewOfFile(out->mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (out->data == nullptr)
+    {
+        CloseHandle(out->mapping);
+        CloseHandle(out->file);
+        return false;
+    }
+
+    return true;
+#else
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd == -1)
+        return false;
+
+    defer { ::close(fd); };
+
+    struct stat st;
+
+    if (::fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+        return false;
+
+    out->size = (u64)st.st_size;
+
+    if (out->size == 0)
+        return true;
+
+    void *ptr = ::mmap(nullptr, out->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (ptr == MAP_FAILED)
+        return false;
+
+    ::madvise(ptr, out->size, MADV_SEQUENTIAL);
+    out->data = (const char*)ptr;
+
+    return true;
+#endif
+}
+
+static void t1_unmap_file(t1_mapped_file *f)
+{
+#if t1_Windows
+    if (f->data != nullptr)
+        UnmapViewOfFile(f->data);
+
+    if (f->mapping != nullptr)
+        CloseHandle(f->mapping);
+
+    if (f->file != INVALID_HANDLE_VALUE)
+        CloseHandle(f->file);
+#else
+    if (f->data != nullptr)
+        ::munmap((void*)f->data, f->size);
+#endif
+
+    f->data = nullptr;
+    f->size = 0;
+}
+
+// writes data to a temporary file next to path, then renames it to path,
+// so readers see either the old or the new contents.
+static bool t1_write_file_atomic(const char *path, const char *data, u64 size)
+{
+    _t1_SUSPEND_HOOKS();
+
+#if t1_Windows
+    const char *tmp = t1_tprintf("%s.%lu.tmp", path, GetCurrentProcessId()).data;
+    HANDLE h = CreateFileA(tmp, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+
+    bool ok = size == 0 || t1_io_write(h, (void*)data, size) == (s64)size;
+    ok = ok && FlushFileBuffers(h);
+    CloseHandle(h);
+
+    if (ok)
+        ok = MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+
+    if (!ok)
+        DeleteFileA(tmp);
+
+    return ok;
+#else
+    const char *tmp = t1_tprintf("%s.%d.tmp", path, (int)::getpid()).data;
+    int fd = ::open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd == -1)
+        return false;
+
+    bool ok = true;
+    u64 written = 0;
+
+    while (ok && written < size)
+    {
+        s64 n = ::write(fd, data + written, size - written);
+        ok = n > 0;
+        written += ok ? (u64)n : 0;
+    }
+
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (ok)
+        ok = ::rename(tmp, path) == 0;
+
+    if (!ok)
+        ::unlink(tmp);
+
+    return ok;
+#endif
+}
+
+static void t1_make_directory(const char *path)
+{
+    _t1_SUSPEND_HOOKS();
+
+#if t1_Windows
+    CreateDirectoryA(path, nullptr);
+#else
+    ::mkdir(path, 0755);
+#endif
+}
+
+// ---------- TESTS ----------
+#if t1_Windows && !defined(__MINGW32__)
 #define t1_COLOR_TEST_NAME ""
 #define t1_COLOR_CHECK_EXPECTED ""
 #define t1_COLOR_CHECK_ACTUAL ""
@@ -787,211 +2018,9312 @@ const char *t1_get_filename(const char *path)
 #define t1_COLOR_WARN ""
 #define t1_COLOR_RESET ""
 #else
-#define t1_COLOR_TEST_NAME "\033[33m"
-#define t1_COLOR_CHECK_EXPECTED "\033[32m"
-#define t1_COLOR_CHECK_ACTUAL "\033[31m"
-#define t1_COLOR_ERROR_EXPECTED "\033[32m"
-#define t1_COLOR_EXCEPTION "\033[31m"
-#define t1_COLOR_SOURCE "\033[36m"
-#define t1_COLOR_PASSED "\033[32m"
-#define t1_COLOR_FAILED "\033[31m"
-#define t1_COLOR_WARN "\033[33m"
-#define t1_COLOR_RESET "\033[0m"
+#define t1_COLOR_TEST_NAME "\033[33m"
+#define t1_COLOR_CHECK_EXPECTED "\033[32m"
+#define t1_COLOR_CHECK_ACTUAL "\033[31m"
+#define t1_COLOR_ERROR_EXPECTED "\033[32m"
+#define t1_COLOR_EXCEPTION "\033[31m"
+#define t1_COLOR_SOURCE "\033[36m"
+#define t1_COLOR_PASSED "\033[32m"
+#define t1_COLOR_FAILED "\033[31m"
+#define t1_COLOR_WARN "\033[33m"
+#define t1_COLOR_RESET "\033[0m"
+#endif
+
+// ---------- OUTPUT CAPTURE ----------
+// redirects stdout and stderr into a memfd while a unit runs, the output
+// (including t1's own assert messages) is only shown if the unit fails.
+#define t1_CAPTURE_DEFAULT_LIMIT 65536
+
+struct t1_output_capture
+{
+    int fd;         // memfd
+    int stdout_fd;  // saved stdout / stderr
+    int stderr_fd;
+    bool active;
+};
+
+static t1_output_capture *_t1_get_output_capture()
+{
+    static t1_output_capture _capture{-1, -1, -1, false};
+    return &_capture;
+}
+
+static bool t1_capture_begin()
+{
+#if t1_Linux
+    t1_output_capture *cap = _t1_get_output_capture();
+
+    if (cap->fd == -1)
+    {
+        cap->fd = _memfd_create("t1_capture", MFD_CLOEXEC);
+
+        if (cap->fd == -1)
+            return false;
+    }
+
+    ::fflush(nullptr);
+    t1_reporter_flush();
+
+    if (::ftruncate(cap->fd, 0) == -1 || ::lseek(cap->fd, 0, SEEK_SET) == -1)
+        return false;
+
+    // stdout may change between units, e.g. in --serve mode
+    cap->stdout_fd = ::dup(STDOUT_FILENO);
+    cap->stderr_fd = ::dup(STDERR_FILENO);
+
+    ::dup2(cap->fd, STDOUT_FILENO);
+    ::dup2(cap->fd, STDERR_FILENO);
+    cap->active = true;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// restores stdout and stderr. if replay is set, writes at most limit bytes
+// of the captured output to stdout, omitting the middle if it's too long.
+static void t1_capture_end(bool replay, u64 limit, const char *unit_name)
+{
+#if t1_Linux
+    t1_output_capture *cap = _t1_get_output_capture();
+
+    if (!cap->active)
+        return;
+
+    ::fflush(nullptr);
+    t1_reporter_flush();
+    ::dup2(cap->stdout_fd, STDOUT_FILENO);
+    ::dup2(cap->stderr_fd, STDERR_FILENO);
+    ::close(cap->stdout_fd);
+    ::close(cap->stderr_fd);
+    cap->active = false;
+
+    if (!replay)
+        return;
+
+    s64 size = (s64)::lseek(cap->fd, 0, SEEK_END);
+
+    if (size <= 0)
+        return;
+
+    char *data = (char*)::mmap(nullptr, (u64)size, PROT_READ, MAP_SHARED, cap->fd, 0);
+
+    if (data == MAP_FAILED)
+        return;
+
+    printf("\n%s--- captured output of %s (%lld bytes) ---%s\n",
+           t1_COLOR_WARN, unit_name, (long long)size, t1_COLOR_RESET);
+
+    if ((u64)size <= limit)
+        t1_output_write(data, (u64)size);
+    else
+    {
+        u64 half = limit / 2;
+        t1_output_write(data, half);
+        printf("\n%s... %llu bytes omitted ...%s\n", t1_COLOR_WARN,
+               (unsigned long long)((u64)size - 2 * half), t1_COLOR_RESET);
+        t1_output_write(data + size - half, half);
+    }
+
+    printf("\n%s--- end of captured output of %s ---%s\n", t1_COLOR_WARN, unit_name, t1_COLOR_RESET);
+
+    ::munmap(data, (u64)size);
+#else
+    (void)replay;
+    (void)limit;
+    (void)unit_name;
+#endif
+}
+
+
+// ---------- PROFILER ----------
+// --profile[=hz] samples the thread running a unit hz times per second of
+// its cpu time (SIGPROF from a per-thread timer) and walks the stack using
+// frame pointers, so build with -fno-omit-frame-pointer (see the PROFILING
+// option of add_t1_test) for complete stacks.
+// the signal handler only stores raw addresses, symbols are looked up in the
+// ELF symbol tables of the loaded objects after all units ran. the samples
+// of each unit are written to profile/<test file>.<unit>.folded as folded
+// stacks, e.g. for flamegraph.pl.
+#if t1_Linux && (defined(__x86_64__) || defined(__aarch64__))
+#define t1_PROFILER 1
+#else
+#define t1_PROFILER 0
+#endif
+
+#define t1_PROFILE_DEFAULT_HZ 997
+#define t1_PROFILE_MAX_DEPTH 64
+#define t1_PROFILE_BUFFER_WORDS (1 << 18)
+#define t1_PROFILE_DIRECTORY "profile"
+
+#if t1_PROFILER
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+// per thread, filled by the signal handler
+struct _t1_profile_buffer
+{
+    u64 *words; // per sample: depth, count, then depth addresses, leaf first
+    u64 capacity;
+    u64 size;
+    u64 dropped;
+
+    u64 stack_low;
+    u64 stack_high;
+
+    timer_t timer;
+    bool timer_created;
+    bool active;
+};
+
+static _t1_profile_buffer *_t1_get_profile_buffer()
+{
+    static thread_local _t1_profile_buffer _buf{};
+    return &_buf;
+}
+
+static void _t1_profile_signal_handler(int, siginfo_t *info, void *context)
+{
+    _t1_profile_buffer *buf = _t1_get_profile_buffer();
+
+    if (!t1_atomic_load(&buf->active))
+        return;
+
+    ucontext_t *uc = (ucontext_t*)context;
+
+#if defined(__x86_64__)
+    u64 pc = (u64)uc->uc_mcontext.gregs[REG_RIP];
+    u64 fp = (u64)uc->uc_mcontext.gregs[REG_RBP];
+#else
+    u64 pc = (u64)uc->uc_mcontext.pc;
+    u64 fp = (u64)uc->uc_mcontext.regs[29];
+#endif
+
+    // cpu timers expire on scheduler ticks, expirations since the last
+    // signal are only counted as overruns
+    u64 count = 1 + (u64)(info->si_overrun > 0 ? info->si_overrun : 0);
+
+    if (buf->size + 2 + t1_PROFILE_MAX_DEPTH > buf->capacity)
+    {
+        buf->dropped += count;
+        return;
+    }
+
+    u64 *sample = buf->words + buf->size;
+    u64 depth = 0;
+
+    sample[2 + depth++] = pc;
+
+    // [fp] is the caller's frame pointer, [fp + 8] the return address.
+    // stop at anything that doesn't look like a frame of this stack.
+    while (depth < t1_PROFILE_MAX_DEPTH
+        && fp >= buf->stack_low && fp + 16 <= buf->stack_high && (fp & 7) == 0)
+    {
+        u64 next = ((u64*)fp)[0];
+        u64 ret = ((u64*)fp)[1];
+
+        if (ret == 0)
+            break;
+
+        // the call instruction, not the one after it
+        sample[2 + depth++] = ret - 1;
+
+        if (next <= fp)
+            break;
+
+        fp = next;
+    }
+
+    sample[0] = depth;
+    sample[1] = count;
+    buf->size += 2 + depth;
+}
+
+static bool _t1_profile_setup(_t1_profile_buffer *buf)
+{
+    static bool _handler_installed = false;
+
+    bool expected = false;
+
+    if (t1_atomic_compare_exchange(&_handler_installed, &expected, true))
+    {
+        struct sigaction sa{};
+        sa.sa_sigaction = _t1_profile_signal_handler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        ::sigaction(SIGPROF, &sa, nullptr);
+    }
+
+    if (buf->timer_created)
+        return true;
+
+    void *words = ::mmap(nullptr, t1_PROFILE_BUFFER_WORDS * sizeof(u64), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (words == MAP_FAILED)
+        return false;
+
+    pthread_attr_t attr;
+    void *stack_addr = nullptr;
+    size_t stack_size = 0;
+
+    if (pthread_getattr_np(pthread_self(), &attr) == 0)
+    {
+        pthread_attr_getstack(&attr, &stack_addr, &stack_size);
+        pthread_attr_destroy(&attr);
+    }
+
+    sigevent ev{};
+    ev.sigev_notify = SIGEV_THREAD_ID;
+    ev.sigev_signo = SIGPROF;
+    ev.sigev_notify_thread_id = (pid_t)::syscall(SYS_gettid);
+
+    if (::timer_create(CLOCK_THREAD_CPUTIME_ID, &ev, &buf->timer) != 0)
+    {
+        ::munmap(words, t1_PROFILE_BUFFER_WORDS * sizeof(u64));
+        return false;
+    }
+
+    buf->words = (u64*)words;
+    buf->capacity = t1_PROFILE_BUFFER_WORDS;
+    buf->stack_low = (u64)stack_addr;
+    buf->stack_high = (u64)stack_addr + stack_size;
+    buf->timer_created = true;
+
+    return true;
+}
+
+static void _t1_profile_set_timer(_t1_profile_buffer *buf, u32 hz)
+{
+    itimerspec spec{};
+
+    if (hz > 0)
+    {
+        spec.it_interval.tv_nsec = (long)(t1_NANOSECONDS_IN_A_SECOND / hz);
+        spec.it_value = spec.it_interval;
+    }
+
+    ::timer_settime(buf->timer, 0, &spec, nullptr);
+}
+
+// samples of one unit, from all threads that ran it
+struct _t1_unit_profile
+{
+    const char *file;
+    const char *name;
+    t1_array<u64> words;
+    u64 samples;
+    u64 dropped;
+};
+
+struct _t1_profiler
+{
+    u32 lock;
+    t1_array<_t1_unit_profile> units;
+};
+
+static _t1_profiler *_t1_get_profiler()
+{
+    static _t1_profiler _profiler{};
+    return &_profiler;
+}
+#endif
+
+// starts sampling the calling thread, returns false if that's not possible.
+static bool t1_profile_begin(u32 hz)
+{
+#if t1_PROFILER
+    _t1_profile_buffer *buf = _t1_get_profile_buffer();
+
+    // e.g. test case workers on the thread that runs the unit
+    if (hz == 0 || t1_atomic_load(&buf->active) || !_t1_profile_setup(buf))
+        return false;
+
+    buf->size = 0;
+    buf->dropped = 0;
+    t1_atomic_store(&buf->active, true);
+    _t1_profile_set_timer(buf, hz);
+
+    return true;
+#else
+    (void)hz;
+    return false;
+#endif
+}
+
+// stops sampling the calling thread and adds the samples to the given unit.
+static void t1_profile_end(const char *file, const char *name)
+{
+#if t1_PROFILER
+    _t1_profile_buffer *buf = _t1_get_profile_buffer();
+
+    if (!buf->timer_created)
+        return;
+
+    _t1_profile_set_timer(buf, 0);
+    t1_atomic_store(&buf->active, false);
+
+    if (buf->size == 0 && buf->dropped == 0)
+        return;
+
+    u64 samples = 0;
+
+    for (u64 i = 0; i < buf->size; i += 2 + buf->words[i])
+        samples += buf->words[i + 1];
+
+    _t1_profiler *p = _t1_get_profiler();
+    _t1_spin_lock(&p->lock);
+
+    _t1_unit_profile *up = nullptr;
+
+    for (u64 i = 0; i < p->units.size; ++i)
+    if (p->units[i].name == name && p->units[i].file == file)
+    {
+        up = p->units.data + i;
+        break;
+    }
+
+    if (up == nullptr)
+    {
+        up = t1_add_at_end(&p->units);
+        up->file = file;
+        up->name = name;
+        init(&up->words);
+        up->samples = 0;
+        up->dropped = 0;
+    }
+
+    if (buf->size > 0)
+        ::memcpy(t1_add_elements(&up->words, buf->size), buf->words, buf->size * sizeof(u64));
+
+    up->samples += samples;
+    up->dropped += buf->dropped;
+
+    _t1_spin_unlock(&p->lock);
+#else
+    (void)file;
+    (void)name;
+#endif
+}
+
+static void _t1_profile_thread_cleanup()
+{
+#if t1_PROFILER
+    _t1_profile_buffer *buf = _t1_get_profile_buffer();
+
+    if (!buf->timer_created)
+        return;
+
+    t1_atomic_store(&buf->active, false);
+    ::timer_delete(buf->timer);
+    ::munmap(buf->words, buf->capacity * sizeof(u64));
+    *buf = _t1_profile_buffer{};
+#endif
+}
+
+#if t1_PROFILER
+struct _t1_symbol
+{
+    u64 address;
+    u64 size;
+    const char *name;      // inside the mapped file
+    char *demangled;       // looked up on first use
+};
+
+struct _t1_symbol_object
+{
+    char *path;
+    u64 bias;
+    u64 start;
+    u64 end;
+
+    bool loaded;
+    t1_mapped_file file;
+    t1_array<_t1_symbol> symbols;
+};
+
+static int _t1_collect_objects(dl_phdr_info *info, size_t, void *arg)
+{
+    t1_array<_t1_symbol_object> *objects = (t1_array<_t1_symbol_object>*)arg;
+
+    u64 start = (u64)-1;
+    u64 end = 0;
+
+    for (int i = 0; i < info->dlpi_phnum; ++i)
+    {
+        const ElfW(Phdr) *ph = info->dlpi_phdr + i;
+
+        if (ph->p_type != PT_LOAD)
+            continue;
+
+        u64 s = info->dlpi_addr + ph->p_vaddr;
+
+        if (s < start)
+            start = s;
+
+        if (s + ph->p_memsz > end)
+            end = s + ph->p_memsz;
+    }
+
+    if (end == 0)
+        return 0;
+
+    // the executable itself has no name
+    const char *path = info->dlpi_name != nullptr && info->dlpi_name[0] != '\0' ? info->dlpi_name : "/proc/self/exe";
+
+    _t1_symbol_object *o = t1_add_at_end(objects);
+    *o = _t1_symbol_object{};
+    o->path = ::strdup(path);
+    o->bias = info->dlpi_addr;
+    o->start = start;
+    o->end = end;
+    init(&o->symbols);
+
+    return 0;
+}
+
+static void _t1_free_symbol_objects(t1_array<_t1_symbol_object> *objects)
+{
+    for (u64 i = 0; i < objects->size; ++i)
+    {
+        _t1_symbol_object *o = objects->data + i;
+
+        for (u64 s = 0; s < o->symbols.size; ++s)
+            ::free(o->symbols[s].demangled);
+
+        free(&o->symbols);
+
+        if (o->loaded && o->file.data != nullptr)
+            t1_unmap_file(&o->file);
+
+        ::free(o->path);
+    }
+
+    free(objects);
+}
+
+static int _t1_compare_symbols(const void *l, const void *r)
+{
+    u64 a = ((const _t1_symbol*)l)->address;
+    u64 b = ((const _t1_symbol*)r)->address;
+
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// reads the function symbols of .symtab, or .dynsym if the object is stripped
+static void _t1_load_symbols(_t1_symbol_object *o)
+{
+    o->loaded = true;
+
+    if (!t1_map_file(o->path, &o->file))
+        return;
+
+    const char *data = o->file.data;
+    u64 size = o->file.size;
+
+    if (size < sizeof(Elf64_Ehdr) || memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64)
+        return;
+
+    const Elf64_Ehdr *eh = (const Elf64_Ehdr*)data;
+
+    if (eh->e_shoff == 0 || eh->e_shoff + (u64)eh->e_shnum * sizeof(Elf64_Shdr) > size)
+        return;
+
+    const Elf64_Shdr *sections = (const Elf64_Shdr*)(data + eh->e_shoff);
+    const Elf64_Shdr *symtab = nullptr;
+
+    for (u32 i = 0; i < eh->e_shnum; ++i)
+    {
+        if (sections[i].sh_type == SHT_SYMTAB)
+        {
+            symtab = sections + i;
+            break;
+        }
+
+        if (sections[i].sh_type == SHT_DYNSYM)
+            symtab = sections + i;
+    }
+
+    if (symtab == nullptr || symtab->sh_link >= eh->e_shnum)
+        return;
+
+    const Elf64_Shdr *strtab = sections + symtab->sh_link;
+
+    if (symtab->sh_offset + symtab->sh_size > size || strtab->sh_offset + strtab->sh_size > size)
+        return;
+
+    const Elf64_Sym *syms = (const Elf64_Sym*)(data + symtab->sh_offset);
+    u64 count = symtab->sh_size / sizeof(Elf64_Sym);
+
+    for (u64 i = 0; i < count; ++i)
+    {
+        const Elf64_Sym *sym = syms + i;
+
+        if (ELF64_ST_TYPE(sym->st_info) != STT_FUNC || sym->st_value == 0 || sym->st_name >= strtab->sh_size)
+            continue;
+
+        t1_add_at_end(&o->symbols, _t1_symbol{o->bias + sym->st_value, sym->st_size,
+                                              data + strtab->sh_offset + sym->st_name, nullptr});
+    }
+
+    ::qsort(o->symbols.data, o->symbols.size, sizeof(_t1_symbol), _t1_compare_symbols);
+}
+
+// returns the frame name of address, e.g. "parse_number(char const*)",
+// "[libfoo.so]" or "0x1234".
+static const char *_t1_symbolize(t1_array<_t1_symbol_object> *objects, u64 address)
+{
+    for (u64 i = 0; i < objects->size; ++i)
+    {
+        _t1_symbol_object *o = objects->data + i;
+
+        if (address < o->start || address >= o->end)
+            continue;
+
+        if (!o->loaded)
+            _t1_load_symbols(o);
+
+        // last symbol at or before address
+        s64 lo = 0;
+        s64 hi = (s64)o->symbols.size - 1;
+        s64 found = -1;
+
+        while (lo <= hi)
+        {
+            s64 mid = (lo + hi) / 2;
+
+            if (o->symbols[mid].address <= address)
+            {
+                found = mid;
+                lo = mid + 1;
+            }
+            else
+                hi = mid - 1;
+        }
+
+        if (found >= 0)
+        {
+            _t1_symbol *sym = o->symbols.data + found;
+
+            if (address < sym->address + (sym->size > 0 ? sym->size : 1))
+            {
+#if __has_include(<cxxabi.h>)
+                if (sym->demangled == nullptr)
+                {
+                    int status = 0;
+                    sym->demangled = abi::__cxa_demangle(sym->name, nullptr, nullptr, &status);
+
+                    if (status != 0)
+                        sym->demangled = nullptr;
+                }
+
+                if (sym->demangled != nullptr)
+                    return sym->demangled;
+#endif
+                return sym->name;
+            }
+        }
+
+        return t1_tprintf("[%s]", t1_get_filename(o->path)).data;
+    }
+
+    return t1_tprintf("%#llx", (unsigned long long)address).data;
+}
+
+struct _t1_folded_stack
+{
+    char *frames;
+    u64 count;
+};
+
+static int _t1_compare_folded_stacks(const void *l, const void *r)
+{
+    return strcmp(((const _t1_folded_stack*)l)->frames, ((const _t1_folded_stack*)r)->frames);
+}
+
+// writes the folded stacks of one unit, returns false if the file could not be written
+static bool _t1_write_folded_stacks(t1_array<_t1_symbol_object> *objects, _t1_unit_profile *up, const char *path)
+{
+    t1_array<_t1_folded_stack> stacks;
+    init(&stacks);
+
+    t1_array<char> line;
+    init(&line);
+
+    const u64 *words = up->words.data;
+
+    for (u64 i = 0; i < up->words.size; i += 2 + words[i])
+    {
+        u64 depth = words[i];
+        line.size = 0;
+
+        // root first
+        for (u64 d = depth; d > 0; --d)
+        {
+            const char *frame = _t1_symbolize(objects, words[i + 1 + d]);
+            u64 len = strlen(frame);
+            char *out = t1_add_elements(&line, len + 1);
+
+            ::memcpy(out, frame, len);
+
+            // ';' separates frames
+            for (u64 c = 0; c < len; ++c)
+                if (out[c] == ';')
+                    out[c] = ':';
+
+            out[len] = d > 1 ? ';' : '\0';
+        }
+
+        if (line.size > 0)
+            t1_add_at_end(&stacks, _t1_folded_stack{::strdup(line.data), words[i + 1]});
+    }
+
+    ::qsort(stacks.data, stacks.size, sizeof(_t1_folded_stack), _t1_compare_folded_stacks);
+
+    // "frame;frame;frame count\n", identical stacks merged
+    line.size = 0;
+
+    for (u64 i = 0; i < stacks.size;)
+    {
+        u64 j = i + 1;
+        u64 samples = stacks[i].count;
+
+        while (j < stacks.size && strcmp(stacks[i].frames, stacks[j].frames) == 0)
+            samples += stacks[j++].count;
+
+        t1_string count = t1_tprintf(" %llu\n", (unsigned long long)samples);
+        u64 len = strlen(stacks[i].frames);
+        char *out = t1_add_elements(&line, len + count.size);
+        ::memcpy(out, stacks[i].frames, len);
+        ::memcpy(out + len, count.data, count.size);
+
+        i = j;
+    }
+
+    bool ok = t1_write_file_atomic(path, line.data != nullptr ? line.data : "", line.size);
+
+    for (u64 i = 0; i < stacks.size; ++i)
+        ::free(stacks[i].frames);
+
+    free(&stacks);
+    free(&line);
+
+    return ok;
+}
+#endif
+
+// symbolizes and writes the samples of all profiled units, then discards them.
+static void t1_profile_write()
+{
+#if t1_PROFILER
+    _t1_profiler *p = _t1_get_profiler();
+
+    if (p->units.size == 0)
+        return;
+
+    t1_array<_t1_symbol_object> objects;
+    init(&objects);
+    ::dl_iterate_phdr(_t1_collect_objects, &objects);
+
+    t1_make_directory(t1_PROFILE_DIRECTORY);
+
+    for (u64 i = 0; i < p->units.size; ++i)
+    {
+        _t1_unit_profile *up = p->units.data + i;
+        const char *path = t1_tprintf(t1_PROFILE_DIRECTORY "/%s.%s.folded", up->file, up->name).data;
+
+        if (_t1_write_folded_stacks(&objects, up, path))
+            printf("profile of %s%s%s: %llu samples written to %s%s%s",
+                   t1_COLOR_TEST_NAME, up->name, t1_COLOR_RESET,
+                   (unsigned long long)up->samples,
+                   t1_COLOR_SOURCE, path, t1_COLOR_RESET);
+        else
+            printf("%scould not write profile %s%s", t1_COLOR_FAILED, path, t1_COLOR_RESET);
+
+        if (up->dropped > 0)
+            printf(" %s(%llu samples dropped)%s", t1_COLOR_WARN, (unsigned long long)up->dropped, t1_COLOR_RESET);
+
+        printf("\n");
+        free(&up->words);
+    }
+
+    free(&p->units);
+    _t1_free_symbol_objects(&objects);
+#endif
+}
+
+struct t1_assert_info
+{
+    const char *file;
+    int line;
+    const char *str1; // the actual expression string
+    const char *str2; // the expected value string, if any
+};
+
+struct t1_async_task;
+
+struct t1_unit
+{
+    using FuncPtr = void(*)();
+    using AsyncFuncPtr = t1_async_task(*)();
+    const char *name;
+    FuncPtr func;
+    const char *file;
+    unsigned int line;
+    AsyncFuncPtr async_func = nullptr; // set by define_async_test, func is nullptr then
+};
+
+// runs the selected async units concurrently, see ASYNC TESTS
+static void t1_run_async_units();
+
+// record what units execute with --record-impact, see IMPACT ANALYSIS.
+// index is that of the unit, the unit count for all async units.
+static void t1_impact_begin_unit();
+static void t1_impact_end_unit(u64 index);
+static void t1_impact_write();
+
+// waits for the death checks started on this thread, only those of unit if
+// given, see DEATH TESTS
+static void t1_wait_deaths(const t1_unit *unit = nullptr);
+
+// ---------- JOURNAL ----------
+// --journal <path> makes t1_tests::run record the state of every unit in a
+// file mapped with MAP_SHARED: a unit is marked started before it runs and
+// passed or failed, with its assert counts and time, after it ran. since
+// the mapping is the page cache, the journal survives the process being
+// killed or crashing (but not the machine going down).
+// --resume continues a previous run using the journal (<test file>.journal
+// unless --journal is given): units that finished are not run again but
+// counted in the summary, the unit that was running when the previous run
+// died is reported and counted as failed.
+#define t1_JOURNAL_MAGIC "t1jrnl\0\1"
+
+enum t1_journal_state : u32
+{
+    t1_journal_not_run,
+    t1_journal_started,
+    t1_journal_passed,
+    t1_journal_failed,
+    t1_journal_crashed
+};
+
+struct t1_journal_header
+{
+    char magic[8];
+    u64 unit_count;
+};
+
+// one per unit, in the order of t1_tests::units
+struct t1_journal_record
+{
+    u64 unit_hash;
+    u32 state;
+    u32 asserts;
+    u32 asserts_failed;
+    u32 reserved;
+    double seconds;
+};
+
+struct t1_journal
+{
+    t1_journal_header *header;
+    t1_journal_record *records;
+    u64 size;
+};
+
+static u64 _t1_unit_hash(const t1_unit *unit)
+{
+    // FNV-1a of file and name
+    u64 h = 0xcbf29ce484222325ull;
+
+    for (const char *c = unit->file; *c != '\0'; ++c)
+        h = (h ^ (u8)*c) * 0x100000001b3ull;
+
+    h = (h ^ 0) * 0x100000001b3ull;
+
+    for (const char *c = unit->name; *c != '\0'; ++c)
+        h = (h ^ (u8)*c) * 0x100000001b3ull;
+
+    return h;
+}
+
+static bool _t1_journal_is_valid(const t1_mapped_file *f)
+{
+    const t1_journal_header *h = (const t1_journal_header*)f->data;
+
+    return f->size >= sizeof(t1_journal_header) && memcmp(h->magic, t1_JOURNAL_MAGIC, 8) == 0
+        && f->size >= sizeof(t1_journal_header) + h->unit_count * sizeof(t1_journal_record);
+}
+
+// whether there is a journal at path that a run can be resumed from
+[[maybe_unused]] static bool t1_journal_exists(const char *path)
+{
+    t1_mapped_file f;
+
+    if (!t1_map_file(path, &f))
+        return false;
+
+    bool valid = _t1_journal_is_valid(&f);
+    t1_unmap_file(&f);
+    return valid;
+}
+
+// opens or creates the journal at path for units. if resume is set, the
+// records of units that are still there are taken from the existing journal,
+// everything else starts as not run.
+static bool t1_journal_open(t1_journal *j, const char *path, const t1_unit *units, u64 unit_count, bool resume)
+{
+    *j = t1_journal{};
+
+#if t1_Windows
+    (void)path;
+    (void)units;
+    (void)unit_count;
+    (void)resume;
+    return false;
+#else
+    // previous records are copied before the file is resized
+    t1_journal_record *previous = nullptr;
+    u64 previous_count = 0;
+
+    if (resume)
+    {
+        t1_mapped_file old;
+
+        if (t1_map_file(path, &old))
+        {
+            if (_t1_journal_is_valid(&old))
+            {
+                previous_count = ((const t1_journal_header*)old.data)->unit_count;
+                previous = t1_reallocate_memory<t1_journal_record>(nullptr, previous_count > 0 ? previous_count : 1);
+                ::memcpy(previous, old.data + sizeof(t1_journal_header), previous_count * sizeof(t1_journal_record));
+            }
+
+            t1_unmap_file(&old);
+        }
+    }
+
+    defer { if (previous != nullptr) t1_free_memory(previous); };
+
+    int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (fd == -1)
+        return false;
+
+    defer { ::close(fd); };
+
+    u64 size = sizeof(t1_journal_header) + unit_count * sizeof(t1_journal_record);
+
+    if (::ftruncate(fd, 0) == -1 || ::ftruncate(fd, (off_t)size) == -1)
+        return false;
+
+    void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    j->header = (t1_journal_header*)data;
+    j->records = (t1_journal_record*)((char*)data + sizeof(t1_journal_header));
+    j->size = size;
+
+    ::memcpy(j->header->magic, t1_JOURNAL_MAGIC, 8);
+    j->header->unit_count = unit_count;
+
+    for (u64 i = 0; i < unit_count; ++i)
+    {
+        t1_journal_record *rec = j->records + i;
+        rec->unit_hash = _t1_unit_hash(units + i);
+
+        for (u64 p = 0; p < previous_count; ++p)
+        if (previous[p].unit_hash == rec->unit_hash)
+        {
+            *rec = previous[p];
+            break;
+        }
+    }
+
+    return true;
+#endif
+}
+
+static void t1_journal_close(t1_journal *j)
+{
+#if !t1_Windows
+    if (j->header != nullptr)
+        ::munmap(j->header, j->size);
+#endif
+
+    *j = t1_journal{};
+}
+
+static void t1_journal_begin_unit(t1_journal_record *rec)
+{
+    rec->asserts = 0;
+    rec->asserts_failed = 0;
+    rec->seconds = 0;
+    t1_atomic_store(&rec->state, (u32)t1_journal_started);
+}
+
+static void t1_journal_end_unit(t1_journal_record *rec, bool passed, u32 asserts, u32 asserts_failed, double seconds)
+{
+    rec->asserts = asserts;
+    rec->asserts_failed = asserts_failed;
+    rec->seconds = seconds;
+    t1_atomic_store(&rec->state, (u32)(passed ? t1_journal_passed : t1_journal_failed));
+}
+
+// ---------- REPEAT ----------
+struct t1_repeat_result
+{
+    t1_unit *unit;
+    u64 iterations;
+    u64 iterations_failed;
+    u64 first_failed_iteration; // only valid if iterations_failed > 0
+    u64 first_failed_seed;
+    double min_seconds;
+    double median_seconds;
+    double max_seconds;
+    t1_perf_values perf; // sum over all iterations
+    t1_allocation_stats allocations; // sum over all iterations, highest peak
+};
+
+struct _t1_repeat_state
+{
+    t1_unit *unit;
+    u64 next_iteration;
+    u64 iterations_failed;
+    u64 first_failed_iteration;
+    bool stop;
+};
+
+struct _t1_repeat_worker
+{
+    _t1_repeat_state *state;
+    t1_array<double> durations;
+    t1_perf_values perf;
+    t1_allocation_stats allocations;
+    t1_thread thread;
+};
+
+struct t1_tests
+{
+    static t1_array<t1_unit> units;
+    static t1_array<const char*> filters;
+    static t1_array<t1_repeat_result> repeat_results;
+    static bool stop_on_fail;
+    static bool last_passed;
+    static bool verbose;
+    static thread_local bool current_unit_failed;
+    static bool unprintable_called;
+    static unsigned int total_units_failed;
+    static unsigned int total_units;
+    static unsigned int total_asserts_failed;
+    static unsigned int total_asserts;
+    static double total_seconds;
+    static thread_local t1_unit *current_unit;
+    static thread_local u64 current_iteration;
+    static thread_local u64 current_seed;
+    static thread_local s32 current_thread; // thread of a stress test, -1 otherwise
+    static thread_local t1_perf_values last_perf_values;
+    static thread_local t1_allocation_stats last_allocation_stats;
+
+    // --repeat, --until-fail, --jobs, --seed
+    static u64 repeat_count; // 0 = don't repeat, unless until_fail is set
+    static bool until_fail;
+    static u32 jobs;         // 0 = number of processors
+    static u64 seed;
+
+    // --perf-counters
+    static bool perf_counters;
+
+    // --capture, --capture-limit
+    static bool capture_output;
+    static u64 capture_limit;
+
+    // --serve, --connect
+    static const char *serve_path;
+    static const char *connect_path;
+
+    // --update-snapshots
+    static bool update_snapshots;
+
+    // --async-output
+    static bool async_output;
+
+    // --stress-jitter
+    static bool stress_jitter;
+
+    // --profile[=hz]
+    static u32 profile_hz; // 0 = off
+
+    // --journal, --resume
+    static const char *journal_path; // <test file>.journal if only resume is set
+    static bool resume;
+
+    // --list
+    static bool list_units;
+
+    // --fuzz[=seconds], --fuzz-runs, --fuzz-workers, --fuzz-timeout, --fuzz-minimize
+    static bool fuzz;
+    static u32 fuzz_seconds; // 0 = until fuzz_runs
+    static u64 fuzz_runs;    // per worker, 0 = until fuzz_seconds
+    static u32 fuzz_workers;
+    static u32 fuzz_timeout; // seconds per input, 0 = none
+    static bool fuzz_minimize;
+
+    // --coordinate, --workers, --worker, --costs
+    static const char *coordinate_path;
+    static s32 coordinate_workers; // local worker processes, -1 = number of processors
+    static const char *worker_path;
+    static const char *costs_path; // <test file>.costs if not set
+
+    // --record-impact, --impact-index, --changed, --changed-list, --changed-binary
+    static bool record_impact;
+    static const char *impact_index_path; // <test file>.impact if not set
+    static t1_array<const char*> changed; // patterns of changed functions
+    static const char *changed_list_path;
+    static bool changed_binary;
+    static t1_array<u8> impacted;         // per unit, empty = all units
+
+    static int add(const t1_unit &u)
+    {
+        t1_add_at_end(&units, u);
+        return 0;
+    }
+
+    static bool is_selected(const t1_unit *unit)
+    {
+        if (impacted.size > 0 && unit >= units.data && unit < units.data + impacted.size
+         && !impacted[(u64)(unit - units.data)])
+            return false;
+
+        if (filters.size == 0)
+            return true;
+
+        for (u64 i = 0; i < filters.size; ++i)
+        if (t1_glob_match(filters[i], unit->name))
+            return true;
+
+        return false;
+    }
+
+    // runs unit once on the calling thread, returns whether it passed.
+    static bool run_iteration(t1_unit *unit, u64 iteration, double *seconds)
+    {
+        current_unit = unit;
+        current_unit_failed = false;
+        current_iteration = iteration;
+        current_seed = seed + iteration;
+
+        timespec start_time;
+        timespec end_time;
+
+        t1_perf_group *perf = _t1_get_perf_group();
+
+        if (perf_counters && t1_perf_open(perf))
+            t1_perf_start(perf);
+
+        _t1_allocation_state *allocs = _t1_get_allocation_state();
+        allocs->stats = t1_allocation_stats{};
+        allocs->enabled = true;
+
+        bool profiled = profile_hz > 0 && t1_profile_begin(profile_hz);
+
+        t1_get_time(&start_time);
+        unit->func();
+
+        // in case the unit left its virtual filesystem or faults mounted
+        _t1_current_vfs = nullptr;
+        _t1_current_faults = nullptr;
+        allocs->enabled = false;
+        last_allocation_stats = allocs->stats;
+
+        t1_wait_deaths();
+        t1_get_time(&end_time);
+
+        if (profiled)
+            t1_profile_end(unit->file, unit->name);
+
+        if (perf_counters)
+            t1_perf_stop(perf, &last_perf_values);
+
+        *seconds = t1_get_seconds_difference(&start_time, &end_time);
+
+        return !current_unit_failed;
+    }
+
+    static void _repeat_worker(void *arg)
+    {
+        _t1_repeat_worker *worker = (_t1_repeat_worker*)arg;
+        _t1_repeat_state *state = worker->state;
+
+        while (!t1_atomic_load(&state->stop))
+        {
+            u64 iteration = t1_atomic_add(&state->next_iteration, (u64)1) - 1;
+
+            if (repeat_count > 0 && iteration >= repeat_count)
+                break;
+
+            bool captured = capture_output && t1_capture_begin();
+
+            double seconds = 0;
+            bool passed = run_iteration(state->unit, iteration, &seconds);
+            t1_add_at_end(&worker->durations, seconds);
+
+            if (captured)
+                t1_capture_end(!passed, capture_limit, state->unit->name);
+
+            if (perf_counters)
+                t1_perf_add(&worker->perf, &last_perf_values);
+
+            t1_allocation_stats_add(&worker->allocations, &last_allocation_stats);
+
+            if (passed)
+                continue;
+
+            t1_atomic_add(&state->iterations_failed, (u64)1);
+
+            u64 first = t1_atomic_load(&state->first_failed_iteration);
+
+            while (iteration < first
+                && !t1_atomic_compare_exchange(&state->first_failed_iteration, &first, iteration))
+                ;
+
+            if (until_fail)
+                t1_atomic_store(&state->stop, true);
+        }
+    }
+
+    static int _compare_doubles(const void *l, const void *r)
+    {
+        double a = *(const double*)l;
+        double b = *(const double*)r;
+        return (a > b) - (a < b);
+    }
+
+    static void run_repeated(t1_unit *unit)
+    {
+        _t1_repeat_state state{};
+        state.unit = unit;
+        state.first_failed_iteration = UINT64_MAX;
+
+        u32 worker_count = jobs == 0 ? t1_get_processor_count() : jobs;
+
+        if (repeat_count > 0 && worker_count > repeat_count)
+            worker_count = (u32)repeat_count;
+
+        // capturing redirects the output of the whole process, so every
+        // iteration is captured on its own by one worker
+        if (worker_count == 0 || capture_output)
+            worker_count = 1;
+
+        _t1_repeat_worker *workers = t1_reallocate_memory<_t1_repeat_worker>(nullptr, worker_count);
+
+        for (u32 i = 0; i < worker_count; ++i)
+        {
+            workers[i].state = &state;
+            workers[i].perf = t1_perf_values{};
+            workers[i].allocations = t1_allocation_stats{};
+            init(&workers[i].durations);
+        }
+
+        timespec start_time;
+        timespec end_time;
+        t1_get_time(&start_time);
+
+        // worker 0 runs on this thread
+        for (u32 i = 1; i < worker_count; ++i)
+            if (!t1_thread_start(&workers[i].thread, _repeat_worker, workers + i))
+                worker_count = i;
+
+        _repeat_worker(workers);
+
+        for (u32 i = 1; i < worker_count; ++i)
+            t1_thread_join(&workers[i].thread);
+
+        t1_get_time(&end_time);
+
+        t1_array<double> durations;
+        init(&durations);
+
+        t1_perf_values perf{};
+        t1_allocation_stats allocations{};
+
+        for (u32 i = 0; i < worker_count; ++i)
+        {
+            t1_perf_add(&perf, &workers[i].perf);
+            t1_allocation_stats_add(&allocations, &workers[i].allocations);
+
+            if (workers[i].durations.size > 0)
+            {
+                double *dst = t1_add_elements(&durations, workers[i].durations.size);
+                ::memcpy(dst, workers[i].durations.data, sizeof(double) * workers[i].durations.size);
+            }
+
+            free(&workers[i].durations);
+        }
+
+        t1_free_memory(workers);
+
+        ::qsort(durations.data, durations.size, sizeof(double), _compare_doubles);
+
+        t1_repeat_result res{};
+        res.unit = unit;
+        res.iterations = durations.size;
+        res.iterations_failed = state.iterations_failed;
+        res.first_failed_iteration = state.first_failed_iteration;
+        res.first_failed_seed = seed + state.first_failed_iteration;
+        res.perf = perf;
+        res.allocations = allocations;
+
+        if (durations.size > 0)
+        {
+            res.min_seconds = durations[0];
+            res.median_seconds = durations[durations.size / 2];
+            res.max_seconds = durations[durations.size - 1];
+        }
+
+        // workers run in parallel, so the durations would add up to more than
+        // the time the run took
+        total_seconds += t1_get_seconds_difference(&start_time, &end_time);
+
+        free(&durations);
+
+        t1_add_at_end(&repeat_results, res);
+
+        last_passed = res.iterations_failed == 0;
+
+        if (!last_passed)
+            total_units_failed++;
+
+        double pct = res.iterations > 0 ? ((double)(res.iterations - res.iterations_failed) / (double)res.iterations) * 100 : 0.0;
+
+        printf("\n%s %s %s %s%llu%s of %llu iterations passed (%.4f%%)",
+               t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+               (last_passed ? t1_COLOR_PASSED : t1_COLOR_FAILED),
+               (unsigned long long)(res.iterations - res.iterations_failed), t1_COLOR_RESET,
+               (unsigned long long)res.iterations, pct);
+
+        if (!last_passed)
+            printf(", first failure at iteration %llu (%s--seed %llu%s)",
+                   (unsigned long long)res.first_failed_iteration,
+                   t1_COLOR_SOURCE, (unsigned long long)res.first_failed_seed, t1_COLOR_RESET);
+
+        printf("\n   min %.12fs, median %.12fs, max %.12fs",
+               res.min_seconds, res.median_seconds, res.max_seconds);
+
+#ifdef t1_track_allocations
+        printf(",");
+        t1_print_allocation_stats(&res.allocations, res.iterations);
+#endif
+
+        if (perf_counters)
+            t1_print_perf_values(&res.perf, res.iterations);
+    }
+
+    static void run_single(t1_unit *unit)
+    {
+        if (t1_tests::verbose)
+            printf("%s %s %s...", t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET);
+
+        bool captured = capture_output && t1_capture_begin();
+
+        double diff_seconds = 0;
+        last_passed = run_iteration(unit, 0, &diff_seconds);
+
+        if (captured)
+            t1_capture_end(!last_passed, capture_limit, unit->name);
+
+        total_seconds += diff_seconds;
+
+        if (last_passed)
+        {
+            if (t1_tests::verbose)
+                printf(" %spasses%s (%.12fs)", t1_COLOR_PASSED, t1_COLOR_RESET, diff_seconds);
+        }
+        else
+            total_units_failed++;
+
+#ifdef t1_track_allocations
+        bool result_line = true;
+#else
+        bool result_line = perf_counters;
+#endif
+
+        if (!result_line)
+            return;
+
+        // without -v the unit has no line yet, with -v its failure ended it
+        if (!t1_tests::verbose || !last_passed)
+            printf("%s %s %s(%.12fs)", t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET, diff_seconds);
+
+#ifdef t1_track_allocations
+        t1_print_allocation_stats(&last_allocation_stats);
+#endif
+
+        if (perf_counters)
+            t1_print_perf_values(&last_perf_values);
+
+        if (!t1_tests::verbose || !last_passed)
+            printf("\n");
+    }
+
+    // counts the journaled result of unit, returns false if unit has to run.
+    static bool resume_unit(t1_unit *unit, t1_journal_record *rec)
+    {
+        switch (rec->state)
+        {
+        case t1_journal_passed:
+        case t1_journal_failed:
+            total_asserts += rec->asserts;
+            total_asserts_failed += rec->asserts_failed;
+            total_seconds += rec->seconds;
+
+            if (rec->state == t1_journal_failed)
+                total_units_failed++;
+
+            if (t1_tests::verbose)
+                printf("%s %s %s... %s%s%s in the previous run\n", t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+                       rec->state == t1_journal_passed ? t1_COLOR_PASSED : t1_COLOR_FAILED,
+                       rec->state == t1_journal_passed ? "passed" : "failed",
+                       t1_COLOR_RESET);
+
+            return true;
+
+        case t1_journal_started:
+            printf("[%s%s:%u%s %s%s%s] %sthe previous run died while running this unit%s\n",
+                   t1_COLOR_SOURCE, unit->file, unit->line, t1_COLOR_RESET,
+                   t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+                   t1_COLOR_FAILED, t1_COLOR_RESET);
+
+            t1_atomic_store(&rec->state, (u32)t1_journal_crashed);
+            total_units_failed++;
+            return true;
+
+        case t1_journal_crashed:
+            printf("[%s%s:%u%s %s%s%s] %sa previous run died while running this unit%s\n",
+                   t1_COLOR_SOURCE, unit->file, unit->line, t1_COLOR_RESET,
+                   t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+                   t1_COLOR_FAILED, t1_COLOR_RESET);
+
+            total_units_failed++;
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+    // --journal or <test file>.journal, nullptr if there are no units
+    static const char *get_journal_path()
+    {
+        if (journal_path != nullptr)
+            return journal_path;
+
+        if (units.size > 0)
+            return t1_tprintf("%s.journal", units.data[0].file).data;
+
+        return nullptr;
+    }
+
+    static void run()
+    {
+        if (capture_output && !t1_Linux)
+            printf("%soutput capture is not supported on this platform%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+
+        if (profile_hz > 0 && !t1_PROFILER)
+            printf("%sprofiling is not supported on this platform%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+
+        if (perf_counters && !t1_perf_open(_t1_get_perf_group()))
+            printf("%sperf counters are not available, check /proc/sys/kernel/perf_event_paranoid%s\n",
+                   t1_COLOR_WARN, t1_COLOR_RESET);
+
+        t1_journal journal{};
+
+        if (journal_path != nullptr || resume)
+        {
+            const char *path = get_journal_path();
+
+            if (path == nullptr || !t1_journal_open(&journal, path, units.data, units.size, resume))
+                printf("%scould not open journal %s%s\n", t1_COLOR_WARN, path != nullptr ? path : "", t1_COLOR_RESET);
+        }
+
+        if (resume && journal.records != nullptr)
+        {
+            u64 resumed = 0;
+
+            for (u64 i = 0; i < units.size; ++i)
+                if (is_selected(units.data + i) && journal.records[i].state != t1_journal_not_run)
+                    resumed++;
+
+            printf("%sresuming, %llu units are not run again, their results are from the journal%s\n",
+                   t1_COLOR_WARN, (unsigned long long)resumed, t1_COLOR_RESET);
+        }
+
+        for (u64 i = 0; i < units.size; ++i)
+        {
+            t1_unit *unit = units.data + i;
+
+            if (!is_selected(unit) || unit->async_func != nullptr)
+                continue;
+
+            total_units++;
+
+            t1_journal_record *rec = journal.records != nullptr ? journal.records + i : nullptr;
+
+            if (rec != nullptr && resume_unit(unit, rec))
+                continue;
+
+            u32 asserts_before = total_asserts;
+            u32 asserts_failed_before = total_asserts_failed;
+            double seconds_before = total_seconds;
+
+            if (rec != nullptr)
+                t1_journal_begin_unit(rec);
+
+            if (record_impact)
+                t1_impact_begin_unit();
+
+            if (repeat_count > 0 || until_fail)
+                run_repeated(unit);
+            else
+                run_single(unit);
+
+            if (record_impact)
+                t1_impact_end_unit(i);
+
+            if (rec != nullptr)
+                t1_journal_end_unit(rec, last_passed,
+                                    total_asserts - asserts_before,
+                                    total_asserts_failed - asserts_failed_before,
+                                    total_seconds - seconds_before);
+        }
+
+        t1_journal_close(&journal);
+
+        if (record_impact)
+            t1_impact_begin_unit();
+
+        t1_run_async_units();
+
+        if (record_impact)
+        {
+            t1_impact_end_unit(units.size);
+            t1_impact_write();
+        }
+
+        if (profile_hz > 0)
+        {
+            if (verbose)
+                printf("\n");
+
+            t1_profile_write();
+        }
+    }
+};
+
+t1_array<t1_unit> t1_tests::units{};
+t1_array<const char*> t1_tests::filters{};
+t1_array<t1_repeat_result> t1_tests::repeat_results{};
+bool t1_tests::stop_on_fail = false;
+bool t1_tests::last_passed = false;
+bool t1_tests::verbose = false;
+thread_local bool t1_tests::current_unit_failed = false;
+bool t1_tests::unprintable_called = false;
+unsigned int t1_tests::total_units_failed = 0;
+unsigned int t1_tests::total_units = 0;
+unsigned int t1_tests::total_asserts_failed = 0;
+unsigned int t1_tests::total_asserts = 0;
+double t1_tests::total_seconds = 0.0;
+thread_local t1_unit* t1_tests::current_unit = 0;
+thread_local u64 t1_tests::current_iteration = 0;
+thread_local u64 t1_tests::current_seed = 0;
+thread_local s32 t1_tests::current_thread = -1;
+u64 t1_tests::repeat_count = 0;
+bool t1_tests::until_fail = false;
+u32 t1_tests::jobs = 1;
+u64 t1_tests::seed = 0;
+thread_local t1_perf_values t1_tests::last_perf_values{};
+thread_local t1_allocation_stats t1_tests::last_allocation_stats{};
+bool t1_tests::perf_counters = false;
+bool t1_tests::capture_output = false;
+u64 t1_tests::capture_limit = t1_CAPTURE_DEFAULT_LIMIT;
+const char *t1_tests::serve_path = nullptr;
+const char *t1_tests::connect_path = nullptr;
+bool t1_tests::update_snapshots = false;
+bool t1_tests::async_output = false;
+bool t1_tests::stress_jitter = false;
+u32 t1_tests::profile_hz = 0;
+const char *t1_tests::journal_path = nullptr;
+bool t1_tests::resume = false;
+bool t1_tests::list_units = false;
+bool t1_tests::fuzz = false;
+u32 t1_tests::fuzz_seconds = 0;
+u64 t1_tests::fuzz_runs = 0;
+u32 t1_tests::fuzz_workers = 1;
+u32 t1_tests::fuzz_timeout = 10;
+bool t1_tests::fuzz_minimize = false;
+const char *t1_tests::coordinate_path = nullptr;
+s32 t1_tests::coordinate_workers = -1;
+const char *t1_tests::worker_path = nullptr;
+const char *t1_tests::costs_path = nullptr;
+bool t1_tests::record_impact = false;
+const char *t1_tests::impact_index_path = nullptr;
+t1_array<const char*> t1_tests::changed{};
+const char *t1_tests::changed_list_path = nullptr;
+bool t1_tests::changed_binary = false;
+t1_array<u8> t1_tests::impacted{};
+
+static void _t1_thread_exit_cleanup()
+{
+    _t1_get_reporter_queue(true);
+    _t1_profile_thread_cleanup();
+    t1_perf_close(_t1_get_perf_group());
+    _t1_format_buffer_cleanup();
+}
+
+void t1_set_unprintable_was_called()
+{
+    t1_atomic_store(&t1_tests::unprintable_called, true);
+}
+
+// the unit asserts are attributed to, including the thread in stress tests
+static const char *t1_current_unit_label()
+{
+    if (t1_tests::current_unit == nullptr)
+        return "<no unit>";
+
+    if (t1_tests::current_thread < 0)
+        return t1_tests::current_unit->name;
+
+    return t1_tprintf("%s thread %d", t1_tests::current_unit->name, t1_tests::current_thread).data;
+}
+
+#define ASSERT_FAILED2(INFO, ASRT, VALUE, EXPECTED, DESC)\
+{\
+    printf("\n[%s%s:%d%s %s%s%s] %sassert failed:%s\n  " ASRT "(%s, %s)\n  %s%s%s " DESC " %s%s%s\n",\
+           t1_COLOR_SOURCE, INFO.file, info.line,\
+           t1_COLOR_RESET, t1_COLOR_TEST_NAME, t1_current_unit_label(),\
+           t1_COLOR_RESET,\
+           t1_COLOR_EXCEPTION, t1_COLOR_RESET,\
+           INFO.str1, INFO.str2,\
+           t1_COLOR_CHECK_ACTUAL, t1_to_string(VALUE).data, t1_COLOR_RESET,\
+           t1_COLOR_CHECK_EXPECTED, t1_to_string(EXPECTED).data,\
+           t1_COLOR_RESET);\
+\
+    t1_tests::current_unit_failed = true;\
+}
+
+#define define_test(NAME) \
+    static void JOIN3(test_, NAME, _f)();\
+    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
+            t1_unit{#NAME, JOIN3(test_, NAME, _f), t1_get_filename(__FILE__), __LINE__}); } \
+    static void JOIN3(test_, NAME, _f)()
+
+#define DEFINE_ASSERT_OP2(NAME, OP, FAILDESC)\
+template<typename T1, typename T2>\
+bool JOIN(NAME, _)(const t1_assert_info &info, T1 &&val, T2 &&expected)\
+{\
+    t1_atomic_add(&t1_tests::total_asserts, 1u);\
+\
+    if (val OP expected)\
+        return true;\
+\
+    t1_atomic_add(&t1_tests::total_asserts_failed, 1u);\
+    ASSERT_FAILED2(info, #NAME, val, expected, FAILDESC);\
+    return false;\
+}
+
+DEFINE_ASSERT_OP2(assert_equal, ==, "does not equal expected value");
+DEFINE_ASSERT_OP2(assert_not_equal, !=, "equals unexpected value");
+DEFINE_ASSERT_OP2(assert_greater, >, "is not greater than");
+DEFINE_ASSERT_OP2(assert_greater_or_equal, >=, "is not greater or equal to");
+DEFINE_ASSERT_OP2(assert_less, <, "is not less than");
+DEFINE_ASSERT_OP2(assert_less_or_equal, <=, "is not less or equal to");
+
+
+// used internally
+#define ASSERT_GENERIC2(ASRT, EXPR, EXPECTED) \
+    {\
+        if (! ASRT(t1_assert_info{t1_get_filename(__FILE__), __LINE__, #EXPR, #EXPECTED}, EXPR, EXPECTED) && t1_tests::stop_on_fail)\
+            return;\
+    }
+
+// same as ASSERT_GENERIC2, for coroutines
+#define CO_ASSERT_GENERIC2(ASRT, EXPR, EXPECTED) \
+    {\
+        if (! ASRT(t1_assert_info{t1_get_filename(__FILE__), __LINE__, #EXPR, #EXPECTED}, EXPR, EXPECTED) && t1_tests::stop_on_fail)\
+            co_return;\
+    }
+
+#define assert_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_equal_, EXPR, EXPECTED)
+#define assert_not_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_not_equal_, EXPR, EXPECTED)
+#define assert_greater(EXPR, EXPECTED) ASSERT_GENERIC2(assert_greater_, EXPR, EXPECTED)
+#define assert_greater_or_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_greater_or_equal_, EXPR, EXPECTED)
+#define assert_less(EXPR, EXPECTED) ASSERT_GENERIC2(assert_less_, EXPR, EXPECTED)
+#define assert_less_or_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_less_or_equal_, EXPR, EXPECTED)
+
+// allocation budget scopes, e.g.
+//
+//     assert_max_allocations(0)
+//     {
+//         hot_path();
+//     }
+//
+// fails if more heap calls (or bytes) than allowed were made inside the
+// scope on the current thread and prints where they were made.
+// requires t1_track_allocations to be defined before including t1.hpp.
+struct t1_allocation_scope
+{
+    t1_assert_info info;
+    u64 max_allocations;
+    u64 max_bytes;
+
+    t1_allocation_scope *parent;
+    u64 allocations;
+    u64 bytes_allocated;
+    void *sites[t1_ALLOCATION_SCOPE_MAX_SITES];
+    u64 site_sizes[t1_ALLOCATION_SCOPE_MAX_SITES];
+    u32 site_count;
+    u32 step;
+
+    ~t1_allocation_scope()
+    {
+        // left using break / return
+        if (step == 1)
+            _t1_get_allocation_state()->scope = parent;
+    }
+};
+
+[[maybe_unused]] static void _t1_record_allocation(void *site, u64 size)
+{
+    _t1_allocation_state *state = _t1_get_allocation_state();
+
+    if (!state->enabled)
+        return;
+
+    state->stats.allocations++;
+    state->stats.bytes_allocated += size;
+
+    for (t1_allocation_scope *scope = state->scope; scope != nullptr; scope = scope->parent)
+    {
+        scope->allocations++;
+        scope->bytes_allocated += size;
+
+        if (scope->site_count < t1_ALLOCATION_SCOPE_MAX_SITES)
+        {
+            scope->sites[scope->site_count] = site;
+            scope->site_sizes[scope->site_count] = size;
+            scope->site_count++;
+        }
+    }
+}
+
+[[maybe_unused]] static void _t1_record_live_bytes(s64 delta)
+{
+    _t1_allocation_state *state = _t1_get_allocation_state();
+
+    if (!state->enabled)
+        return;
+
+    state->stats.live_bytes += delta;
+
+    if (state->stats.live_bytes > state->stats.peak_bytes)
+        state->stats.peak_bytes = state->stats.live_bytes;
+}
+
+static void _t1_print_allocation_site(void *site, u64 size)
+{
+#if t1_Linux && defined(t1_track_allocations)
+    Dl_info dl;
+
+    if (::dladdr(site, &dl) != 0 && dl.dli_fname != nullptr)
+    {
+        printf("    %s%s+%#llx%s", t1_COLOR_SOURCE, t1_get_filename(dl.dli_fname),
+               (unsigned long long)((char*)site - (char*)dl.dli_fbase), t1_COLOR_RESET);
+
+        if (dl.dli_sname != nullptr)
+            printf(" (%s+%#llx)", dl.dli_sname, (unsigned long long)((char*)site - (char*)dl.dli_saddr));
+
+        printf(" %llu bytes\n", (unsigned long long)size);
+        return;
+    }
+#endif
+
+    printf("    %s%p%s %llu bytes\n", t1_COLOR_SOURCE, site, t1_COLOR_RESET, (unsigned long long)size);
+}
+
+// first call registers the scope, second call checks the budget.
+[[maybe_unused]] static bool t1_allocation_scope_step(t1_allocation_scope *scope)
+{
+    _t1_allocation_state *state = _t1_get_allocation_state();
+
+    if (scope->step == 0)
+    {
+        scope->step = 1;
+        scope->parent = state->scope;
+        state->scope = scope;
+        return true;
+    }
+
+    scope->step = 2;
+    state->scope = scope->parent;
+
+    t1_atomic_add(&t1_tests::total_asserts, 1u);
+
+    bool too_many = scope->allocations > scope->max_allocations;
+    bool too_big = scope->bytes_allocated > scope->max_bytes;
+
+    if (!too_many && !too_big)
+        return false;
+
+    t1_atomic_add(&t1_tests::total_asserts_failed, 1u);
+    t1_tests::current_unit_failed = true;
+
+    printf("\n[%s%s:%d%s %s%s%s] %sassert failed:%s\n  %s(%s)\n  ",
+           t1_COLOR_SOURCE, scope->info.file, scope->info.line,
+           t1_COLOR_RESET, t1_COLOR_TEST_NAME, t1_current_unit_label(),
+           t1_COLOR_RESET,
+           t1_COLOR_EXCEPTION, t1_COLOR_RESET,
+           scope->info.str1, scope->info.str2);
+
+    if (too_many)
+        printf("%s%llu%s allocations exceed the budget of %s%llu%s\n",
+               t1_COLOR_CHECK_ACTUAL, (unsigned long long)scope->allocations, t1_COLOR_RESET,
+               t1_COLOR_CHECK_EXPECTED, (unsigned long long)scope->max_allocations, t1_COLOR_RESET);
+    else
+        printf("%s%llu%s bytes allocated exceed the budget of %s%llu%s\n",
+               t1_COLOR_CHECK_ACTUAL, (unsigned long long)scope->bytes_allocated, t1_COLOR_RESET,
+               t1_COLOR_CHECK_EXPECTED, (unsigned long long)scope->max_bytes, t1_COLOR_RESET);
+
+    printf("  allocated at:\n");
+
+    for (u32 i = 0; i < scope->site_count; ++i)
+        _t1_print_allocation_site(scope->sites[i], scope->site_sizes[i]);
+
+    if (scope->allocations > scope->site_count)
+        printf("    ... and %llu more\n", (unsigned long long)(scope->allocations - scope->site_count));
+
+    return false;
+}
+
+#define _t1_ALLOCATION_SCOPE(STR, MAX_ALLOCS, MAX_BYTES, EXPR)\
+    for (t1_allocation_scope JOIN(_t1_alloc_scope, __LINE__){t1_assert_info{t1_get_filename(__FILE__), __LINE__, STR, #EXPR}, MAX_ALLOCS, MAX_BYTES, nullptr, 0, 0, {}, {}, 0, 0};\
+         t1_allocation_scope_step(&JOIN(_t1_alloc_scope, __LINE__));)
+
+#define assert_max_allocations(N) _t1_ALLOCATION_SCOPE("assert_max_allocations", (u64)(N), UINT64_MAX, N)
+#define assert_max_bytes_allocated(N) _t1_ALLOCATION_SCOPE("assert_max_bytes_allocated", UINT64_MAX, (u64)(N), N)
+
+#ifdef t1_track_allocations
+#if t1_Linux && defined(__GLIBC__)
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+#ifdef t1_guard_allocations
+// ---------- GUARD PAGES ----------
+// with t1_guard_allocations defined before including t1.hpp, every heap
+// allocation a unit makes on its own thread gets pages of its own inside a
+// reserved address range, with the end of the allocation flush against an
+// inaccessible guard page. freed allocations are made inaccessible and their
+// addresses are never handed out again (until the range is used up), so
+// overruns and uses after free fault right away. the SIGSEGV handler then
+// prints the unit and where the memory was allocated (and freed).
+// allocations are aligned to t1_GUARD_ALIGNMENT, which leaves up to
+// t1_GUARD_ALIGNMENT - 1 unguarded bytes after an allocation; define it as
+// 1 to catch every overrun, at the cost of misaligned memory.
+// every allocation takes at least two pages of address space and one page
+// of memory.
+#ifndef t1_GUARD_ALIGNMENT
+#define t1_GUARD_ALIGNMENT 16
+#endif
+
+#define t1_GUARD_ARENA_SIZE (64ull << 30)
+#define t1_GUARD_MAX_RECORDS (1ull << 24)
+
+struct _t1_guard_record
+{
+    char *start;     // first page
+    u64 pages;       // data pages, followed by the guard page
+    char *ptr;
+    u64 size;
+    void *site;
+    void *free_site;
+    const char *unit;
+    bool freed;
+};
+
+struct _t1_guard_arena
+{
+    u32 lock;
+    bool initialized;
+    bool failed;
+    bool exhausted;
+
+    char *base;
+    u64 used;
+    u64 page_size;
+
+    // sorted by address, since addresses are never reused
+    _t1_guard_record *records;
+    u64 record_count;
+};
+
+static _t1_guard_arena *_t1_get_guard_arena()
+{
+    static _t1_guard_arena _arena{};
+    return &_arena;
+}
+
+// the record whose pages (including the guard page) contain address, or nullptr.
+// doesn't lock, also used by the signal handler.
+static _t1_guard_record *_t1_guard_find(_t1_guard_arena *a, const void *address)
+{
+    s64 lo = 0;
+    s64 hi = (s64)t1_atomic_load(&a->record_count) - 1;
+    _t1_guard_record *found = nullptr;
+
+    while (lo <= hi)
+    {
+        s64 mid = (lo + hi) / 2;
+
+        if (a->records[mid].start <= (const char*)address)
+        {
+            found = a->records + mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    if (found == nullptr || (const char*)address >= found->start + (found->pages + 1) * a->page_size)
+        return nullptr;
+
+    return found;
+}
+
+static bool _t1_guard_contains(_t1_guard_arena *a, const void *address)
+{
+    return t1_atomic_load(&a->initialized)
+        && (const char*)address >= a->base && (const char*)address < a->base + t1_GUARD_ARENA_SIZE;
+}
+
+static void _t1_guard_write(const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    if (n > 0)
+        t1_io_write(_stderr(), buf, (u64)n < sizeof(buf) ? (u64)n : sizeof(buf) - 1);
+}
+
+static void _t1_guard_write_site(const char *what, void *site)
+{
+    Dl_info dl;
+
+    if (site != nullptr && ::dladdr(site, &dl) != 0 && dl.dli_fname != nullptr)
+    {
+        _t1_guard_write("  %s at %s%s+%#llx%s", what, t1_COLOR_SOURCE, t1_get_filename(dl.dli_fname),
+                        (unsigned long long)((char*)site - (char*)dl.dli_fbase), t1_COLOR_RESET);
+
+        if (dl.dli_sname != nullptr)
+            _t1_guard_write(" (%s+%#llx)", dl.dli_sname, (unsigned long long)((char*)site - (char*)dl.dli_saddr));
+
+        _t1_guard_write("\n");
+    }
+    else
+        _t1_guard_write("  %s at %s%p%s\n", what, t1_COLOR_SOURCE, site, t1_COLOR_RESET);
+}
+
+static void _t1_guard_write_record(_t1_guard_record *rec)
+{
+    _t1_guard_write_site("allocated", rec->site);
+
+    if (rec->unit != nullptr)
+        _t1_guard_write("  by unit %s%s%s\n", t1_COLOR_TEST_NAME, rec->unit, t1_COLOR_RESET);
+
+    if (rec->freed)
+        _t1_guard_write_site("freed", rec->free_site);
+}
+
+static void _t1_guard_signal_handler(int sig, siginfo_t *info, void *)
+{
+    _t1_guard_arena *a = _t1_get_guard_arena();
+    void *address = info->si_addr;
+
+    if (_t1_guard_contains(a, address))
+    {
+        _t1_guard_record *rec = _t1_guard_find(a, address);
+        const char *unit = t1_tests::current_unit != nullptr ? t1_tests::current_unit->name : "<no unit>";
+
+        _t1_guard_write("\n[%s%s%s] %s", t1_COLOR_TEST_NAME, unit, t1_COLOR_RESET, t1_COLOR_FAILED);
+
+        if (rec == nullptr)
+            _t1_guard_write("invalid access to guarded heap address %p%s\n", address, t1_COLOR_RESET);
+        else if (rec->freed)
+            _t1_guard_write("use after free: %p is %lld bytes into a freed allocation of %llu bytes%s\n",
+                            address, (long long)((char*)address - rec->ptr), (unsigned long long)rec->size, t1_COLOR_RESET);
+        else if ((char*)address >= rec->ptr + rec->size)
+            _t1_guard_write("heap buffer overflow: %p is %llu bytes after an allocation of %llu bytes%s\n",
+                            address, (unsigned long long)((char*)address - (rec->ptr + rec->size)),
+                            (unsigned long long)rec->size, t1_COLOR_RESET);
+        else
+            _t1_guard_write("heap buffer underflow: %p is %llu bytes before an allocation of %llu bytes%s\n",
+                            address, (unsigned long long)(rec->ptr - (char*)address),
+                            (unsigned long long)rec->size, t1_COLOR_RESET);
+
+        if (rec != nullptr)
+            _t1_guard_write_record(rec);
+    }
+
+    // let the default action (core dump / death test result) happen
+    ::signal(sig, SIG_DFL);
+    ::raise(sig);
+}
+
+static bool _t1_guard_init(_t1_guard_arena *a)
+{
+    if (t1_atomic_load(&a->initialized))
+        return true;
+
+    if (a->failed)
+        return false;
+
+    a->page_size = (u64)sysconf(_SC_PAGESIZE);
+
+    void *base = ::mmap(nullptr, t1_GUARD_ARENA_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void *records = ::mmap(nullptr, t1_GUARD_MAX_RECORDS * sizeof(_t1_guard_record), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (base == MAP_FAILED || records == MAP_FAILED)
+    {
+        a->failed = true;
+        return false;
+    }
+
+    a->base = (char*)base;
+    a->records = (_t1_guard_record*)records;
+
+    struct sigaction sa{};
+    sa.sa_sigaction = _t1_guard_signal_handler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    ::sigaction(SIGSEGV, &sa, nullptr);
+
+    t1_atomic_store(&a->initialized, true);
+
+    return true;
+}
+
+// returns nullptr if the allocation can't be guarded, the caller then uses
+// the regular heap.
+static void *_t1_guard_malloc(u64 size, u64 alignment, void *site)
+{
+    if (alignment < t1_GUARD_ALIGNMENT)
+        alignment = t1_GUARD_ALIGNMENT;
+
+    _t1_guard_arena *a = _t1_get_guard_arena();
+
+    _t1_spin_lock(&a->lock);
+
+    if (!_t1_guard_init(a) || a->exhausted || alignment > a->page_size)
+    {
+        _t1_spin_unlock(&a->lock);
+        return nullptr;
+    }
+
+    u64 data = size > 0 ? t1_ceil_multiple2(size, alignment) : alignment;
+    u64 pages = t1_ceil_multiple2(data, a->page_size) / a->page_size;
+    u64 total = (pages + 1) * a->page_size;
+
+    if (a->used + total > t1_GUARD_ARENA_SIZE || a->record_count >= t1_GUARD_MAX_RECORDS)
+    {
+        a->exhausted = true;
+        _t1_spin_unlock(&a->lock);
+
+        _t1_guard_write("%sguarded heap exhausted, further allocations are not guarded%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+        return nullptr;
+    }
+
+    char *start = a->base + a->used;
+    char *ptr = start + pages * a->page_size - data;
+
+    if (::mprotect(start, pages * a->page_size, PROT_READ | PROT_WRITE) != 0)
+    {
+        // e.g. vm.max_map_count reached, every guarded allocation is its own
+        // mapping, so further ones would fail as well
+        int error = errno;
+        a->exhausted = true;
+        _t1_spin_unlock(&a->lock);
+
+        _t1_guard_write("%scould not guard an allocation (%s), further allocations are not guarded, "
+                        "see /proc/sys/vm/max_map_count%s\n", t1_COLOR_WARN, strerror(error), t1_COLOR_RESET);
+        return nullptr;
+    }
+
+    a->used += total;
+
+    const char *unit = t1_tests::current_unit != nullptr ? t1_tests::current_unit->name : nullptr;
+    a->records[a->record_count] = _t1_guard_record{start, pages, ptr, size, site, nullptr, unit, false};
+    t1_atomic_store(&a->record_count, a->record_count + 1);
+
+    _t1_spin_unlock(&a->lock);
+
+    return ptr;
+}
+
+// returns false if ptr is not guarded.
+static bool _t1_guard_free(void *ptr, void *site)
+{
+    _t1_guard_arena *a = _t1_get_guard_arena();
+
+    if (!_t1_guard_contains(a, ptr))
+        return false;
+
+    _t1_spin_lock(&a->lock);
+
+    _t1_guard_record *rec = _t1_guard_find(a, ptr);
+
+    if (rec == nullptr || rec->ptr != (char*)ptr || rec->freed)
+    {
+        _t1_spin_unlock(&a->lock);
+
+        _t1_guard_write("\n%s%s of %p%s\n", t1_COLOR_FAILED,
+                        rec != nullptr && rec->freed ? "double free" : "free of a pointer that was not allocated",
+                        ptr, t1_COLOR_RESET);
+
+        _t1_guard_write_site("freed", site);
+
+        if (rec != nullptr)
+            _t1_guard_write_record(rec);
+
+        ::abort();
+    }
+
+    rec->freed = true;
+    rec->free_site = site;
+
+    // gives the memory back, the address range stays reserved (quarantined)
+    ::mmap(rec->start, rec->pages * a->page_size, PROT_NONE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    _t1_spin_unlock(&a->lock);
+
+    return true;
+}
+
+static u64 _t1_guard_usable_size(void *ptr)
+{
+    _t1_guard_record *rec = _t1_guard_find(_t1_get_guard_arena(), ptr);
+    return rec != nullptr ? rec->size : 0;
+}
+
+static inline bool _t1_should_guard()
+{
+    return _t1_get_allocation_state()->enabled;
+}
+#endif // t1_guard_allocations
+
+static inline void *_t1_heap_malloc(size_t size, size_t alignment, void *site)
+{
+#ifdef t1_guard_allocations
+    if (_t1_should_guard())
+        if (void *ret = _t1_guard_malloc(size, alignment, site))
+            return ret;
+#else
+    (void)site;
+#endif
+
+    return alignment > 16 ? __libc_memalign(alignment, size) : __libc_malloc(size);
+}
+
+static inline void _t1_heap_free(void *ptr, void *site)
+{
+#ifdef t1_guard_allocations
+    if (_t1_guard_free(ptr, site))
+        return;
+#else
+    (void)site;
+#endif
+
+    __libc_free(ptr);
+}
+
+static inline u64 _t1_heap_usable_size(void *ptr)
+{
+#ifdef t1_guard_allocations
+    if (_t1_guard_contains(_t1_get_guard_arena(), ptr))
+        return _t1_guard_usable_size(ptr);
+#endif
+
+    return malloc_usable_size(ptr);
+}
+
+#define _t1_raw_malloc(Size, Site)             _t1_heap_malloc(Size, 16, Site)
+#define _t1_raw_aligned_malloc(Al, Size, Site) _t1_heap_malloc(Size, Al, Site)
+#define _t1_raw_free(Ptr, Site)                _t1_heap_free(Ptr, Site)
+#define _t1_usable_size(Ptr)                   _t1_heap_usable_size(Ptr)
+
+// interpose the C allocation functions of glibc
+extern "C" void *malloc(size_t size) noexcept
+{
+    void *ret = _t1_heap_malloc(size, 16, __builtin_return_address(0));
+
+    if (ret != nullptr)
+    {
+        _t1_record_allocation(__builtin_return_address(0), size);
+        _t1_record_live_bytes((s64)_t1_heap_usable_size(ret));
+    }
+
+    return ret;
+}
+
+extern "C" void *calloc(size_t n, size_t size) noexcept
+{
+#ifdef t1_guard_allocations
+    // guarded memory is fresh pages, so already zeroed
+    void *ret = nullptr;
+
+    if (_t1_should_guard() && (size == 0 || n <= (size_t)-1 / size))
+        ret = _t1_guard_malloc(n * size, 16, __builtin_return_address(0));
+
+    if (ret == nullptr)
+        ret = __libc_calloc(n, size);
+#else
+    void *ret = __libc_calloc(n, size);
+#endif
+
+    if (ret != nullptr)
+    {
+        _t1_record_allocation(__builtin_return_address(0), n * size);
+        _t1_record_live_bytes((s64)_t1_heap_usable_size(ret));
+    }
+
+    return ret;
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    s64 old_size = ptr != nullptr ? (s64)_t1_heap_usable_size(ptr) : 0;
+
+#ifdef t1_guard_allocations
+    // guarded memory can't grow in place, and new memory should be guarded
+    if ((ptr != nullptr && _t1_guard_contains(_t1_get_guard_arena(), ptr)) || _t1_should_guard())
+    {
+        void *ret = nullptr;
+
+        if (size > 0 || ptr == nullptr)
+        {
+            ret = _t1_heap_malloc(size, 16, __builtin_return_address(0));
+
+            if (ret == nullptr)
+                return nullptr;
+
+            if (ptr != nullptr)
+                ::memcpy(ret, ptr, (u64)old_size < size ? (u64)old_size : size);
+
+            _t1_record_allocation(__builtin_return_address(0), size);
+            _t1_record_live_bytes((s64)_t1_heap_usable_size(ret));
+        }
+
+        if (ptr != nullptr)
+        {
+            _t1_record_live_bytes(-old_size);
+            _t1_heap_free(ptr, __builtin_return_address(0));
+        }
+
+        return ret;
+    }
+#endif
+
+    void *ret = __libc_realloc(ptr, size);
+
+    if (ret != nullptr)
+    {
+        _t1_record_allocation(__builtin_return_address(0), size);
+        _t1_record_live_bytes((s64)malloc_usable_size(ret) - old_size);
+    }
+    else if (size == 0)
+        _t1_record_live_bytes(-old_size);
+
+    return ret;
+}
+
+extern "C" void free(void *ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+
+    _t1_record_live_bytes(-(s64)_t1_heap_usable_size(ptr));
+    _t1_heap_free(ptr, __builtin_return_address(0));
+}
+
+// the aligned allocations are freed with free too, so they have to be
+// counted for live bytes to add up
+static inline void *_t1_aligned_malloc(size_t alignment, size_t size, void *site)
+{
+    void *ret = _t1_heap_malloc(size, alignment, site);
+
+    if (ret != nullptr)
+    {
+        _t1_record_allocation(site, size);
+        _t1_record_live_bytes((s64)_t1_heap_usable_size(ret));
+    }
+
+    return ret;
+}
+
+extern "C" int posix_memalign(void **out, size_t alignment, size_t size) noexcept
+{
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+
+    void *ret = _t1_aligned_malloc(alignment, size, __builtin_return_address(0));
+
+    if (ret == nullptr)
+        return ENOMEM;
+
+    *out = ret;
+    return 0;
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    return _t1_aligned_malloc(alignment, size, __builtin_return_address(0));
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) noexcept
+{
+    // glibc rounds up to a power of two
+    size_t al = alignment < 16 ? 16 : alignment;
+
+    while ((al & (al - 1)) != 0)
+        al += al & -al;
+
+    return _t1_aligned_malloc(al, size, __builtin_return_address(0));
+}
+#elif t1_Windows
+#define _t1_raw_malloc(Size, Site)             ::malloc(Size)
+#define _t1_raw_free(Ptr, Site)                ::free(Ptr)
+#define _t1_usable_size(Ptr)                   _msize(Ptr)
+#else
+#define _t1_raw_malloc(Size, Site)             ::malloc(Size)
+#define _t1_raw_aligned_malloc(Al, Size, Site) ::aligned_alloc(Al, t1_ceil_multiple2(Size, Al))
+#define _t1_raw_free(Ptr, Site)                ::free(Ptr)
+#define _t1_usable_size(Ptr)                   0
+#endif
+
+// replacing operator new directly (instead of only counting malloc)
+// attributes allocations to the caller of new, not to the C++ runtime.
+static inline void *_t1_operator_new(size_t size, void *site, bool nothrow)
+{
+    if (size == 0)
+        size = 1;
+
+    void *ret = _t1_raw_malloc(size, site);
+
+    if (ret == nullptr)
+    {
+        if (nothrow)
+            return nullptr;
+
+        // no exceptions
+        ::abort();
+    }
+
+    _t1_record_allocation(site, size);
+    _t1_record_live_bytes((s64)_t1_usable_size(ret));
+
+    return ret;
+}
+
+static inline void _t1_operator_delete(void *ptr, void *site)
+{
+    if (ptr == nullptr)
+        return;
+
+    _t1_record_live_bytes(-(s64)_t1_usable_size(ptr));
+    _t1_raw_free(ptr, site);
+}
+
+void *operator new(size_t size)   { return _t1_operator_new(size, __builtin_return_address(0), false); }
+void *operator new[](size_t size) { return _t1_operator_new(size, __builtin_return_address(0), false); }
+void *operator new(size_t size, const std::nothrow_t&) noexcept   { return _t1_operator_new(size, __builtin_return_address(0), true); }
+void *operator new[](size_t size, const std::nothrow_t&) noexcept { return _t1_operator_new(size, __builtin_return_address(0), true); }
+
+void operator delete(void *ptr) noexcept   { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete[](void *ptr) noexcept { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete(void *ptr, size_t) noexcept   { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete[](void *ptr, size_t) noexcept { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept   { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+
+#ifdef _t1_raw_aligned_malloc
+static inline void *_t1_operator_new_aligned(size_t size, std::align_val_t al, void *site, bool nothrow)
+{
+    if (size == 0)
+        size = 1;
+
+    void *ret = _t1_raw_aligned_malloc((size_t)al, size, site);
+
+    if (ret == nullptr)
+    {
+        if (nothrow)
+            return nullptr;
+
+        ::abort();
+    }
+
+    _t1_record_allocation(site, size);
+    _t1_record_live_bytes((s64)_t1_usable_size(ret));
+
+    return ret;
+}
+
+void *operator new(size_t size, std::align_val_t al)   { return _t1_operator_new_aligned(size, al, __builtin_return_address(0), false); }
+void *operator new[](size_t size, std::align_val_t al) { return _t1_operator_new_aligned(size, al, __builtin_return_address(0), false); }
+void *operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept   { return _t1_operator_new_aligned(size, al, __builtin_return_address(0), true); }
+void *operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept { return _t1_operator_new_aligned(size, al, __builtin_return_address(0), true); }
+
+void operator delete(void *ptr, std::align_val_t) noexcept   { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept   { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept { _t1_operator_delete(ptr, __builtin_return_address(0)); }
+#endif
+#endif // t1_track_allocations
+
+// ---------- DEATH TESTS ----------
+// assert_death(expr, expected, stderr_pattern) evaluates expr in a forked
+// child and checks how the child ended:
+//
+//     t1_killed_by(SIGABRT)   killed by the given signal
+//     t1_exited(3)            exited with the given status
+//     t1_dies                 killed by any signal or exited with a non-zero status
+//
+// and whether its stderr contains stderr_pattern (a glob, nullptr matches
+// anything). checks don't block: the children of a unit run concurrently and
+// are evaluated when the unit ends, or when t1_wait_deaths() is called.
+// related forms: assert_dies(expr), assert_exit(expr, status),
+// assert_signal(expr, signal).
+#define t1_DEATH_TEST_TIMEOUT_SECONDS 30
+#define t1_DEATH_TEST_MAX_SHOWN_OUTPUT 1024
+
+enum t1_death_kind
+{
+    t1_death_any,
+    t1_death_exit,
+    t1_death_signal
+};
+
+struct t1_death_expectation
+{
+    t1_death_kind kind;
+    int value;
+};
+
+static inline t1_death_expectation t1_killed_by(int sig) { return t1_death_expectation{t1_death_signal, sig}; }
+static inline t1_death_expectation t1_exited(int status) { return t1_death_expectation{t1_death_exit, status}; }
+#define t1_dies (t1_death_expectation{t1_death_any, 0})
+
+struct t1_death_check
+{
+    t1_assert_info info;
+    const char *assert_name;
+    t1_death_expectation expected;
+    const char *pattern;
+    t1_unit *unit;
+    int pid;
+    int output_fd;
+    timespec start_time;
+};
+
+static t1_array<t1_death_check> *_t1_get_death_checks()
+{
+    static thread_local t1_array<t1_death_check> _checks{};
+    return &_checks;
+}
+
+#if t1_Linux || t1_Mac
+static u32 _t1_max_concurrent_deaths()
+{
+    return t1_get_processor_count() * 2;
+}
+
+static void _t1_describe_status(int status, char *out, u64 size)
+{
+    if (WIFEXITED(status))
+        snprintf(out, size, "exited with status %d", WEXITSTATUS(status));
+    else if (WIFSIGNALED(status))
+        snprintf(out, size, "was killed by signal %d (%s)", WTERMSIG(status), strsignal(WTERMSIG(status)));
+    else
+        snprintf(out, size, "ended with wait status %d", status);
+}
+
+static void _t1_describe_expectation(t1_death_expectation e, char *out, u64 size)
+{
+    if (e.kind == t1_death_exit)
+        snprintf(out, size, "exit with status %d", e.value);
+    else if (e.kind == t1_death_signal)
+        snprintf(out, size, "be killed by signal %d (%s)", e.value, strsignal(e.value));
+    else
+        snprintf(out, size, "die");
+}
+
+static bool _t1_death_status_matches(t1_death_expectation e, int status)
+{
+    switch (e.kind)
+    {
+    case t1_death_exit:   return WIFEXITED(status) && WEXITSTATUS(status) == e.value;
+    case t1_death_signal: return WIFSIGNALED(status) && WTERMSIG(status) == e.value;
+    case t1_death_any:    return WIFSIGNALED(status) || (WIFEXITED(status) && WEXITSTATUS(status) != 0);
+    }
+
+    return false;
+}
+
+// waits for the child of check, killing it after the timeout, and reports the result.
+static void _t1_finish_death_check(t1_death_check *check)
+{
+    _t1_SUSPEND_HOOKS();
+
+    int status = 0;
+    bool timed_out = false;
+    u32 sleep_us = 50;
+
+    while (::waitpid(check->pid, &status, WNOHANG) == 0)
+    {
+        timespec now;
+        t1_get_time(&now);
+
+        if (!timed_out && t1_get_seconds_difference(&check->start_time, &now) > t1_DEATH_TEST_TIMEOUT_SECONDS)
+        {
+            ::kill(check->pid, SIGKILL);
+            timed_out = true;
+        }
+
+        ::usleep(sleep_us);
+
+        if (sleep_us < 1000)
+            sleep_us *= 2;
+    }
+
+    // read the captured stderr
+    s64 size = (s64)::lseek(check->output_fd, 0, SEEK_END);
+    char *output = nullptr;
+
+    if (size < 0)
+        size = 0;
+
+    output = (char*)t1_reallocate_memory(nullptr, (u64)size + 1);
+    s64 read_size = size > 0 ? ::pread(check->output_fd, output, (u64)size, 0) : 0;
+    output[read_size > 0 ? read_size : 0] = '\0';
+    ::close(check->output_fd);
+
+    defer { t1_free_memory(output); };
+
+    bool status_matches = !timed_out && _t1_death_status_matches(check->expected, status);
+    bool output_matches = check->pattern == nullptr
+                       || check->pattern[0] == '\0'
+                       || t1_glob_match(t1_tprintf("*%s*", check->pattern).data, output);
+
+    t1_atomic_add(&t1_tests::total_asserts, 1u);
+
+    if (status_matches && output_matches)
+        return;
+
+    t1_atomic_add(&t1_tests::total_asserts_failed, 1u);
+    t1_tests::current_unit_failed = true;
+
+    char actual[128];
+    char expected[128];
+
+    if (timed_out)
+        snprintf(actual, sizeof(actual), "did not die within %d seconds", t1_DEATH_TEST_TIMEOUT_SECONDS);
+    else
+        _t1_describe_status(status, actual, sizeof(actual));
+
+    _t1_describe_expectation(check->expected, expected, sizeof(expected));
+
+    printf("\n[%s%s:%d%s %s%s%s] %sassert failed:%s\n  %s(%s%s%s)\n  child %s%s%s, expected it to %s%s%s\n",
+           t1_COLOR_SOURCE, check->info.file, check->info.line,
+           t1_COLOR_RESET, t1_COLOR_TEST_NAME, check->unit->name,
+           t1_COLOR_RESET,
+           t1_COLOR_EXCEPTION, t1_COLOR_RESET,
+           check->assert_name, check->info.str1,
+           (check->info.str2 != nullptr ? ", " : ""), (check->info.str2 != nullptr ? check->info.str2 : ""),
+           t1_COLOR_CHECK_ACTUAL, actual, t1_COLOR_RESET,
+           t1_COLOR_CHECK_EXPECTED, expected, t1_COLOR_RESET);
+
+    if (!output_matches)
+        printf("  stderr does not contain %s%s%s\n", t1_COLOR_CHECK_EXPECTED, check->pattern, t1_COLOR_RESET);
+
+    if (read_size > 0)
+    {
+        printf("  stderr of child:\n");
+        t1_output_write(output, read_size > t1_DEATH_TEST_MAX_SHOWN_OUTPUT ? t1_DEATH_TEST_MAX_SHOWN_OUTPUT : (u64)read_size);
+        printf("\n");
+    }
+}
+
+template<typename F>
+static void t1_death_check_begin(const t1_assert_info &info, const char *assert_name,
+                                 t1_death_expectation expected, const char *pattern, F &&f)
+{
+    t1_array<t1_death_check> *checks = _t1_get_death_checks();
+
+    // limit the number of concurrent children, finish the oldest first
+    if (checks->size >= _t1_max_concurrent_deaths())
+    {
+        _t1_finish_death_check(checks->data);
+
+        for (u64 i = 1; i < checks->size; ++i)
+            checks->data[i - 1] = checks->data[i];
+
+        checks->size--;
+    }
+
+#if t1_Linux
+    int output_fd = _memfd_create("t1_death", MFD_CLOEXEC);
+#else
+    FILE *tmp = ::tmpfile();
+    int output_fd = tmp != nullptr ? ::dup(fileno(tmp)) : -1;
+
+    if (tmp != nullptr)
+        ::fclose(tmp);
+#endif
+
+    ::fflush(nullptr);
+    int pid = output_fd != -1 ? ::fork() : -1;
+
+    if (pid == -1)
+    {
+        printf("\n[%s%s:%d%s] %scould not start death check%s\n",
+               t1_COLOR_SOURCE, info.file, info.line, t1_COLOR_RESET, t1_COLOR_FAILED, t1_COLOR_RESET);
+
+        if (output_fd != -1)
+            ::close(output_fd);
+
+        t1_atomic_add(&t1_tests::total_asserts, 1u);
+        t1_atomic_add(&t1_tests::total_asserts_failed, 1u);
+        t1_tests::current_unit_failed = true;
+        return;
+    }
+
+    if (pid == 0)
+    {
+        // child: no core dumps, stderr goes into the buffer.
+        // the reporter thread doesn't exist here and its queues are shared
+        // with the parent, so write directly.
+        t1_atomic_store(&_t1_get_reporter()->running, false);
+
+        rlimit no_core{0, 0};
+        ::setrlimit(RLIMIT_CORE, &no_core);
+
+        {
+            _t1_SUSPEND_HOOKS();
+            int null_fd = ::open("/dev/null", O_WRONLY);
+
+            if (null_fd != -1)
+                ::dup2(null_fd, STDOUT_FILENO);
+
+            ::dup2(output_fd, STDERR_FILENO);
+        }
+
+        f();
+
+        ::fflush(nullptr);
+        ::_exit(0);
+    }
+
+    t1_death_check *check = t1_add_at_end(checks);
+    check->info = info;
+    check->assert_name = assert_name;
+    check->expected = expected;
+    check->pattern = pattern;
+    check->unit = t1_tests::current_unit;
+    check->pid = pid;
+    check->output_fd = output_fd;
+    t1_get_time(&check->start_time);
+}
+
+static void t1_wait_deaths(const t1_unit *unit)
+{
+    t1_array<t1_death_check> *checks = _t1_get_death_checks();
+    u64 kept = 0;
+
+    // async units have checks of other units pending at the same time
+    for (u64 i = 0; i < checks->size; ++i)
+    {
+        if (unit == nullptr || checks->data[i].unit == unit)
+            _t1_finish_death_check(checks->data + i);
+        else
+            checks->data[kept++] = checks->data[i];
+    }
+
+    checks->size = kept;
+}
+#else
+template<typename F>
+static void t1_death_check_begin(const t1_assert_info &info, const char *, t1_death_expectation, const char *, F &&)
+{
+    printf("\n[%s%s:%d%s] %sdeath checks are not supported on this platform%s\n",
+           t1_COLOR_SOURCE, info.file, info.line, t1_COLOR_RESET, t1_COLOR_WARN, t1_COLOR_RESET);
+}
+
+static void t1_wait_deaths(const t1_unit *) {}
+#endif
+
+#define _t1_DEATH_CHECK(NAME, EXPR, EXPECTED, EXPECTED_STR, PATTERN)\
+    t1_death_check_begin(t1_assert_info{t1_get_filename(__FILE__), __LINE__, #EXPR, EXPECTED_STR},\
+                         NAME, EXPECTED, PATTERN, [&]() { EXPR; })
+
+#define assert_death(EXPR, EXPECTED, PATTERN) _t1_DEATH_CHECK("assert_death", EXPR, EXPECTED, #EXPECTED ", " #PATTERN, PATTERN)
+#define assert_dies(EXPR) _t1_DEATH_CHECK("assert_dies", EXPR, t1_dies, nullptr, nullptr)
+#define assert_exit(EXPR, STATUS) _t1_DEATH_CHECK("assert_exit", EXPR, t1_exited(STATUS), #STATUS, nullptr)
+#define assert_signal(EXPR, SIG) _t1_DEATH_CHECK("assert_signal", EXPR, t1_killed_by(SIG), #SIG, nullptr)
+
+// ---------- TEST CASES ----------
+// define_test_cases(name, path, parser) defines a unit whose body runs once
+// per record of the corpus at path (a file, or all files of a directory in
+// name order), e.g.
+//
+//     define_test_cases(decode, "corpus/vectors.txt", t1_parse_lines)
+//     {
+//         assert_equal(decode(record.data, record.size), true);
+//     }
+//
+// the corpus is memory mapped and records point directly into the mapping.
+// failing cases are reported with their index and byte offset, a record
+// that can't be parsed before the end of its file fails as a case. with
+// --jobs, cases are distributed over multiple threads.
+struct t1_record
+{
+    const char *data;
+    u64 size;
+    u64 index;        // index over all records of the corpus
+    u64 offset;       // byte offset of the record within file
+    const char *file;
+};
+
+struct t1_parsed_record
+{
+    const char *data; // usually within the parsed data
+    u64 size;
+    u64 consumed;     // bytes until the next record
+};
+
+// finds the first record in [data, data + size), returns false if there is none.
+typedef bool (*t1_record_parser)(const char *data, u64 size, t1_parsed_record *out);
+typedef void (*t1_test_case_function)(const t1_record &record);
+
+// one record per line, without the line ending
+[[maybe_unused]] static bool t1_parse_lines(const char *data, u64 size, t1_parsed_record *out)
+{
+    if (size == 0)
+        return false;
+
+    const char *end = (const char*)memchr(data, '\n', size);
+    u64 len = end != nullptr ? (u64)(end - data) : size;
+
+    out->data = data;
+    out->consumed = end != nullptr ? len + 1 : len;
+
+    if (len > 0 && data[len - 1] == '\r')
+        len--;
+
+    out->size = len;
+    return true;
+}
+
+// every file is one record
+[[maybe_unused]] static bool t1_parse_file(const char *data, u64 size, t1_parsed_record *out)
+{
+    if (size == 0)
+        return false;
+
+    out->data = data;
+    out->size = size;
+    out->consumed = size;
+    return true;
+}
+
+// records prefixed by their size as 32 bit little endian integer
+[[maybe_unused]] static bool t1_parse_u32le_length_prefixed(const char *data, u64 size, t1_parsed_record *out)
+{
+    if (size < 4)
+        return false;
+
+    const u8 *p = (const u8*)data;
+    u64 len = (u64)p[0] | ((u64)p[1] << 8) | ((u64)p[2] << 16) | ((u64)p[3] << 24);
+
+    if (len > size - 4)
+        return false;
+
+    out->data = data + 4;
+    out->size = len;
+    out->consumed = 4 + len;
+    return true;
+}
+
+#define t1_TEST_CASES_BATCH_SIZE 64
+#define t1_TEST_CASES_MAX_REPORTED_FAILURES 100
+
+struct _t1_corpus_file
+{
+    const char *path;
+    t1_mapped_file map;
+};
+
+struct _t1_test_cases_state
+{
+    t1_unit *unit;
+    t1_test_case_function body;
+    t1_record_parser parser;
+
+    _t1_corpus_file *files;
+    u64 file_count;
+
+    // guarded by lock
+    u32 lock;
+    u64 file_index;
+    u64 offset;
+    u64 next_index;
+
+    u64 cases_run;
+    u64 cases_failed;
+};
+
+// parses up to t1_TEST_CASES_BATCH_SIZE records, returns how many
+static u32 _t1_next_test_cases(_t1_test_cases_state *state, t1_record *out)
+{
+    u32 count = 0;
+
+    _t1_spin_lock(&state->lock);
+
+    while (count < t1_TEST_CASES_BATCH_SIZE && state->file_index < state->file_count)
+    {
+        _t1_corpus_file *f = state->files + state->file_index;
+        t1_parsed_record rec;
+
+        if (state->offset >= f->map.size)
+        {
+            state->file_index++;
+            state->offset = 0;
+            continue;
+        }
+
+        if (!state->parser(f->map.data + state->offset, f->map.size - state->offset, &rec)
+         || rec.consumed == 0)
+        {
+            // a truncated or corrupt record fails as a case, the rest of the
+            // file can't be found without it.
+            u64 index = state->next_index++;
+            t1_atomic_add(&state->cases_run, (u64)1);
+            u64 failed = t1_atomic_add(&state->cases_failed, (u64)1);
+
+            if (failed <= t1_TEST_CASES_MAX_REPORTED_FAILURES)
+                printf("\n[%s%s:%u%s %s%s%s] %scould not parse case %llu%s at %s%s+%#llx%s, %llu bytes of the file skipped\n",
+                       t1_COLOR_SOURCE, state->unit->file, state->unit->line, t1_COLOR_RESET,
+                       t1_COLOR_TEST_NAME, state->unit->name, t1_COLOR_RESET,
+                       t1_COLOR_FAILED, (unsigned long long)index, t1_COLOR_RESET,
+                       t1_COLOR_SOURCE, f->path, (unsigned long long)state->offset, t1_COLOR_RESET,
+                       (unsigned long long)(f->map.size - state->offset));
+
+            state->file_index++;
+            state->offset = 0;
+            continue;
+        }
+
+        t1_record *r = out + count;
+        r->data = rec.data;
+        r->size = rec.size;
+        r->index = state->next_index++;
+        r->offset = state->offset;
+        r->file = f->path;
+
+        state->offset += rec.consumed;
+        count++;
+    }
+
+    _t1_spin_unlock(&state->lock);
+
+    return count;
+}
+
+static void _t1_test_cases_worker(void *arg)
+{
+    _t1_test_cases_state *state = (_t1_test_cases_state*)arg;
+    t1_record batch[t1_TEST_CASES_BATCH_SIZE];
+
+    t1_tests::current_unit = state->unit;
+
+    bool profiled = t1_tests::profile_hz > 0 && t1_profile_begin(t1_tests::profile_hz);
+
+    defer { if (profiled) t1_profile_end(state->unit->file, state->unit->name); };
+
+    while (true)
+    {
+        u32 count = _t1_next_test_cases(state, batch);
+
+        if (count == 0)
+            break;
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            t1_tests::current_unit_failed = false;
+            state->body(batch[i]);
+
+            if (!t1_tests::current_unit_failed)
+                continue;
+
+            u64 failed = t1_atomic_add(&state->cases_failed, (u64)1);
+
+            if (failed <= t1_TEST_CASES_MAX_REPORTED_FAILURES)
+                printf("  in case %s%llu%s at %s%s+%#llx%s\n",
+                       t1_COLOR_TEST_NAME, (unsigned long long)batch[i].index, t1_COLOR_RESET,
+                       t1_COLOR_SOURCE, batch[i].file, (unsigned long long)batch[i].offset, t1_COLOR_RESET);
+        }
+
+        t1_atomic_add(&state->cases_run, (u64)count);
+    }
+}
+
+static int _t1_compare_strings(const void *l, const void *r)
+{
+    return strcmp(*(const char**)l, *(const char**)r);
+}
+
+// collects path, or the regular files inside path if it's a directory
+static bool _t1_list_corpus_files(const char *path, t1_array<const char*> *out)
+{
+#if t1_Windows
+    DWORD attrs = GetFileAttributesA(path);
+
+    if (attrs == INVALID_FILE_ATTRIBUTES)
+        return false;
+
+    if (!(attrs & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        t1_add_at_end(out, (const char*)_strdup(path));
+        return true;
+    }
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(t1_tprintf("%s\\*", path).data, &data);
+
+    if (find == INVALID_HANDLE_VALUE)
+        return true;
+
+    do
+    {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            t1_add_at_end(out, (const char*)_strdup(t1_tprintf("%s\\%s", path, data.cFileName).data));
+    }
+    while (FindNextFileA(find, &data));
+
+    FindClose(find);
+#else
+    struct stat st;
+
+    if (::stat(path, &st) == -1)
+        return false;
+
+    if (!S_ISDIR(st.st_mode))
+    {
+        t1_add_at_end(out, (const char*)::strdup(path));
+        return true;
+    }
+
+    DIR *dir = ::opendir(path);
+
+    if (dir == nullptr)
+        return false;
+
+    while (dirent *entry = ::readdir(dir))
+    {
+        const char *file = t1_tprintf("%s/%s", path, entry->d_name).data;
+
+        if (::stat(file, &st) == 0 && S_ISREG(st.st_mode))
+            t1_add_at_end(out, (const char*)::strdup(file));
+    }
+
+    ::closedir(dir);
+#endif
+
+    ::qsort(out->data, out->size, sizeof(const char*), _t1_compare_strings);
+
+    return true;
+}
+
+[[maybe_unused]] static void t1_run_test_cases(const char *source_file, const char *path, t1_record_parser parser, t1_test_case_function body)
+{
+    t1_unit *unit = t1_tests::current_unit;
+    const char *resolved = t1_resolve_path(source_file, path);
+
+    t1_array<const char*> paths;
+    init(&paths);
+
+    defer
+    {
+        for (u64 i = 0; i < paths.size; ++i)
+            ::free((void*)paths[i]);
+
+        free(&paths);
+    };
+
+    if (!_t1_list_corpus_files(resolved, &paths))
+    {
+        printf("\n[%s%s:%u%s %s%s%s] %scould not open corpus %s%s\n",
+               t1_COLOR_SOURCE, unit->file, unit->line, t1_COLOR_RESET,
+               t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+               t1_COLOR_FAILED, resolved, t1_COLOR_RESET);
+
+        t1_tests::current_unit_failed = true;
+        return;
+    }
+
+    _t1_test_cases_state state{};
+    state.unit = unit;
+    state.body = body;
+    state.parser = parser;
+    state.files = t1_reallocate_memory<_t1_corpus_file>(nullptr, paths.size > 0 ? paths.size : 1);
+
+    for (u64 i = 0; i < paths.size; ++i)
+    {
+        _t1_corpus_file *f = state.files + state.file_count;
+        f->path = paths[i];
+
+        if (!t1_map_file(f->path, &f->map))
+        {
+            printf("\n%scould not map %s%s\n", t1_COLOR_FAILED, f->path, t1_COLOR_RESET);
+            t1_tests::current_unit_failed = true;
+            continue;
+        }
+
+        state.file_count++;
+    }
+
+    bool corpus_failed = t1_tests::current_unit_failed;
+
+    u32 worker_count = t1_tests::jobs == 0 ? t1_get_processor_count() : t1_tests::jobs;
+
+    if (worker_count == 0)
+        worker_count = 1;
+
+    t1_thread *threads = t1_reallocate_memory<t1_thread>(nullptr, worker_count);
+
+    // worker 0 is this thread
+    u32 started = 1;
+
+    for (; started < worker_count; ++started)
+        if (!t1_thread_start(threads + started, _t1_test_cases_worker, &state))
+            break;
+
+    _t1_test_cases_worker(&state);
+
+    for (u32 i = 1; i < started; ++i)
+        t1_thread_join(threads + i);
+
+    t1_free_memory(threads);
+
+    for (u64 i = 0; i < state.file_count; ++i)
+        t1_unmap_file(&state.files[i].map);
+
+    t1_free_memory(state.files);
+
+    t1_tests::current_unit = unit;
+    t1_tests::current_unit_failed = corpus_failed || state.cases_failed > 0;
+
+    if (state.cases_failed > 0)
+        printf("%s%llu%s of %llu cases of %s%s%s failed\n",
+               t1_COLOR_FAILED, (unsigned long long)state.cases_failed, t1_COLOR_RESET,
+               (unsigned long long)state.cases_run,
+               t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET);
+    else if (t1_tests::verbose)
+        printf(" %llu cases,", (unsigned long long)state.cases_run);
+}
+
+#define define_test_cases(NAME, PATH, PARSER) \
+    static void JOIN3(test_, NAME, _case)(const t1_record &record);\
+    static void JOIN3(test_, NAME, _f)()\
+    {\
+        t1_run_test_cases(__FILE__, PATH, PARSER, JOIN3(test_, NAME, _case));\
+    }\
+    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
+            t1_unit{#NAME, JOIN3(test_, NAME, _f), t1_get_filename(__FILE__), __LINE__}); } \
+    static void JOIN3(test_, NAME, _case)([[maybe_unused]] const t1_record &record)
+
+// ---------- STRESS TESTS ----------
+// define_stress_test(NAME, THREADS, ITERATIONS) runs its body ITERATIONS
+// times on THREADS threads (0 = one per processor), each pinned to a
+// processor. before every iteration all threads wait on a barrier and are
+// released together. the body sees `stress`, e.g.
+//
+//     define_stress_test(queue_push_pop, 4, 100000)
+//     {
+//         if (stress.thread == 0)
+//             push(&queue, stress.iteration);
+//         else
+//             pop(&queue);
+//     }
+//
+// with --stress-jitter, every thread starts an iteration after a random
+// delay and t1_stress_jitter() yields or spins for a random time to widen
+// race windows. the delays derive from the seed (--seed), so a failing
+// schedule is as reproducible as the scheduler allows.
+// asserts report the thread they failed on. a stress test stops after the
+// first iteration an assert failed in.
+struct t1_stress_context
+{
+    u32 thread;
+    u32 thread_count;
+    u64 iteration;
+};
+
+typedef void (*t1_stress_function)(const t1_stress_context &stress);
+
+#define t1_STRESS_MAX_SPINS 2048
+
+static u64 *_t1_get_stress_random_state()
+{
+    static thread_local u64 _state = 0;
+    return &_state;
+}
+
+// may be called anywhere in a stress test body, does nothing without --stress-jitter.
+static void t1_stress_jitter()
+{
+    if (!t1_tests::stress_jitter)
+        return;
+
+    // xorshift64*
+    u64 *state = _t1_get_stress_random_state();
+    u64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    x *= 0x2545F4914F6CDD1Dull;
+
+    switch ((x >> 32) % 4)
+    {
+    case 0:
+        t1_thread_yield();
+        break;
+    case 1:
+    {
+        u32 spins = (u32)(x >> 40) % t1_STRESS_MAX_SPINS;
+
+        for (u32 i = 0; i < spins; ++i)
+            t1_cpu_pause();
+
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+struct _t1_stress_state
+{
+    t1_unit *unit;
+    t1_stress_function body;
+    u64 iterations;
+    u64 iteration; // of the unit, not of the stress test
+    u64 seed;
+
+    bool go;
+    u32 thread_count;
+    t1_barrier barrier;
+
+    u64 first_failed_iteration;
+    u32 threads_failed;
+};
+
+struct _t1_stress_thread
+{
+    _t1_stress_state *state;
+    u32 index;
+    t1_thread thread;
+};
+
+static void _t1_stress_worker(void *arg)
+{
+    _t1_stress_thread *t = (_t1_stress_thread*)arg;
+    _t1_stress_state *state = t->state;
+
+    s32 processor = t1_allowed_processor(t->index);
+
+    if (processor >= 0)
+        t1_thread_pin((u32)processor);
+
+    t1_tests::current_unit = state->unit;
+    t1_tests::current_iteration = state->iteration;
+    t1_tests::current_seed = state->seed;
+    t1_tests::current_thread = (s32)t->index;
+
+    // never 0, xorshift would get stuck
+    *_t1_get_stress_random_state() = (state->seed + 1) * 0x9E3779B97F4A7C15ull + t->index * 0xBF58476D1CE4E5B9ull + 1;
+
+    while (!t1_atomic_load(&state->go))
+        t1_thread_yield();
+
+    bool failed = false;
+    bool profiled = t1_tests::profile_hz > 0 && t1_profile_begin(t1_tests::profile_hz);
+
+    for (u64 i = 0; i < state->iterations; ++i)
+    {
+        t1_barrier_wait(&state->barrier);
+
+        // only failures of earlier iterations count, those happened before
+        // the barrier, so all threads agree on when to stop.
+        if (t1_atomic_load(&state->first_failed_iteration) < i)
+            break;
+
+        t1_stress_jitter();
+
+        t1_tests::current_unit_failed = false;
+        state->body(t1_stress_context{t->index, state->thread_count, i});
+
+        if (!t1_tests::current_unit_failed)
+            continue;
+
+        failed = true;
+
+        u64 first = t1_atomic_load(&state->first_failed_iteration);
+
+        // keep going until the next barrier, the others are waiting there
+        while (i < first && !t1_atomic_compare_exchange(&state->first_failed_iteration, &first, i))
+            ;
+    }
+
+    if (profiled)
+        t1_profile_end(state->unit->file, state->unit->name);
+
+    if (failed)
+        t1_atomic_add(&state->threads_failed, 1u);
+
+    t1_tests::current_thread = -1;
+}
+
+[[maybe_unused]] static void t1_run_stress_test(u32 thread_count, u64 iterations, t1_stress_function body)
+{
+    t1_unit *unit = t1_tests::current_unit;
+
+    if (thread_count == 0)
+        thread_count = t1_get_processor_count();
+
+    _t1_stress_state state{};
+    state.unit = unit;
+    state.body = body;
+    state.iterations = iterations;
+    state.iteration = t1_tests::current_iteration;
+    state.seed = t1_tests::current_seed;
+    state.first_failed_iteration = (u64)-1;
+
+    _t1_stress_thread *threads = t1_reallocate_memory<_t1_stress_thread>(nullptr, thread_count);
+    u32 started = 0;
+
+    for (; started < thread_count; ++started)
+    {
+        threads[started].state = &state;
+        threads[started].index = started;
+
+        if (!t1_thread_start(&threads[started].thread, _t1_stress_worker, threads + started))
+            break;
+    }
+
+    // the barrier only counts threads that actually started
+    state.thread_count = started;
+    init(&state.barrier, started);
+    t1_atomic_store(&state.go, true);
+
+    for (u32 i = 0; i < started; ++i)
+        t1_thread_join(&threads[i].thread);
+
+    t1_free_memory(threads);
+
+    if (started < thread_count)
+    {
+        printf("\n[%s%s:%u%s %s%s%s] %scould only start %u of %u threads%s\n",
+               t1_COLOR_SOURCE, unit->file, unit->line, t1_COLOR_RESET,
+               t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+               t1_COLOR_FAILED, started, thread_count, t1_COLOR_RESET);
+    }
+
+    t1_tests::current_unit = unit;
+    t1_tests::current_unit_failed = state.threads_failed > 0 || started < thread_count;
+
+    if (state.threads_failed > 0)
+        printf("  %s%u%s of %u threads failed in iteration %s%llu%s of %s%s%s (seed %llu)\n",
+               t1_COLOR_FAILED, state.threads_failed, t1_COLOR_RESET, started,
+               t1_COLOR_TEST_NAME, (unsigned long long)state.first_failed_iteration, t1_COLOR_RESET,
+               t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+               (unsigned long long)state.seed);
+}
+
+#define define_stress_test(NAME, THREADS, ITERATIONS) \
+    static void JOIN3(test_, NAME, _stress)(const t1_stress_context &stress);\
+    static void JOIN3(test_, NAME, _f)()\
+    {\
+        t1_run_stress_test(THREADS, ITERATIONS, JOIN3(test_, NAME, _stress));\
+    }\
+    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
+            t1_unit{#NAME, JOIN3(test_, NAME, _f), t1_get_filename(__FILE__), __LINE__}); } \
+    static void JOIN3(test_, NAME, _stress)([[maybe_unused]] const t1_stress_context &stress)
+
+// ---------- FUZZING ----------
+// define_fuzz_target(NAME, data, size) defines a unit whose body gets an
+// input of size bytes at data, e.g.
+//
+//     define_fuzz_target(parse_header, data, size)
+//     {
+//         header h;
+//         if (parse_header(data, size, &h))
+//             assert_less_or_equal(h.length, size);
+//     }
+//
+// normal runs only replay the corpus, the files in fuzz/<file>.<NAME>
+// relative to the test source (plus the empty input), so fuzz targets are
+// regular, fast regression units. with --fuzz[=seconds] the test executable
+// runs no units and fuzzes the selected targets instead: inputs of the corpus
+// are mutated and run in process, and mutated inputs that reach new code are
+// added to the corpus. inputs an assert fails on, or which crash, are written
+// to crash-<hash> in the corpus directory, which makes them part of the
+// replay until the bug is fixed (delete the file then, or keep it).
+// --fuzz-workers n forks n worker processes that share the corpus directory,
+// --fuzz-minimize removes inputs from the corpus that add no coverage.
+// an input that runs for longer than --fuzz-timeout seconds (default 10)
+// is written to crash-<hash> like a crashing one and stops its worker.
+// inputs are run from a copy of exactly their size, which is guarded with
+// t1_guard_allocations, so reads past the end of an input fault.
+//
+// coverage needs the code to be built with -fsanitize-coverage=trace-pc,trace-cmp
+// (the FUZZING option of add_t1_test), without it fuzzing is blind.
+#if defined(__clang__)
+#define t1_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#define t1_COVERAGE 1
+#elif defined(__GNUC__) && __GNUC__ >= 12
+#define t1_NO_COVERAGE __attribute__((no_sanitize_coverage))
+#define t1_COVERAGE 1
+#else
+#define t1_NO_COVERAGE
+#define t1_COVERAGE 0
+#endif
+
+#ifndef t1_FUZZ_DIRECTORY
+#define t1_FUZZ_DIRECTORY "fuzz"
+#endif
+
+#ifndef t1_FUZZ_MAX_INPUT_SIZE
+#define t1_FUZZ_MAX_INPUT_SIZE 4096
+#endif
+
+#define t1_FUZZ_DEFAULT_SECONDS 60
+#define t1_COVERAGE_MAP_SIZE (1u << 16)
+#define t1_COVERAGE_MAX_COMPARISONS 512
+
+// a pair of operands the code compared, used to mutate inputs towards
+// magic values.
+struct t1_comparison
+{
+    u64 a;
+    u64 b;
+    u32 size;
+};
+
+struct t1_coverage
+{
+    u8 map[t1_COVERAGE_MAP_SIZE]; // hit counts of edges between basic blocks
+    u64 previous;
+    t1_comparison comparisons[t1_COVERAGE_MAX_COMPARISONS];
+    u64 comparison_count;
+};
+
+// the fuzzer itself uses t1_NO_COVERAGE so it doesn't slow itself down
+// when t1 is built with coverage along with the test.
+// where the hooks count, nullptr if not fuzzing on this thread
+static thread_local t1_coverage *_t1_current_coverage = nullptr;
+
+// one byte per byte of code of the executable, set when the code runs, see
+// IMPACT ANALYSIS. nullptr if not recording. for all threads, units may
+// start their own.
+static u8 *_t1_impact_map = nullptr;
+static u64 _t1_impact_start = 0;
+static u64 _t1_impact_size = 0;
+
+#if t1_COVERAGE
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_pc()
+{
+    u64 pc = (u64)__builtin_return_address(0);
+    u8 *impact = _t1_impact_map;
+
+    if (impact != nullptr && pc - _t1_impact_start < _t1_impact_size)
+        __atomic_store_n(impact + (pc - _t1_impact_start), (u8)1, __ATOMIC_RELAXED);
+
+    t1_coverage *cov = _t1_current_coverage;
+
+    if (cov == nullptr)
+        return;
+
+    u64 current = ((pc ^ (pc >> 20)) * 0x9E3779B97F4A7C15ull) >> 48;
+    u8 *counter = cov->map + ((current ^ cov->previous) & (t1_COVERAGE_MAP_SIZE - 1));
+
+    *counter += *counter != 255;
+    cov->previous = current >> 1;
+}
+
+static t1_NO_COVERAGE inline void _t1_trace_comparison(u64 a, u64 b, u32 size)
+{
+    t1_coverage *cov = _t1_current_coverage;
+
+    if (cov == nullptr || a == b)
+        return;
+
+    t1_comparison *c = cov->comparisons + (cov->comparison_count++ % t1_COVERAGE_MAX_COMPARISONS);
+    c->a = a;
+    c->b = b;
+    c->size = size;
+}
+
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_cmp1(u8 a, u8 b)        { _t1_trace_comparison(a, b, 1); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_cmp2(u16 a, u16 b)      { _t1_trace_comparison(a, b, 2); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_cmp4(u32 a, u32 b)      { _t1_trace_comparison(a, b, 4); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_cmp8(u64 a, u64 b)      { _t1_trace_comparison(a, b, 8); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_const_cmp1(u8 a, u8 b)   { _t1_trace_comparison(b, a, 1); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_const_cmp2(u16 a, u16 b) { _t1_trace_comparison(b, a, 2); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_const_cmp4(u32 a, u32 b) { _t1_trace_comparison(b, a, 4); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_const_cmp8(u64 a, u64 b) { _t1_trace_comparison(b, a, 8); }
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_cmpf(float, float)     {}
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_cmpd(double, double)   {}
+
+// cases is {count, bits, values...}
+extern "C" t1_NO_COVERAGE void __sanitizer_cov_trace_switch(u64 value, void *cases)
+{
+    t1_coverage *cov = _t1_current_coverage;
+    u64 *c = (u64*)cases;
+
+    if (cov != nullptr && c[0] > 0)
+        _t1_trace_comparison(value, c[2 + cov->comparison_count % c[0]], (u32)(c[1] / 8));
+}
+#endif
+
+typedef void (*t1_fuzz_function)(const u8 *data, u64 size);
+
+struct t1_fuzz_target
+{
+    const char *name;
+    const char *file;        // t1_get_filename(source_file)
+    const char *source_file; // __FILE__, the corpus is relative to it
+    unsigned int line;
+    t1_fuzz_function body;
+};
+
+static t1_array<t1_fuzz_target> *_t1_get_fuzz_targets()
+{
+    static t1_array<t1_fuzz_target> _targets{};
+    return &_targets;
+}
+
+[[maybe_unused]] static int t1_add_fuzz_target(const t1_fuzz_target &target)
+{
+    t1_add_at_end(_t1_get_fuzz_targets(), target);
+    return 0;
+}
+
+// the corpus directory of target, a temporary string
+static const char *t1_fuzz_corpus_path(const t1_fuzz_target *target)
+{
+    const char *dir = t1_resolve_path(target->source_file, t1_FUZZ_DIRECTORY);
+    return t1_tprintf("%s/%s.%s", dir, target->file, target->name).data;
+}
+
+static t1_NO_COVERAGE u64 _t1_fuzz_hash(const u8 *data, u64 size)
+{
+    // FNV-1a
+    u64 h = 0xcbf29ce484222325ull;
+
+    for (u64 i = 0; i < size; ++i)
+        h = (h ^ data[i]) * 0x100000001b3ull;
+
+    return h;
+}
+
+static t1_fuzz_function _t1_fuzz_replay_body = nullptr;
+
+static void _t1_fuzz_replay_case(const t1_record &record)
+{
+    // the record points into the mapped file, see _t1_fuzz_execute
+    u8 *copy = (u8*)::malloc(record.size > 0 ? record.size : 1);
+
+    if (record.size > 0)
+        ::memcpy(copy, record.data, record.size);
+
+    _t1_fuzz_replay_body(copy, record.size);
+
+    ::free(copy);
+}
+
+[[maybe_unused]] static void t1_run_fuzz_target(const char *source_file, const char *name, t1_fuzz_function body)
+{
+    body(nullptr, 0);
+
+    if (t1_tests::current_unit_failed)
+    {
+        printf("  with the empty input\n");
+        return;
+    }
+
+    t1_fuzz_target target{name, t1_get_filename(source_file), source_file, 0, body};
+    const char *dir = t1_fuzz_corpus_path(&target);
+
+#if t1_Windows
+    if (GetFileAttributesA(dir) == INVALID_FILE_ATTRIBUTES)
+        return;
+#else
+    if (::access(dir, F_OK) != 0)
+        return;
+#endif
+
+    _t1_fuzz_replay_body = body;
+    t1_run_test_cases(source_file, dir, t1_parse_file, _t1_fuzz_replay_case);
+}
+
+#define define_fuzz_target(NAME, DATA, SIZE) \
+    static void JOIN3(test_, NAME, _fuzz)(const u8 *DATA, u64 SIZE);\
+    static void JOIN3(test_, NAME, _f)()\
+    {\
+        t1_run_fuzz_target(__FILE__, #NAME, JOIN3(test_, NAME, _fuzz));\
+    }\
+    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
+            t1_unit{#NAME, JOIN3(test_, NAME, _f), t1_get_filename(__FILE__), __LINE__})\
+        + t1_add_fuzz_target(\
+            t1_fuzz_target{#NAME, t1_get_filename(__FILE__), __FILE__, __LINE__, JOIN3(test_, NAME, _fuzz)}); } \
+    static void JOIN3(test_, NAME, _fuzz)([[maybe_unused]] const u8 *DATA, [[maybe_unused]] u64 SIZE)
+
+struct _t1_fuzz_input
+{
+    u8 *data;
+    u64 size;
+};
+
+struct _t1_fuzz_state
+{
+    t1_fuzz_target *target;
+    const char *dir;
+    u32 worker;
+    u64 random;
+
+    t1_coverage coverage;
+    u8 seen[t1_COVERAGE_MAP_SIZE]; // hit count buckets seen per edge
+    u64 edges;
+
+    t1_array<_t1_fuzz_input> corpus;
+    t1_array<u64> known_files; // hashes of file names already loaded
+    u64 runs;
+
+    u8 input[t1_FUZZ_MAX_INPUT_SIZE];
+};
+
+// the input being run, written to a reproducer if the process crashes or
+// the input times out
+struct _t1_fuzz_crash_info
+{
+    const u8 *input;
+    u64 size;
+    char dir[1024];
+    struct sigaction previous[5];
+
+    // for --fuzz-timeout, see _t1_fuzz_alarm_handler
+    volatile u64 started;  // inputs started
+    volatile bool running; // an input is running
+    u64 last_started;
+    u32 stuck_seconds;
+};
+
+static _t1_fuzz_crash_info _t1_fuzz_crash{};
+
+// set when a worker failed, shared by the worker processes
+static u32 *_t1_fuzz_stop = nullptr;
+
+static t1_NO_COVERAGE u64 _t1_fuzz_random(_t1_fuzz_state *s)
+{
+    // xorshift64*
+    u64 x = s->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    s->random = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static t1_NO_COVERAGE u64 _t1_fuzz_below(_t1_fuzz_state *s, u64 n)
+{
+    return n > 0 ? _t1_fuzz_random(s) % n : 0;
+}
+
+// runs data in a copy of exactly size bytes, so sanitizers and guard pages
+// catch reads past the end. allocations are guarded like those of a unit.
+// returns whether no assert failed.
+static t1_NO_COVERAGE bool _t1_fuzz_execute(_t1_fuzz_state *s, const u8 *data, u64 size)
+{
+    bool tracking = _t1_set_allocation_tracking(true);
+    u8 *copy = (u8*)::malloc(size > 0 ? size : 1);
+
+    if (size > 0)
+        ::memcpy(copy, data, size);
+
+    ::memset(s->coverage.map, 0, sizeof(s->coverage.map));
+    s->coverage.previous = 0;
+
+    _t1_fuzz_crash.input = data;
+    _t1_fuzz_crash.size = size;
+    _t1_fuzz_crash.started = _t1_fuzz_crash.started + 1;
+    _t1_fuzz_crash.running = true;
+
+    t1_tests::current_unit_failed = false;
+    _t1_current_coverage = &s->coverage;
+
+    s->target->body(copy, size);
+
+    _t1_current_coverage = nullptr;
+    _t1_fuzz_crash.running = false;
+    s->runs++;
+
+    ::free(copy);
+    _t1_set_allocation_tracking(tracking);
+
+    return !t1_tests::current_unit_failed;
+}
+
+// adds the coverage of the last execution, returns whether it was new
+static t1_NO_COVERAGE bool _t1_fuzz_merge_coverage(_t1_fuzz_state *s)
+{
+    bool found = false;
+    const u64 *words = (const u64*)s->coverage.map;
+
+    for (u64 w = 0; w < t1_COVERAGE_MAP_SIZE / 8; ++w)
+    {
+        if (words[w] == 0)
+            continue;
+
+        for (u64 i = w * 8; i < w * 8 + 8; ++i)
+        {
+            u8 count = s->coverage.map[i];
+
+            if (count == 0)
+                continue;
+
+            // AFL style buckets, only changes in magnitude matter
+            u8 bucket = count >= 128 ? 128 : count >= 32 ? 64 : count >= 16 ? 32 : count >= 8 ? 16
+                      : count >= 4 ? 8 : count == 3 ? 4 : count;
+
+            if ((s->seen[i] & bucket) != 0)
+                continue;
+
+            if (s->seen[i] == 0)
+                s->edges++;
+
+            s->seen[i] |= bucket;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+static void _t1_fuzz_add_to_corpus(_t1_fuzz_state *s, const u8 *data, u64 size)
+{
+    _t1_fuzz_input *in = t1_add_at_end(&s->corpus);
+    in->data = (u8*)::malloc(size > 0 ? size : 1);
+    in->size = size;
+
+    if (size > 0)
+        ::memcpy(in->data, data, size);
+}
+
+static const char *_t1_fuzz_write_input(_t1_fuzz_state *s, const char *prefix, const u8 *data, u64 size)
+{
+    const char *name = t1_tprintf("%s%016llx", prefix, (unsigned long long)_t1_fuzz_hash(data, size)).data;
+    const char *path = t1_tprintf("%s/%s", s->dir, name).data;
+
+    t1_add_at_end(&s->known_files, _t1_fuzz_hash((const u8*)name, strlen(name)));
+
+    if (!t1_write_file_atomic(path, (const char*)data, size))
+        printf("%scould not write %s%s\n", t1_COLOR_WARN, path, t1_COLOR_RESET);
+
+    return path;
+}
+
+static void _t1_fuzz_report_failure(_t1_fuzz_state *s, const u8 *data, u64 size)
+{
+    const char *path = _t1_fuzz_write_input(s, "crash-", data, size);
+
+    printf("[%s%s:%u%s %s%s%s] %sworker %u found a failing input after %llu runs%s, written to %s%s%s\n",
+           t1_COLOR_SOURCE, s->target->file, s->target->line, t1_COLOR_RESET,
+           t1_COLOR_TEST_NAME, s->target->name, t1_COLOR_RESET,
+           t1_COLOR_FAILED, s->worker, (unsigned long long)s->runs, t1_COLOR_RESET,
+           t1_COLOR_SOURCE, path, t1_COLOR_RESET);
+}
+
+// loads inputs of the corpus directory which weren't loaded yet, e.g. the
+// ones other workers found. returns false if one of them fails.
+static bool _t1_fuzz_sync_corpus(_t1_fuzz_state *s)
+{
+    t1_array<const char*> paths;
+    init(&paths);
+
+    defer
+    {
+        for (u64 i = 0; i < paths.size; ++i)
+            ::free((void*)paths[i]);
+
+        free(&paths);
+    };
+
+    if (!_t1_list_corpus_files(s->dir, &paths))
+        return true;
+
+    for (u64 i = 0; i < paths.size; ++i)
+    {
+        const char *name = t1_get_filename(paths[i]);
+        u64 len = strlen(name);
+        u64 hash = _t1_fuzz_hash((const u8*)name, len);
+
+        // crashes are replayed by normal runs, not fuzzed
+        if (strncmp(name, "crash-", 6) == 0 || (len > 4 && strcmp(name + len - 4, ".tmp") == 0))
+            continue;
+
+        bool known = false;
+
+        for (u64 k = 0; k < s->known_files.size && !known; ++k)
+            known = s->known_files[k] == hash;
+
+        if (known)
+            continue;
+
+        t1_add_at_end(&s->known_files, hash);
+
+        t1_mapped_file map;
+
+        if (!t1_map_file(paths[i], &map))
+            continue;
+
+        u64 size = map.size < t1_FUZZ_MAX_INPUT_SIZE ? map.size : t1_FUZZ_MAX_INPUT_SIZE;
+        bool passed = _t1_fuzz_execute(s, (const u8*)map.data, size);
+
+        if (passed && _t1_fuzz_merge_coverage(s))
+            _t1_fuzz_add_to_corpus(s, (const u8*)map.data, size);
+
+        t1_unmap_file(&map);
+
+        if (!passed)
+        {
+            printf("[%s%s:%u%s %s%s%s] %scorpus input %s fails%s\n",
+                   t1_COLOR_SOURCE, s->target->file, s->target->line, t1_COLOR_RESET,
+                   t1_COLOR_TEST_NAME, s->target->name, t1_COLOR_RESET,
+                   t1_COLOR_FAILED, paths[i], t1_COLOR_RESET);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// mutates s->input of size bytes in place, returns the new size
+static t1_NO_COVERAGE u64 _t1_fuzz_mutate(_t1_fuzz_state *s, u64 size)
+{
+    static const u8 interesting[] = {0, 1, 2, 16, 32, 64, 100, 127, 128, 255};
+    u8 *in = s->input;
+    u64 max = t1_FUZZ_MAX_INPUT_SIZE;
+    u32 count = 1 + (u32)_t1_fuzz_below(s, 8);
+
+    for (u32 m = 0; m < count; ++m)
+    {
+        switch (_t1_fuzz_below(s, 9))
+        {
+        case 0: // flip a bit
+            if (size > 0)
+                in[_t1_fuzz_below(s, size)] ^= (u8)(1u << _t1_fuzz_below(s, 8));
+            break;
+
+        case 1: // random byte
+            if (size > 0)
+                in[_t1_fuzz_below(s, size)] = (u8)_t1_fuzz_random(s);
+            break;
+
+        case 2: // interesting byte
+            if (size > 0)
+                in[_t1_fuzz_below(s, size)] = interesting[_t1_fuzz_below(s, sizeof(interesting))];
+            break;
+
+        case 3: // add or subtract a little
+            if (size > 0)
+                in[_t1_fuzz_below(s, size)] += (u8)(_t1_fuzz_below(s, 35) - 17);
+            break;
+
+        case 4: // erase bytes
+            if (size > 1)
+            {
+                u64 at = _t1_fuzz_below(s, size);
+                u64 n = 1 + _t1_fuzz_below(s, size - at);
+                ::memmove(in + at, in + at + n, size - at - n);
+                size -= n;
+            }
+            break;
+
+        case 5: // insert random bytes
+            if (size < max)
+            {
+                u64 at = _t1_fuzz_below(s, size + 1);
+                u64 n = 1 + _t1_fuzz_below(s, (max - size) < 16 ? max - size : 16);
+                ::memmove(in + at + n, in + at, size - at);
+
+                for (u64 i = 0; i < n; ++i)
+                    in[at + i] = (u8)_t1_fuzz_random(s);
+
+                size += n;
+            }
+            break;
+
+        case 6: // copy a part of the input over another part
+            if (size > 1)
+            {
+                u64 from = _t1_fuzz_below(s, size);
+                u64 to = _t1_fuzz_below(s, size);
+                u64 n = 1 + _t1_fuzz_below(s, size - (from > to ? from : to));
+                ::memmove(in + to, in + from, n);
+            }
+            break;
+
+        case 7: // splice with another corpus input
+            if (s->corpus.size > 0)
+            {
+                _t1_fuzz_input *other = s->corpus.data + _t1_fuzz_below(s, s->corpus.size);
+                u64 at = _t1_fuzz_below(s, size + 1);
+                u64 from = _t1_fuzz_below(s, other->size + 1);
+                u64 n = other->size - from;
+
+                if (at + n > max)
+                    n = max - at;
+
+                ::memcpy(in + at, other->data + from, n);
+                size = at + n;
+            }
+            break;
+
+        case 8: // replace an operand of a comparison by the other one
+        {
+            u64 known = s->coverage.comparison_count;
+
+            if (known == 0)
+                break;
+
+            if (known > t1_COVERAGE_MAX_COMPARISONS)
+                known = t1_COVERAGE_MAX_COMPARISONS;
+
+            t1_comparison *c = s->coverage.comparisons + _t1_fuzz_below(s, known);
+
+            if (size < c->size)
+                break;
+
+            // little endian, where the operand occurs or anywhere
+            u64 at = _t1_fuzz_below(s, size - c->size + 1);
+
+            for (u64 i = 0; i + c->size <= size; ++i)
+                if (::memcmp(in + i, &c->a, c->size) == 0)
+                {
+                    at = i;
+                    break;
+                }
+
+            ::memcpy(in + at, &c->b, c->size);
+            break;
+        }
+        }
+    }
+
+    return size;
+}
+
+#if !t1_Windows
+#define t1_FUZZ_CRASH_SIGNALS {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT}
+
+// writes the running input to crash-<hash> and what happened to stderr.
+// sticks to async signal safe calls.
+static void _t1_fuzz_write_crash(const char *what, u64 what_size)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    char path[sizeof(_t1_fuzz_crash.dir) + 32];
+    u64 len = strlen(_t1_fuzz_crash.dir);
+    u64 hash = _t1_fuzz_hash(_t1_fuzz_crash.input, _t1_fuzz_crash.size);
+
+    ::memcpy(path, _t1_fuzz_crash.dir, len);
+    ::memcpy(path + len, "/crash-", 7);
+    len += 7;
+
+    for (int i = 15; i >= 0; --i)
+        path[len++] = hex[(hash >> (i * 4)) & 15];
+
+    path[len] = '\0';
+
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd != -1)
+    {
+        u64 written = 0;
+
+        while (written < _t1_fuzz_crash.size)
+        {
+            s64 n = ::write(fd, _t1_fuzz_crash.input + written, _t1_fuzz_crash.size - written);
+
+            if (n <= 0)
+                break;
+
+            written += (u64)n;
+        }
+
+        ::close(fd);
+
+        t1_io_write(_stderr(), (void*)what, what_size);
+        t1_io_write(_stderr(), path, len);
+        t1_io_write(_stderr(), (void*)"\n", 1);
+    }
+}
+
+// writes the input and lets the signal take its course.
+static void _t1_fuzz_signal_handler(int sig, siginfo_t *info, void *)
+{
+    static const char what[] = "\nfuzz input crashed, written to ";
+    _t1_SUSPEND_HOOKS();
+
+    _t1_fuzz_write_crash(what, sizeof(what) - 1);
+
+    const int signals[] = t1_FUZZ_CRASH_SIGNALS;
+
+    for (u32 i = 0; i < 5; ++i)
+        if (signals[i] == sig)
+            ::sigaction(sig, _t1_fuzz_crash.previous + i, nullptr);
+
+    // faults happen again when returning, raised signals don't
+    if (info->si_code <= 0 || sig == SIGABRT)
+        ::raise(sig);
+}
+
+// runs every second with --fuzz-timeout. an input that is still the one
+// running after fuzz_timeout ticks has run for at least that many seconds,
+// it's written and the worker dies of SIGALRM.
+static void _t1_fuzz_alarm_handler(int)
+{
+    static const char what[] = "\nfuzz input timed out, written to ";
+
+    if (!_t1_fuzz_crash.running || _t1_fuzz_crash.started != _t1_fuzz_crash.last_started)
+    {
+        _t1_fuzz_crash.last_started = _t1_fuzz_crash.started;
+        _t1_fuzz_crash.stuck_seconds = 0;
+        return;
+    }
+
+    if (++_t1_fuzz_crash.stuck_seconds < t1_tests::fuzz_timeout)
+        return;
+
+    _t1_SUSPEND_HOOKS();
+    _t1_fuzz_write_crash(what, sizeof(what) - 1);
+
+    ::signal(SIGALRM, SIG_DFL);
+    ::raise(SIGALRM);
+}
+
+static void _t1_fuzz_install_signal_handlers(const char *dir)
+{
+    ::snprintf(_t1_fuzz_crash.dir, sizeof(_t1_fuzz_crash.dir), "%s", dir);
+
+#ifdef t1_guard_allocations
+    // faults on guard pages are reported after the input was written, the
+    // handler below passes them on to the guard handler
+    _t1_guard_arena *arena = _t1_get_guard_arena();
+    _t1_spin_lock(&arena->lock);
+    _t1_guard_init(arena);
+    _t1_spin_unlock(&arena->lock);
+#endif
+
+    if (t1_tests::fuzz_timeout > 0)
+    {
+        struct sigaction alarm{};
+        alarm.sa_handler = _t1_fuzz_alarm_handler;
+        alarm.sa_flags = SA_RESTART;
+        sigemptyset(&alarm.sa_mask);
+        ::sigaction(SIGALRM, &alarm, nullptr);
+
+        itimerval timer{};
+        timer.it_interval.tv_sec = 1;
+        timer.it_value.tv_sec = 1;
+        ::setitimer(ITIMER_REAL, &timer, nullptr);
+    }
+
+    const int signals[] = t1_FUZZ_CRASH_SIGNALS;
+    struct sigaction sa{};
+    sa.sa_sigaction = _t1_fuzz_signal_handler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+
+    for (u32 i = 0; i < 5; ++i)
+        ::sigaction(signals[i], &sa, _t1_fuzz_crash.previous + i);
+}
+
+static void _t1_fuzz_remove_signal_handlers()
+{
+    if (t1_tests::fuzz_timeout > 0)
+    {
+        itimerval timer{};
+        ::setitimer(ITIMER_REAL, &timer, nullptr);
+        ::signal(SIGALRM, SIG_DFL);
+    }
+
+    const int signals[] = t1_FUZZ_CRASH_SIGNALS;
+
+    for (u32 i = 0; i < 5; ++i)
+        ::sigaction(signals[i], _t1_fuzz_crash.previous + i, nullptr);
+}
+#endif
+
+static _t1_fuzz_state *_t1_fuzz_state_create(t1_fuzz_target *target, const char *dir, u32 worker)
+{
+    _t1_fuzz_state *s = t1_reallocate_memory<_t1_fuzz_state>(nullptr, 1);
+    ::memset((void*)s, 0, sizeof(_t1_fuzz_state));
+
+    s->target = target;
+    s->dir = dir;
+    s->worker = worker;
+    s->random = (t1_tests::seed + worker) * 0x9E3779B97F4A7C15ull + 1; // never 0
+    init(&s->corpus);
+    init(&s->known_files);
+
+    return s;
+}
+
+static void _t1_fuzz_state_destroy(_t1_fuzz_state *s)
+{
+    for (u64 i = 0; i < s->corpus.size; ++i)
+        ::free(s->corpus[i].data);
+
+    free(&s->corpus);
+    free(&s->known_files);
+    t1_free_memory(s);
+}
+
+// fuzzes target until the time or run limit, returns false if an input failed.
+static bool _t1_fuzz_worker(t1_fuzz_target *target, const char *dir, u32 worker)
+{
+    _t1_fuzz_state *s = _t1_fuzz_state_create(target, dir, worker);
+
+    defer { _t1_fuzz_state_destroy(s); };
+
+#if !t1_Windows
+    _t1_fuzz_install_signal_handlers(dir);
+
+    defer { _t1_fuzz_remove_signal_handlers(); };
+#endif
+
+    if (!_t1_fuzz_execute(s, nullptr, 0))
+    {
+        _t1_fuzz_report_failure(s, nullptr, 0);
+        return false;
+    }
+
+    _t1_fuzz_merge_coverage(s);
+    _t1_fuzz_add_to_corpus(s, nullptr, 0);
+
+    if (!_t1_fuzz_sync_corpus(s))
+        return false;
+
+    if (s->edges == 0 && worker == 0)
+        printf("%sno coverage for %s, build with the FUZZING option of add_t1_test%s\n",
+               t1_COLOR_WARN, target->name, t1_COLOR_RESET);
+
+    timespec start_time;
+    timespec last_sync;
+    timespec now;
+    t1_get_time(&start_time);
+    last_sync = start_time;
+
+    bool passed = true;
+
+    while (t1_tests::fuzz_runs == 0 || s->runs < t1_tests::fuzz_runs)
+    {
+        if ((s->runs & 63) == 0)
+        {
+            if (_t1_fuzz_stop != nullptr && t1_atomic_load(_t1_fuzz_stop) != 0)
+                break;
+
+            t1_get_time(&now);
+
+            if (t1_tests::fuzz_seconds > 0 && t1_get_seconds_difference(&start_time, &now) >= t1_tests::fuzz_seconds)
+                break;
+
+            if (t1_get_seconds_difference(&last_sync, &now) >= 1.0)
+            {
+                last_sync = now;
+
+                if (!_t1_fuzz_sync_corpus(s))
+                {
+                    passed = false;
+                    break;
+                }
+            }
+        }
+
+        _t1_fuzz_input *base = s->corpus.data + _t1_fuzz_below(s, s->corpus.size);
+        ::memcpy(s->input, base->data, base->size);
+        u64 size = _t1_fuzz_mutate(s, base->size);
+
+        if (!_t1_fuzz_execute(s, s->input, size))
+        {
+            _t1_fuzz_report_failure(s, s->input, size);
+            passed = false;
+            break;
+        }
+
+        if (!_t1_fuzz_merge_coverage(s))
+            continue;
+
+        _t1_fuzz_add_to_corpus(s, s->input, size);
+        _t1_fuzz_write_input(s, "", s->input, size);
+
+        if (t1_tests::verbose)
+            printf("  %s worker %u: run %llu, new input of %llu bytes, %llu edges, corpus %llu\n",
+                   target->name, worker, (unsigned long long)s->runs, (unsigned long long)size,
+                   (unsigned long long)s->edges, (unsigned long long)s->corpus.size);
+    }
+
+    t1_get_time(&now);
+    double seconds = t1_get_seconds_difference(&start_time, &now);
+
+    printf("%s %s %s worker %u: %llu runs (%.0f/s), %llu edges, corpus %llu inputs\n",
+           t1_COLOR_TEST_NAME, target->name, t1_COLOR_RESET, worker,
+           (unsigned long long)s->runs, seconds > 0 ? (double)s->runs / seconds : 0.0,
+           (unsigned long long)s->edges, (unsigned long long)s->corpus.size);
+
+    return passed;
+}
+
+static int _t1_compare_fuzz_inputs(const void *l, const void *r)
+{
+    const _t1_fuzz_input *a = (const _t1_fuzz_input*)l;
+    const _t1_fuzz_input *b = (const _t1_fuzz_input*)r;
+    return (a->size > b->size) - (a->size < b->size);
+}
+
+// keeps the smallest inputs that together reach all the coverage of the
+// corpus and deletes the other files. crash reproducers are kept.
+static void _t1_fuzz_minimize(t1_fuzz_target *target, const char *dir)
+{
+    t1_array<const char*> paths;
+    init(&paths);
+
+    defer
+    {
+        for (u64 i = 0; i < paths.size; ++i)
+            ::free((void*)paths[i]);
+
+        free(&paths);
+    };
+
+    if (!_t1_list_corpus_files(dir, &paths))
+        return;
+
+    _t1_fuzz_state *s = _t1_fuzz_state_create(target, dir, 0);
+
+    defer { _t1_fuzz_state_destroy(s); };
+
+    // data is the path here
+    t1_array<_t1_fuzz_input> files;
+    init(&files);
+
+    defer { free(&files); };
+
+    for (u64 i = 0; i < paths.size; ++i)
+    {
+        const char *name = t1_get_filename(paths[i]);
+
+        if (strncmp(name, "crash-", 6) == 0)
+            continue;
+
+        t1_mapped_file map;
+
+        if (t1_map_file(paths[i], &map))
+        {
+            t1_add_at_end(&files, _t1_fuzz_input{(u8*)paths[i], map.size});
+            t1_unmap_file(&map);
+        }
+    }
+
+    ::qsort(files.data, files.size, sizeof(_t1_fuzz_input), _t1_compare_fuzz_inputs);
+
+    _t1_fuzz_execute(s, nullptr, 0);
+    _t1_fuzz_merge_coverage(s);
+
+    u64 kept = 0;
+
+    for (u64 i = 0; i < files.size; ++i)
+    {
+        const char *path = (const char*)files[i].data;
+        t1_mapped_file map;
+
+        if (!t1_map_file(path, &map))
+            continue;
+
+        bool passed = _t1_fuzz_execute(s, (const u8*)map.data, map.size);
+        bool keep = !passed || _t1_fuzz_merge_coverage(s);
+
+        t1_unmap_file(&map);
+
+        if (keep)
+            kept++;
+        else
+            ::remove(path);
+    }
+
+    printf("%s %s %s kept %llu of %llu inputs, %llu edges\n",
+           t1_COLOR_TEST_NAME, target->name, t1_COLOR_RESET,
+           (unsigned long long)kept, (unsigned long long)files.size, (unsigned long long)s->edges);
+}
+
+static void t1_print_results(unsigned int failed, unsigned int total, const char *name);
+
+// runs instead of the units with --fuzz or --fuzz-minimize. returns the exit code.
+static int t1_fuzz()
+{
+    t1_array<t1_fuzz_target> *targets = _t1_get_fuzz_targets();
+    int ret = 0;
+
+    for (u64 t = 0; t < targets->size; ++t)
+    {
+        t1_fuzz_target *target = targets->data + t;
+        t1_unit unit{target->name, nullptr, target->file, target->line};
+
+        if (!t1_tests::is_selected(&unit))
+            continue;
+
+        // the corpus path is a temporary string
+        char *dir = ::strdup(t1_fuzz_corpus_path(target));
+
+        defer { ::free(dir); };
+
+        t1_make_directory(t1_resolve_path(target->source_file, t1_FUZZ_DIRECTORY));
+        t1_make_directory(dir);
+
+        t1_tests::current_unit = &unit;
+        t1_tests::total_units++;
+
+        if (t1_tests::fuzz_minimize)
+        {
+            _t1_fuzz_minimize(target, dir);
+            continue;
+        }
+
+        bool passed = true;
+        u32 workers = t1_tests::fuzz_workers > 0 ? t1_tests::fuzz_workers : 1;
+
+#if t1_Windows
+        if (workers > 1)
+            printf("%s--fuzz-workers is not supported on this platform%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+
+        passed = _t1_fuzz_worker(target, dir, 0);
+#else
+        // every worker is its own process, so a crash only takes down one
+        // worker and the others keep going until they're stopped.
+        t1_reporter_flush();
+        ::fflush(nullptr);
+
+        int *pids = t1_reallocate_memory<int>(nullptr, workers);
+        u32 started = 0;
+
+        void *shared = ::mmap(nullptr, sizeof(u32), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        _t1_fuzz_stop = shared != MAP_FAILED ? (u32*)shared : nullptr;
+
+        for (; started < workers; ++started)
+        {
+            int pid = ::fork();
+
+            if (pid == -1)
+                break;
+
+            if (pid == 0)
+            {
+                _t1_reset_forked_process();
+
+                bool ok = _t1_fuzz_worker(target, dir, started);
+
+                ::fflush(nullptr);
+                ::_exit(ok ? 0 : 1);
+            }
+
+            pids[started] = pid;
+        }
+
+        if (started == 0)
+        {
+            printf("%scould not start fuzz workers%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+            passed = false;
+        }
+
+        for (u32 remaining = started; remaining > 0; --remaining)
+        {
+            int status = 0;
+            int pid = ::waitpid(-1, &status, 0);
+
+            if (pid == -1)
+                break;
+
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+                continue;
+
+            if (WIFSIGNALED(status))
+                printf("[%s%s:%u%s %s%s%s] %sfuzz worker killed by signal %d (%s)%s\n",
+                       t1_COLOR_SOURCE, target->file, target->line, t1_COLOR_RESET,
+                       t1_COLOR_TEST_NAME, target->name, t1_COLOR_RESET,
+                       t1_COLOR_FAILED, WTERMSIG(status), strsignal(WTERMSIG(status)), t1_COLOR_RESET);
+
+            // one failing input is enough, stop the others
+            if (_t1_fuzz_stop != nullptr)
+                t1_atomic_store(_t1_fuzz_stop, 1u);
+
+            passed = false;
+        }
+
+        if (_t1_fuzz_stop != nullptr)
+            ::munmap(_t1_fuzz_stop, sizeof(u32));
+
+        _t1_fuzz_stop = nullptr;
+        t1_free_memory(pids);
+#endif
+
+        if (!passed)
+        {
+            t1_tests::total_units_failed++;
+            ret = 1;
+
+            if (t1_tests::stop_on_fail)
+                break;
+        }
+    }
+
+    t1_tests::current_unit = nullptr;
+
+    t1_print_results(t1_tests::total_units_failed, t1_tests::total_units, "fuzz targets");
+
+    return ret;
+}
+
+// ---------- IMPACT ANALYSIS ----------
+// --record-impact runs the units as usual and records which functions of
+// the test executable each of them executed, in <test file>.impact (or
+// --impact-index <path>). later runs given what changed only run the units
+// that executed a changed function:
+//
+//     test --changed 'parse_number*' --changed 'json::*'
+//     test --changed-list changed_functions.txt
+//     test --changed-binary
+//
+// --changed takes a glob pattern matching mangled names or demangled names
+// without parameters, --changed-list a file with one pattern per line.
+// --changed-binary compares the code of every recorded function with the
+// running executable, e.g. after a rebuild. relative addresses in the code
+// change when other functions move, so it rather selects too many units than
+// too few. units that were not recorded, e.g. new ones, are always selected,
+// async units are recorded together. the selection combines with --filter
+// and --list. the index is a file that is mapped into memory, selecting
+// from it takes milliseconds for thousands of units.
+//
+// recording needs the code built with -fsanitize-coverage=trace-pc (the
+// IMPACT or FUZZING option of add_t1_test) and the symbols of the
+// executable, i.e. it must not be stripped.
+#if t1_PROFILER && t1_COVERAGE
+#define t1_IMPACT 1
+#else
+#define t1_IMPACT 0
+#endif
+
+#if t1_IMPACT
+#define t1_IMPACT_MAGIC "t1impt\0\1"
+
+// the index file is the header followed by the entries, the units, a bitmap
+// of the executed functions per unit and the names.
+struct t1_impact_header
+{
+    char magic[8];
+    u64 function_count;
+    u64 entry_count;
+    u64 unit_count;
+    u64 words_per_unit; // of the bitmaps
+    u64 strings_size;
+};
+
+// a name of a function, a function has its mangled name and maybe a
+// demangled one
+struct t1_impact_entry
+{
+    u64 code_hash;   // of the mangled entry
+    u32 name_offset;
+    u32 function;    // bit in the bitmaps
+    u32 mangled;
+    u32 reserved;
+};
+
+struct t1_impact_unit
+{
+    u64 hash;        // _t1_unit_hash
+    u32 name_offset;
+    u32 recorded;
+};
+
+struct _t1_impact_recorder
+{
+    t1_array<_t1_symbol_object> objects; // objects[0] is the executable
+    u64 words_per_unit;
+    t1_array<u64> bitmaps; // per unit, the unit count for all async units
+    t1_array<u8> recorded;
+    bool failed;
+    bool warned; // that a unit had no code recorded
+};
+
+static _t1_impact_recorder *_t1_get_impact_recorder()
+{
+    static _t1_impact_recorder _recorder{};
+    return &_recorder;
+}
+
+static u64 _t1_impact_code_hash(const _t1_symbol *sym)
+{
+    // FNV-1a of the code
+    u64 h = 0xcbf29ce484222325ull;
+    const u8 *code = (const u8*)sym->address;
+
+    for (u64 i = 0; i < sym->size; ++i)
+        h = (h ^ code[i]) * 0x100000001b3ull;
+
+    return h;
+}
+
+// index of the last symbol at or before address, -1 if none
+static s64 _t1_impact_find_symbol(const _t1_symbol_object *o, u64 address)
+{
+    s64 lo = 0;
+    s64 hi = (s64)o->symbols.size - 1;
+    s64 found = -1;
+
+    while (lo <= hi)
+    {
+        s64 mid = (lo + hi) / 2;
+
+        if (o->symbols.data[mid].address <= address)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+            hi = mid - 1;
+    }
+
+    return found;
+}
+
+// maps the code of the executable, returns false if it can't be recorded
+static bool _t1_impact_start_recording(_t1_impact_recorder *r)
+{
+    init(&r->objects);
+    ::dl_iterate_phdr(_t1_collect_objects, &r->objects);
+
+    if (r->objects.size == 0)
+        return false;
+
+    _t1_symbol_object *exe = r->objects.data;
+    _t1_load_symbols(exe);
+
+    if (exe->symbols.size == 0)
+        return false;
+
+    u64 start = exe->symbols[0].address;
+    u64 end = start;
+
+    for (u64 i = 0; i < exe->symbols.size; ++i)
+    {
+        _t1_symbol *sym = exe->symbols.data + i;
+
+        if (sym->address + sym->size > end)
+            end = sym->address + sym->size;
+    }
+
+    // shared so forked units record into it too
+    void *map = ::mmap(nullptr, end - start, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    r->words_per_unit = (exe->symbols.size + 63) / 64;
+
+    u64 words = (t1_tests::units.size + 1) * r->words_per_unit;
+    ::memset(t1_add_elements(&r->bitmaps, words), 0, words * sizeof(u64));
+    ::memset(t1_add_elements(&r->recorded, t1_tests::units.size + 1), 0, t1_tests::units.size + 1);
+
+    _t1_impact_start = start;
+    _t1_impact_size = end - start;
+    _t1_impact_map = (u8*)map;
+
+    return true;
+}
+
+static void t1_impact_begin_unit()
+{
+    _t1_impact_recorder *r = _t1_get_impact_recorder();
+
+    if (r->failed)
+        return;
+
+    if (_t1_impact_map == nullptr && !_t1_impact_start_recording(r))
+    {
+        printf("%scould not record the impact of units, the executable has no symbols%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+        r->failed = true;
+        return;
+    }
+
+    // frees the pages, they read as zeros again
+    if (::madvise(_t1_impact_map, _t1_impact_size, MADV_REMOVE) != 0)
+        ::memset(_t1_impact_map, 0, _t1_impact_size);
+}
+
+static void t1_impact_end_unit(u64 index)
+{
+    _t1_impact_recorder *r = _t1_get_impact_recorder();
+
+    if (r->failed || _t1_impact_map == nullptr)
+        return;
+
+    _t1_symbol_object *exe = r->objects.data;
+    u64 *bitmap = r->bitmaps.data + index * r->words_per_unit;
+    const u8 *map = _t1_impact_map;
+    bool any = false;
+
+    for (u64 offset = 0; offset < _t1_impact_size;)
+    {
+        // skip 8 bytes of code at a time
+        if ((offset & 7) == 0 && offset + 8 <= _t1_impact_size && *(const u64*)(map + offset) == 0)
+        {
+            offset += 8;
+            continue;
+        }
+
+        if (map[offset] == 0)
+        {
+            offset++;
+            continue;
+        }
+
+        any = true;
+
+        u64 address = _t1_impact_start + offset;
+        s64 s = _t1_impact_find_symbol(exe, address);
+
+        if (s < 0)
+        {
+            offset++;
+            continue;
+        }
+
+        _t1_symbol *sym = exe->symbols.data + s;
+
+        if (address >= sym->address + sym->size)
+        {
+            offset++;
+            continue;
+        }
+
+        // aliases have the same address
+        for (s64 a = s; a >= 0 && exe->symbols.data[a].address == sym->address; --a)
+            bitmap[a / 64] |= 1ull << (a % 64);
+
+        // the rest of the function sets the same bit
+        u64 next = sym->address + sym->size - _t1_impact_start;
+        offset = next > offset ? next : offset + 1;
+    }
+
+    // not instrumented, the unit stays always selected
+    r->recorded[index] = any;
+
+    if (!any && index < t1_tests::units.size && !r->warned)
+    {
+        printf("%sno code was recorded for a unit, was it built with -fsanitize-coverage=trace-pc?%s\n",
+               t1_COLOR_WARN, t1_COLOR_RESET);
+        r->warned = true;
+    }
+}
+
+// the demangled name up to its parameters, e.g. "ns::parse<int>" for
+// "ns::parse<int>(char const*)", nullptr if it is the same as name.
+static char *_t1_impact_short_name(const char *name)
+{
+#if __has_include(<cxxabi.h>)
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+
+    if (status != 0 || demangled == nullptr)
+        return nullptr;
+
+    s32 depth = 0;
+
+    for (char *c = demangled; *c != '\0'; ++c)
+    {
+        if (strncmp(c, "(anonymous namespace)", 21) == 0)
+            c += 20;
+        else if (*c == '<')
+            depth++;
+        else if (*c == '>')
+            depth--;
+        else if (*c == '(' && depth == 0)
+        {
+            *c = '\0';
+            break;
+        }
+    }
+
+    if (strcmp(demangled, name) == 0)
+    {
+        ::free(demangled);
+        return nullptr;
+    }
+
+    return demangled;
+#else
+    (void)name;
+    return nullptr;
+#endif
+}
+
+static u32 _t1_impact_add_string(t1_array<char> *strings, const char *str)
+{
+    u32 offset = (u32)strings->size;
+    u64 len = strlen(str) + 1;
+    ::memcpy(t1_add_elements(strings, len), str, len);
+    return offset;
+}
+
+static void t1_impact_write()
+{
+    _t1_impact_recorder *r = _t1_get_impact_recorder();
+
+    if (_t1_impact_map == nullptr)
+        return;
+
+    u8 *map = _t1_impact_map;
+    _t1_impact_map = nullptr;
+    ::munmap(map, _t1_impact_size);
+
+    defer
+    {
+        _t1_free_symbol_objects(&r->objects);
+        free(&r->bitmaps);
+        free(&r->recorded);
+    };
+
+    _t1_symbol_object *exe = r->objects.data;
+    t1_array<t1_unit> *units = &t1_tests::units;
+
+    t1_array<t1_impact_entry> entries;
+    t1_array<t1_impact_unit> index_units;
+    t1_array<char> strings;
+    init(&entries);
+    init(&index_units);
+    init(&strings);
+
+    defer
+    {
+        free(&entries);
+        free(&index_units);
+        free(&strings);
+    };
+
+    for (u64 i = 0; i < exe->symbols.size; ++i)
+    {
+        _t1_symbol *sym = exe->symbols.data + i;
+
+        t1_add_at_end(&entries, t1_impact_entry{_t1_impact_code_hash(sym), _t1_impact_add_string(&strings, sym->name), (u32)i, 1, 0});
+
+        if (char *short_name = _t1_impact_short_name(sym->name))
+        {
+            t1_add_at_end(&entries, t1_impact_entry{0, _t1_impact_add_string(&strings, short_name), (u32)i, 0, 0});
+            ::free(short_name);
+        }
+    }
+
+    for (u64 i = 0; i < units->size; ++i)
+    {
+        t1_unit *unit = units->data + i;
+        bool async = unit->async_func != nullptr;
+        u64 recorded = async ? r->recorded[units->size] && t1_tests::is_selected(unit) : r->recorded[i];
+
+        // async units share the bitmap of all async units
+        if (async && recorded)
+            ::memcpy(r->bitmaps.data + i * r->words_per_unit, r->bitmaps.data + units->size * r->words_per_unit,
+                     r->words_per_unit * sizeof(u64));
+
+        t1_add_at_end(&index_units, t1_impact_unit{_t1_unit_hash(unit), _t1_impact_add_string(&strings, unit->name), (u32)recorded});
+    }
+
+    t1_impact_header header{};
+    ::memcpy(header.magic, t1_IMPACT_MAGIC, sizeof(header.magic));
+    header.function_count = exe->symbols.size;
+    header.entry_count = entries.size;
+    header.unit_count = units->size;
+    header.words_per_unit = r->words_per_unit;
+    header.strings_size = strings.size;
+
+    t1_array<char> file;
+    init(&file);
+    defer { free(&file); };
+
+    u64 bitmap_size = units->size * r->words_per_unit * sizeof(u64);
+
+    ::memcpy(t1_add_elements(&file, sizeof(header)), &header, sizeof(header));
+    ::memcpy(t1_add_elements(&file, entries.size * sizeof(t1_impact_entry)), entries.data, entries.size * sizeof(t1_impact_entry));
+    ::memcpy(t1_add_elements(&file, index_units.size * sizeof(t1_impact_unit)), index_units.data, index_units.size * sizeof(t1_impact_unit));
+    ::memcpy(t1_add_elements(&file, bitmap_size), r->bitmaps.data, bitmap_size);
+    ::memcpy(t1_add_elements(&file, strings.size), strings.data, strings.size);
+
+    const char *path = t1_tests::impact_index_path;
+
+    if (path == nullptr)
+        path = t1_tprintf("%s.impact", units->data[0].file).data;
+
+    if (t1_write_file_atomic(path, file.data, file.size))
+        printf("\nimpact of %s%llu%s units on %llu functions written to %s%s%s\n",
+               t1_COLOR_TEST_NAME, (unsigned long long)units->size, t1_COLOR_RESET,
+               (unsigned long long)exe->symbols.size,
+               t1_COLOR_SOURCE, path, t1_COLOR_RESET);
+    else
+        printf("\n%scould not write %s%s\n", t1_COLOR_FAILED, path, t1_COLOR_RESET);
+}
+
+static int _t1_compare_symbol_names(const void *l, const void *r)
+{
+    return strcmp(((const _t1_symbol*)l)->name, ((const _t1_symbol*)r)->name);
+}
+
+// sets the bits of the functions whose code differs from the running executable
+static void _t1_impact_changed_code(const t1_impact_entry *entries, u64 entry_count, const char *strings, u64 *changed)
+{
+    t1_array<_t1_symbol_object> objects;
+    init(&objects);
+    ::dl_iterate_phdr(_t1_collect_objects, &objects);
+    defer { _t1_free_symbol_objects(&objects); };
+
+    if (objects.size == 0)
+        return;
+
+    _t1_symbol_object *exe = objects.data;
+    _t1_load_symbols(exe);
+
+    ::qsort(exe->symbols.data, exe->symbols.size, sizeof(_t1_symbol), _t1_compare_symbol_names);
+
+    for (u64 i = 0; i < entry_count; ++i)
+    {
+        const t1_impact_entry *e = entries + i;
+
+        if (!e->mangled)
+            continue;
+
+        _t1_symbol key{0, 0, strings + e->name_offset, nullptr};
+        _t1_symbol *sym = (_t1_symbol*)::bsearch(&key, exe->symbols.data, exe->symbols.size, sizeof(_t1_symbol), _t1_compare_symbol_names);
+
+        if (sym == nullptr || _t1_impact_code_hash(sym) != e->code_hash)
+            changed[e->function / 64] |= 1ull << (e->function % 64);
+    }
+}
+#endif
+
+// with --changed, --changed-list or --changed-binary, selects the units the
+// impact index says executed a changed function.
+static void t1_select_impacted_units()
+{
+    if (t1_tests::changed.size == 0 && t1_tests::changed_list_path == nullptr && !t1_tests::changed_binary)
+        return;
+
+#if t1_IMPACT
+    t1_array<t1_unit> *units = &t1_tests::units;
+
+    if (units->size == 0)
+        return;
+
+    const char *path = t1_tests::impact_index_path;
+
+    if (path == nullptr)
+        path = t1_tprintf("%s.impact", units->data[0].file).data;
+
+    t1_mapped_file index{};
+
+    if (!t1_map_file(path, &index))
+    {
+        if (!t1_tests::list_units)
+            printf("%sno impact index %s, run with --record-impact first. all units are selected.%s\n",
+                   t1_COLOR_WARN, path, t1_COLOR_RESET);
+        return;
+    }
+
+    defer { t1_unmap_file(&index); };
+
+    const t1_impact_header *header = (const t1_impact_header*)index.data;
+    u64 size = 0;
+
+    if (index.size >= sizeof(t1_impact_header) && memcmp(header->magic, t1_IMPACT_MAGIC, sizeof(header->magic)) == 0)
+        size = sizeof(t1_impact_header)
+             + header->entry_count * sizeof(t1_impact_entry)
+             + header->unit_count * sizeof(t1_impact_unit)
+             + header->unit_count * header->words_per_unit * sizeof(u64)
+             + header->strings_size;
+
+    if (size == 0 || size != index.size || header->words_per_unit * 64 < header->function_count)
+    {
+        if (!t1_tests::list_units)
+            printf("%s%s is not an impact index. all units are selected.%s\n", t1_COLOR_WARN, path, t1_COLOR_RESET);
+        return;
+    }
+
+    const t1_impact_entry *entries = (const t1_impact_entry*)(header + 1);
+    const t1_impact_unit *index_units = (const t1_impact_unit*)(entries + header->entry_count);
+    const u64 *bitmaps = (const u64*)(index_units + header->unit_count);
+    const char *strings = (const char*)(bitmaps + header->unit_count * header->words_per_unit);
+
+    u64 words = header->words_per_unit;
+    u64 *changed = t1_reallocate_memory<u64>(nullptr, words);
+    ::memset(changed, 0, words * sizeof(u64));
+    defer { t1_free_memory(changed); };
+
+    // patterns
+    t1_array<const char*> patterns;
+    init(&patterns);
+    defer { free(&patterns); };
+
+    for (u64 i = 0; i < t1_tests::changed.size; ++i)
+        t1_add_at_end(&patterns, t1_tests::changed[i]);
+
+    t1_mapped_file list{};
+    t1_array<char> list_text;
+    init(&list_text);
+    defer { free(&list_text); };
+
+    if (t1_tests::changed_list_path != nullptr)
+    {
+        if (t1_map_file(t1_tests::changed_list_path, &list))
+        {
+            // one pattern per line, NUL terminated in a copy
+            ::memcpy(t1_add_elements(&list_text, list.size + 1), list.data, list.size);
+            list_text[list.size] = '\0';
+            t1_unmap_file(&list);
+
+            for (char *line = list_text.data; line < list_text.data + list_text.size - 1;)
+            {
+                char *eol = strchr(line, '\n');
+
+                if (eol != nullptr)
+                    *eol = '\0';
+
+                u64 len = strlen(line);
+
+                if (len > 0 && line[len - 1] == '\r')
+                    line[--len] = '\0';
+
+                if (len > 0)
+                    t1_add_at_end(&patterns, (const char*)line);
+
+                line += len + 1;
+
+                if (eol != nullptr)
+                    line = eol + 1;
+            }
+        }
+        else if (!t1_tests::list_units)
+            printf("%scould not read %s%s\n", t1_COLOR_WARN, t1_tests::changed_list_path, t1_COLOR_RESET);
+    }
+
+    for (u64 i = 0; i < header->entry_count && patterns.size > 0; ++i)
+    {
+        const char *name = strings + entries[i].name_offset;
+
+        for (u64 p = 0; p < patterns.size; ++p)
+            if (t1_glob_match(patterns[p], name))
+            {
+                changed[entries[i].function / 64] |= 1ull << (entries[i].function % 64);
+                break;
+            }
+    }
+
+    if (t1_tests::changed_binary)
+        _t1_impact_changed_code(entries, header->entry_count, strings, changed);
+
+    u64 changed_functions = 0;
+
+    for (u64 w = 0; w < words; ++w)
+        changed_functions += (u64)__builtin_popcountll(changed[w]);
+
+    // units that were not recorded are always selected
+    t1_tests::impacted.size = 0;
+    ::memset(t1_add_elements(&t1_tests::impacted, units->size), 1, units->size);
+
+    u64 selected = units->size;
+
+    for (u64 i = 0; i < units->size; ++i)
+    {
+        u64 hash = _t1_unit_hash(units->data + i);
+
+        for (u64 u = 0; u < header->unit_count; ++u)
+        {
+            if (index_units[u].hash != hash || !index_units[u].recorded)
+                continue;
+
+            const u64 *bitmap = bitmaps + u * words;
+            bool impacted = false;
+
+            for (u64 w = 0; w < words && !impacted; ++w)
+                impacted = (bitmap[w] & changed[w]) != 0;
+
+            t1_tests::impacted[i] = impacted;
+            selected -= !impacted;
+            break;
+        }
+    }
+
+    if (!t1_tests::list_units)
+        printf("%llu changed functions, %s%llu%s of %llu units are impacted\n",
+               (unsigned long long)changed_functions,
+               t1_COLOR_TEST_NAME, (unsigned long long)selected, t1_COLOR_RESET,
+               (unsigned long long)units->size);
+#else
+    if (!t1_tests::list_units)
+        printf("%simpact analysis is not supported on this platform or compiler. all units are selected.%s\n",
+               t1_COLOR_WARN, t1_COLOR_RESET);
+#endif
+}
+
+#if !t1_IMPACT
+static void t1_impact_begin_unit() {}
+
+static void t1_impact_end_unit(u64) {}
+
+static void t1_impact_write()
+{
+    if (t1_tests::record_impact)
+        printf("%simpact analysis is not supported on this platform or compiler%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+}
+#endif
+
+// ---------- SNAPSHOTS ----------
+// assert_matches_snapshot(name, data, size) compares data with the golden
+// file snapshots/<test file name>.<name>.snap next to the test source file.
+// mismatches print a bounded unified diff of the lines (computed with the
+// linear space variant of Myers' diff algorithm), or the first differing
+// byte for binary data. --update-snapshots (re)writes the golden files.
+#define t1_SNAPSHOT_DIFF_CONTEXT 3
+#define t1_SNAPSHOT_MAX_DIFF_LINES 100
+#define t1_SNAPSHOT_MAX_EDIT_DISTANCE 4096 // larger differences are shown as replaced
+
+struct _t1_diff_line
+{
+    const char *data;
+    u64 size;
+    u64 hash;
+};
+
+struct _t1_diff
+{
+    _t1_diff_line *a;
+    _t1_diff_line *b;
+    bool *a_deleted;
+    bool *b_inserted;
+    s64 *v1;
+    s64 *v2;
+};
+
+static u64 _t1_split_lines(const char *data, u64 size, _t1_diff_line **out)
+{
+    u64 count = 0;
+
+    for (u64 i = 0; i < size; ++i)
+        if (data[i] == '\n')
+            count++;
+
+    if (size > 0 && data[size - 1] != '\n')
+        count++;
+
+    *out = t1_reallocate_memory<_t1_diff_line>(nullptr, count > 0 ? count : 1);
+
+    u64 line = 0;
+    u64 start = 0;
+
+    for (u64 i = 0; i <= size && line < count; ++i)
+    {
+        if (i < size && data[i] != '\n')
+            continue;
+
+        // FNV-1a
+        u64 hash = 14695981039346656037ull;
+
+        for (u64 j = start; j < i; ++j)
+            hash = (hash ^ (u8)data[j]) * 1099511628211ull;
+
+        (*out)[line++] = _t1_diff_line{data + start, i - start, hash};
+        start = i + 1;
+    }
+
+    return count;
+}
+
+static inline bool _t1_diff_line_equal(const _t1_diff_line *l, const _t1_diff_line *r)
+{
+    return l->hash == r->hash && l->size == r->size && memcmp(l->data, r->data, l->size) == 0;
+}
+
+static void _t1_diff_range(_t1_diff *d, s64 a0, s64 a1, s64 b0, s64 b1);
+
+// finds the middle of the shortest edit script and splits the problem there.
+static void _t1_diff_bisect(_t1_diff *d, s64 a0, s64 a1, s64 b0, s64 b1)
+{
+    s64 n = a1 - a0;
+    s64 m = b1 - b0;
+    s64 max_d = (n + m + 1) / 2;
+
+    if (max_d > t1_SNAPSHOT_MAX_EDIT_DISTANCE)
+        max_d = t1_SNAPSHOT_MAX_EDIT_DISTANCE;
+
+    s64 v_offset = max_d;
+    s64 v_length = 2 * max_d + 2;
+    s64 *v1 = d->v1;
+    s64 *v2 = d->v2;
+
+    for (s64 i = 0; i < v_length; ++i)
+    {
+        v1[i] = -1;
+        v2[i] = -1;
+    }
+
+    v1[v_offset + 1] = 0;
+    v2[v_offset + 1] = 0;
+
+    s64 delta = n - m;
+    bool front = (delta % 2) != 0;
+    s64 k1start = 0;
+    s64 k1end = 0;
+    s64 k2start = 0;
+    s64 k2end = 0;
+
+    for (s64 dist = 0; dist < max_d; ++dist)
+    {
+        for (s64 k1 = -dist + k1start; k1 <= dist - k1end; k1 += 2)
+        {
+            s64 k1_offset = v_offset + k1;
+            s64 x1;
+
+            if (k1 == -dist || (k1 != dist && v1[k1_offset - 1] < v1[k1_offset + 1]))
+                x1 = v1[k1_offset + 1];
+            else
+                x1 = v1[k1_offset - 1] + 1;
+
+            s64 y1 = x1 - k1;
+
+            while (x1 < n && y1 < m && _t1_diff_line_equal(d->a + a0 + x1, d->b + b0 + y1))
+            {
+                x1++;
+                y1++;
+            }
+
+            v1[k1_offset] = x1;
+
+            if (x1 > n)
+                k1end += 2;
+            else if (y1 > m)
+                k1start += 2;
+            else if (front)
+            {
+                s64 k2_offset = v_offset + delta - k1;
+
+                if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1 && x1 >= n - v2[k2_offset])
+                {
+                    _t1_diff_range(d, a0, a0 + x1, b0, b0 + y1);
+                    _t1_diff_range(d, a0 + x1, a1, b0 + y1, b1);
+                    return;
+                }
+            }
+        }
+
+        for (s64 k2 = -dist + k2start; k2 <= dist - k2end; k2 += 2)
+        {
+            s64 k2_offset = v_offset + k2;
+            s64 x2;
+
+            if (k2 == -dist || (k2 != dist && v2[k2_offset - 1] < v2[k2_offset + 1]))
+                x2 = v2[k2_offset + 1];
+            else
+                x2 = v2[k2_offset - 1] + 1;
+
+            s64 y2 = x2 - k2;
+
+            while (x2 < n && y2 < m && _t1_diff_line_equal(d->a + a1 - x2 - 1, d->b + b1 - y2 - 1))
+            {
+                x2++;
+                y2++;
+            }
+
+            v2[k2_offset] = x2;
+
+            if (x2 > n)
+                k2end += 2;
+            else if (y2 > m)
+                k2start += 2;
+            else if (!front)
+            {
+                s64 k1_offset = v_offset + delta - k2;
+
+                if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1)
+                {
+                    s64 x1 = v1[k1_offset];
+                    s64 y1 = v_offset + x1 - k1_offset;
+
+                    if (x1 >= n - x2)
+                    {
+                        _t1_diff_range(d, a0, a0 + x1, b0, b0 + y1);
+                        _t1_diff_range(d, a0 + x1, a1, b0 + y1, b1);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    // too different (or nothing in common), replace everything
+    for (s64 i = a0; i < a1; ++i) d->a_deleted[i] = true;
+    for (s64 i = b0; i < b1; ++i) d->b_inserted[i] = true;
+}
+
+static void _t1_diff_range(_t1_diff *d, s64 a0, s64 a1, s64 b0, s64 b1)
+{
+    while (a0 < a1 && b0 < b1 && _t1_diff_line_equal(d->a + a0, d->b + b0))
+    {
+        a0++;
+        b0++;
+    }
+
+    while (a0 < a1 && b0 < b1 && _t1_diff_line_equal(d->a + a1 - 1, d->b + b1 - 1))
+    {
+        a1--;
+        b1--;
+    }
+
+    if (a0 == a1)
+    {
+        for (s64 i = b0; i < b1; ++i) d->b_inserted[i] = true;
+        return;
+    }
+
+    if (b0 == b1)
+    {
+        for (s64 i = a0; i < a1; ++i) d->a_deleted[i] = true;
+        return;
+    }
+
+    _t1_diff_bisect(d, a0, a1, b0, b1);
+}
+
+static void _t1_print_diff_line(char prefix, const _t1_diff_line *l)
+{
+    const char *color = prefix == '-' ? t1_COLOR_CHECK_EXPECTED : (prefix == '+' ? t1_COLOR_CHECK_ACTUAL : "");
+    printf("  %s%c%.*s%s\n", color, prefix, (int)l->size, l->data, t1_COLOR_RESET);
+}
+
+// prints a unified diff from expected to actual, at most t1_SNAPSHOT_MAX_DIFF_LINES lines.
+static void t1_print_diff(const char *expected, u64 expected_size, const char *actual, u64 actual_size)
+{
+    _t1_diff d{};
+    s64 n = (s64)_t1_split_lines(expected, expected_size, &d.a);
+    s64 m = (s64)_t1_split_lines(actual, actual_size, &d.b);
+
+    d.a_deleted = (bool*)t1_reallocate_memory(nullptr, (u64)n + 1);
+    d.b_inserted = (bool*)t1_reallocate_memory(nullptr, (u64)m + 1);
+    ::memset(d.a_deleted, 0, (u64)n + 1);
+    ::memset(d.b_inserted, 0, (u64)m + 1);
+
+    // linear space: one pair of vectors, reused by every bisection
+    u64 v_size = 2 * t1_SNAPSHOT_MAX_EDIT_DISTANCE + 2;
+
+    if ((u64)(n + m + 2) < v_size)
+        v_size = (u64)(n + m + 2) + 2;
+
+    d.v1 = t1_reallocate_memory<s64>(nullptr, v_size);
+    d.v2 = t1_reallocate_memory<s64>(nullptr, v_size);
+
+    _t1_diff_range(&d, 0, n, 0, m);
+
+    u64 printed = 0;
+    s64 i = 0;
+    s64 j = 0;
+
+    while ((i < n || j < m) && printed < t1_SNAPSHOT_MAX_DIFF_LINES)
+    {
+        if ((i >= n || !d.a_deleted[i]) && (j >= m || !d.b_inserted[j]))
+        {
+            i++;
+            j++;
+            continue;
+        }
+
+        // start of a hunk, include context before and extend until
+        // there are more than 2 * context unchanged lines.
+        s64 hunk_i = i - t1_SNAPSHOT_DIFF_CONTEXT < 0 ? 0 : i - t1_SNAPSHOT_DIFF_CONTEXT;
+        s64 hunk_j = j - (i - hunk_i);
+        s64 end_i = i;
+        s64 end_j = j;
+        s64 unchanged = 0;
+
+        while ((end_i < n || end_j < m) && unchanged <= 2 * t1_SNAPSHOT_DIFF_CONTEXT)
+        {
+            if (end_i < n && d.a_deleted[end_i])
+            {
+                end_i++;
+                unchanged = 0;
+            }
+            else if (end_j < m && d.b_inserted[end_j])
+            {
+                end_j++;
+                unchanged = 0;
+            }
+            else
+            {
+                end_i++;
+                end_j++;
+                unchanged++;
+            }
+        }
+
+        s64 trailing = unchanged > t1_SNAPSHOT_DIFF_CONTEXT ? unchanged - t1_SNAPSHOT_DIFF_CONTEXT : 0;
+        end_i -= trailing;
+        end_j -= trailing;
+
+        if (end_i > n) end_i = n;
+        if (end_j > m) end_j = m;
+
+        printf("  %s@@ -%lld,%lld +%lld,%lld @@%s\n", t1_COLOR_SOURCE,
+               (long long)hunk_i + 1, (long long)(end_i - hunk_i),
+               (long long)hunk_j + 1, (long long)(end_j - hunk_j), t1_COLOR_RESET);
+        printed++;
+
+        i = hunk_i;
+        j = hunk_j;
+
+        while ((i < end_i || j < end_j) && printed < t1_SNAPSHOT_MAX_DIFF_LINES)
+        {
+            if (i < end_i && d.a_deleted[i])
+                _t1_print_diff_line('-', d.a + i++);
+            else if (j < end_j && d.b_inserted[j])
+                _t1_print_diff_line('+', d.b + j++);
+            else
+            {
+                _t1_print_diff_line(' ', d.a + i);
+                i++;
+                j++;
+            }
+
+            printed++;
+        }
+    }
+
+    if (printed >= t1_SNAPSHOT_MAX_DIFF_LINES)
+        printf("  %s... diff truncated%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+
+    t1_free_memory(d.a);
+    t1_free_memory(d.b);
+    t1_free_memory(d.a_deleted);
+    t1_free_memory(d.b_inserted);
+    t1_free_memory(d.v1);
+    t1_free_memory(d.v2);
+}
+
+static const char *t1_snapshot_path(const char *source_file, const char *name, const char **dir)
+{
+    const char *filename = t1_get_filename(source_file);
+    int dir_len = (int)(filename - source_file);
+
+    *dir = t1_tprintf("%.*ssnapshots", dir_len, source_file).data;
+    return t1_tprintf("%s/%s.%s.snap", *dir, filename, name).data;
+}
+
+[[maybe_unused]] static bool t1_assert_matches_snapshot_(const t1_assert_info &info, const char *source_file,
+                                        const char *name, const void *data, u64 size)
+{
+    t1_atomic_add(&t1_tests::total_asserts, 1u);
+
+    const char *dir = nullptr;
+    const char *path = t1_snapshot_path(source_file, name, &dir);
+    const char *actual = (const char*)data;
+
+    t1_mapped_file golden{};
+    bool exists = t1_map_file(path, &golden);
+    bool matches = exists && golden.size == size && (size == 0 || memcmp(golden.data, actual, size) == 0);
+
+    defer { if (exists) t1_unmap_file(&golden); };
+
+    if (matches)
+        return true;
+
+    if (t1_tests::update_snapshots)
+    {
+        t1_make_directory(dir);
+
+        if (t1_write_file_atomic(path, actual, size))
+        {
+            printf("\n%supdated snapshot %s%s", t1_COLOR_WARN, path, t1_COLOR_RESET);
+            return true;
+        }
+    }
+
+    t1_atomic_add(&t1_tests::total_asserts_failed, 1u);
+    t1_tests::current_unit_failed = true;
+
+    printf("\n[%s%s:%d%s %s%s%s] %sassert failed:%s\n  assert_matches_snapshot(%s, %s)\n",
+           t1_COLOR_SOURCE, info.file, info.line,
+           t1_COLOR_RESET, t1_COLOR_TEST_NAME, t1_current_unit_label(),
+           t1_COLOR_RESET,
+           t1_COLOR_EXCEPTION, t1_COLOR_RESET,
+           info.str1, info.str2);
+
+    if (!exists)
+    {
+        printf("  snapshot %s%s%s does not exist, run with --update-snapshots to create it\n",
+               t1_COLOR_SOURCE, path, t1_COLOR_RESET);
+        return false;
+    }
+
+    printf("  does not match %s%s%s (%s-expected%s, %s+actual%s)\n",
+           t1_COLOR_SOURCE, path, t1_COLOR_RESET,
+           t1_COLOR_CHECK_EXPECTED, t1_COLOR_RESET, t1_COLOR_CHECK_ACTUAL, t1_COLOR_RESET);
+
+    bool binary = (golden.size > 0 && memchr(golden.data, '\0', golden.size) != nullptr)
+               || (size > 0 && memchr(actual, '\0', size) != nullptr);
+
+    if (binary)
+    {
+        u64 common = golden.size < size ? golden.size : size;
+        u64 offset = 0;
+
+        while (offset < common && golden.data[offset] == actual[offset])
+            offset++;
+
+        printf("  binary data differs at offset %#llx (expected %llu bytes, got %llu)\n",
+               (unsigned long long)offset, (unsigned long long)golden.size, (unsigned long long)size);
+    }
+    else
+        t1_print_diff(golden.data, golden.size, actual, size);
+
+    return false;
+}
+
+#define assert_matches_snapshot(NAME, DATA, SIZE)\
+    {\
+        if (!t1_assert_matches_snapshot_(t1_assert_info{t1_get_filename(__FILE__), __LINE__, #NAME, #DATA ", " #SIZE}, __FILE__, NAME, DATA, SIZE) && t1_tests::stop_on_fail)\
+            return;\
+    }
+
+// ---------- FAULT INJECTION ----------
+// with t1_shadow_stdlib (see VIRTUAL FILESYSTEM), the shadowed I/O functions
+// can fail on purpose to exercise error paths: the nth call of a function
+// fails with a given errno, calls fail with a probability, or reads and
+// writes transfer fewer bytes than requested (short counts). a failed call
+// returns -1 (nullptr for getcwd) with errno set and has no effect.
+//
+//     define_fault_test(save_reports_full_disk)
+//     {
+//         t1_fail_nth(faults, t1_sys_write, 2, ENOSPC);
+//         t1_fail_randomly(faults, t1_sys_read, 0.1, EINTR);
+//         t1_short_randomly(faults, t1_sys_write, 0.5);
+//
+//         assert_equal(save("out.dat", data, size), false);
+//     }
+//
+// random decisions derive from the seed of the unit (--seed), so the same
+// calls get the same faults again. every injected fault is logged, the log
+// and the seed are printed when the unit fails (or with --verbose).
+// rules apply to the threads the schedule is mounted on, also while a
+// t1_vfs is mounted. the first matching rule decides.
+#if t1_VFS
+enum t1_syscall : u8
+{
+    t1_sys_any,      // every shadowed function
+    t1_sys_open,     // open, openat
+    t1_sys_close,
+    t1_sys_read,
+    t1_sys_write,
+    t1_sys_pread,    // pread64
+    t1_sys_pwrite,   // pwrite64
+    t1_sys_lseek,
+    t1_sys_fsync,    // fsync, fdatasync
+    t1_sys_truncate, // truncate, ftruncate
+    t1_sys_rename,   // rename, renameat, renameat2
+    t1_sys_mkdir,    // mkdir, mkdirat
+    t1_sys_unlink,   // unlink, unlinkat
+    t1_sys_rmdir,    // rmdir, unlinkat with AT_REMOVEDIR
+    t1_sys_link,     // link, linkat
+    t1_sys_symlink,  // symlink, symlinkat
+    t1_sys_readlink, // readlink, readlinkat
+    t1_sys_access,
+    t1_sys_chown,    // chown, fchown, fchownat
+    t1_sys_chdir,    // chdir, fchdir
+    t1_sys_getcwd,
+    t1_sys_chroot,
+    t1_sys_count
+};
+
+static const char *t1_syscall_name(t1_syscall call)
+{
+    static const char *names[t1_sys_count] = {
+        "any", "open", "close", "read", "write", "pread", "pwrite", "lseek", "fsync", "truncate",
+        "rename", "mkdir", "unlink", "rmdir", "link", "symlink", "readlink", "access", "chown",
+        "chdir", "getcwd", "chroot"
+    };
+
+    return call < t1_sys_count ? names[call] : "?";
+}
+
+struct t1_fault_rule
+{
+    t1_syscall call;
+    u64 nth;            // only the nth matching call (from 1) may fail, 0 = any
+    double probability; // that a matching call fails
+    int error;          // errno of the failure, 0 = short count instead
+    u64 max_count;      // a short count is at most this (at least 1), 0 = random
+};
+
+struct t1_fault_event
+{
+    t1_syscall call;
+    u64 number;    // the call was the number-th call of the function
+    int error;     // 0 for short counts
+    u64 requested; // bytes, for short counts
+    u64 count;
+};
+
+struct t1_faults
+{
+    u32 lock;
+    u64 seed;
+    u64 random;
+    u64 calls[t1_sys_count]; // calls[t1_sys_any] counts all calls
+    t1_array<t1_fault_rule> rules;
+    t1_array<t1_fault_event> log;
+};
+
+static void init(t1_faults *f, u64 seed)
+{
+    f->lock = 0;
+    f->seed = seed;
+    f->random = (seed + 1) * 0x9E3779B97F4A7C15ull; // never 0
+
+    for (u32 i = 0; i < t1_sys_count; ++i)
+        f->calls[i] = 0;
+
+    init(&f->rules);
+    init(&f->log);
+}
+
+[[maybe_unused]] static void init(t1_faults *f)
+{
+    init(f, t1_tests::current_seed);
+}
+
+[[maybe_unused]] static void free(t1_faults *f)
+{
+    if (_t1_current_faults == f)
+        _t1_current_faults = nullptr;
+
+    free(&f->rules);
+    free(&f->log);
+}
+
+// xorshift64*
+static u64 _t1_fault_random(t1_faults *f)
+{
+    u64 x = f->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    f->random = x;
+
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static void t1_add_fault(t1_faults *f, t1_fault_rule rule)
+{
+    _t1_spin_lock(&f->lock);
+    t1_add_at_end(&f->rules, rule);
+    _t1_spin_unlock(&f->lock);
+}
+
+// the nth call of the function (from 1) fails with error
+[[maybe_unused]] static void t1_fail_nth(t1_faults *f, t1_syscall call, u64 n, int error)
+{
+    t1_add_fault(f, t1_fault_rule{call, n, 1.0, error, 0});
+}
+
+// calls of the function fail with error with the given probability
+[[maybe_unused]] static void t1_fail_randomly(t1_faults *f, t1_syscall call, double probability, int error)
+{
+    t1_add_fault(f, t1_fault_rule{call, 0, probability, error, 0});
+}
+
+// the nth read or write transfers at most max_count bytes (0 = a random
+// number), but always at least one byte less than requested.
+[[maybe_unused]] static void t1_short_nth(t1_faults *f, t1_syscall call, u64 n, u64 max_count = 0)
+{
+    t1_add_fault(f, t1_fault_rule{call, n, 1.0, 0, max_count});
+}
+
+[[maybe_unused]] static void t1_short_randomly(t1_faults *f, t1_syscall call, double probability, u64 max_count = 0)
+{
+    t1_add_fault(f, t1_fault_rule{call, 0, probability, 0, max_count});
+}
+
+// called by the shadowed functions. counts the call, returns the errno it
+// fails with or 0. a short count reduces *size.
+static int _t1_inject_fault(t1_syscall call, u64 *size)
+{
+    t1_faults *f = _t1_current_faults;
+    _t1_spin_lock(&f->lock);
+
+    u64 number = ++f->calls[call];
+    u64 total = ++f->calls[t1_sys_any];
+    int error = 0;
+
+    for (u64 i = 0; i < f->rules.size; ++i)
+    {
+        t1_fault_rule *r = f->rules.data + i;
+
+        if (r->call != t1_sys_any && r->call != call)
+            continue;
+
+        // short counts need at least 2 bytes to transfer fewer, but not none
+        if (r->error == 0 && (size == nullptr || *size < 2))
+            continue;
+
+        if (r->nth != 0 && r->nth != (r->call == t1_sys_any ? total : number))
+            continue;
+
+        if (r->probability < 1.0 && (double)(_t1_fault_random(f) >> 11) * 0x1.0p-53 >= r->probability)
+            continue;
+
+        t1_fault_event *e = t1_add_at_end(&f->log);
+        *e = t1_fault_event{call, number, r->error, size != nullptr ? *size : 0, 0};
+
+        if (r->error == 0)
+        {
+            u64 count = r->max_count != 0 ? r->max_count : 1 + _t1_fault_random(f) % (*size - 1);
+
+            if (count > *size - 1)
+                count = *size - 1;
+
+            *size = count;
+            e->count = count;
+        }
+
+        error = r->error;
+        break;
+    }
+
+    _t1_spin_unlock(&f->lock);
+
+    return error;
+}
+
+#define _t1_INJECT_FAULT(CALL, SIZE, FAILED)\
+    if (_t1_current_faults != nullptr)\
+    {\
+        int _t1_fault_error = _t1_inject_fault(CALL, SIZE);\
+        if (_t1_fault_error != 0)\
+        {\
+            errno = _t1_fault_error;\
+            return FAILED;\
+        }\
+    }
+
+// makes the shadowed functions on this thread use the schedule f (nullptr:
+// none), returns the previous schedule.
+static t1_faults *t1_faults_mount(t1_faults *f)
+{
+    t1_faults *previous = _t1_current_faults;
+    _t1_current_faults = f;
+    return previous;
+}
+
+// number of calls of the function so far
+[[maybe_unused]] static u64 t1_fault_calls(t1_faults *f, t1_syscall call)
+{
+    return t1_atomic_load(&f->calls[call]);
+}
+
+static const char *_t1_errno_name(int error)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 32)
+    const char *name = ::strerrorname_np(error);
+
+    if (name != nullptr)
+        return name;
+#endif
+
+    return ::strerror(error);
+}
+
+[[maybe_unused]] static void t1_print_faults(t1_faults *f)
+{
+    _t1_spin_lock(&f->lock);
+    defer { _t1_spin_unlock(&f->lock); };
+
+    printf("\n  %s%llu%s injected faults (%s--seed %llu%s)%s\n",
+           t1_COLOR_WARN, (unsigned long long)f->log.size, t1_COLOR_RESET,
+           t1_COLOR_SOURCE, (unsigned long long)f->seed, t1_COLOR_RESET,
+           f->log.size > 0 ? ":" : "");
+
+    for (u64 i = 0; i < f->log.size; ++i)
+    {
+        t1_fault_event *e = f->log.data + i;
+
+        if (e->error != 0)
+            printf("    %s #%llu failed with %s%s%s\n", t1_syscall_name(e->call), (unsigned long long)e->number,
+                   t1_COLOR_CHECK_ACTUAL, _t1_errno_name(e->error), t1_COLOR_RESET);
+        else
+            printf("    %s #%llu transferred %s%llu%s of %llu bytes\n", t1_syscall_name(e->call), (unsigned long long)e->number,
+                   t1_COLOR_CHECK_ACTUAL, (unsigned long long)e->count, t1_COLOR_RESET, (unsigned long long)e->requested);
+    }
+}
+
+struct _t1_faults_mount_scope
+{
+    t1_faults *previous;
+    bool once;
+
+    _t1_faults_mount_scope(t1_faults *f) : previous(t1_faults_mount(f)), once(true) {}
+    ~_t1_faults_mount_scope() { t1_faults_mount(previous); }
+};
+
+// t1_with_faults(&f) { ... } mounts the schedule f for the block
+#define t1_with_faults(FAULTS) \
+    for (_t1_faults_mount_scope JOIN(_t1_faults_scope, __LINE__){FAULTS}; JOIN(_t1_faults_scope, __LINE__).once; JOIN(_t1_faults_scope, __LINE__).once = false)
+
+// define_fault_test(NAME) runs its body with an empty schedule `faults`
+// mounted, seeded from the seed of the unit.
+#define define_fault_test(NAME) \
+    static void JOIN3(test_, NAME, _faults)(t1_faults *faults);\
+    static void JOIN3(test_, NAME, _f)()\
+    {\
+        t1_faults faults;\
+        init(&faults);\
+        defer { free(&faults); };\
+        t1_with_faults(&faults) JOIN3(test_, NAME, _faults)(&faults);\
+        if (t1_tests::current_unit_failed || t1_tests::verbose)\
+            t1_print_faults(&faults);\
+    }\
+    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
+            t1_unit{#NAME, JOIN3(test_, NAME, _f), t1_get_filename(__FILE__), __LINE__}); } \
+    static void JOIN3(test_, NAME, _faults)([[maybe_unused]] t1_faults *faults)
+#endif // t1_VFS
+
+// ---------- VIRTUAL FILESYSTEM ----------
+// with t1_shadow_stdlib defined before including t1.hpp (Linux only), t1
+// defines open, read, write, rename, fsync and the other shadowed I/O
+// functions itself. they call the kernel directly, unless a t1_vfs is mounted
+// on the calling thread: then paths and the descriptors it returned are
+// handled by that in-memory filesystem. nothing touches the disk, fsync is
+// free and there is nothing to clean up. every unit, or every thread, can
+// mount its own filesystem, so parallel units don't see each other's files.
+//
+//     define_vfs_test(saves_config)
+//     {
+//         t1_vfs_write_file(vfs, "/etc/app.conf", "a=1", 3);
+//
+//         assert_equal(save_config("/etc/app.conf", "a=2"), true);
+//         assert_vfs_file(vfs, "/etc/app.conf", "a=2", 3);
+//         assert_equal(vfs->stats.fsyncs, 1u);
+//         assert_equal(t1_vfs_open_files(vfs), 0u);
+//     }
+//
+// a filesystem can also be shared by several units (e.g. set up in
+// BEFORE_TESTS) and mounted with t1_with_vfs(&fs) { ... } or t1_vfs_mount.
+// relative paths start at "/", unless changed with chdir. descriptors of the
+// filesystem start at t1_VFS_FD_BASE, other descriptors (e.g. stdout) keep
+// going to the kernel while a filesystem is mounted, as do *at calls
+// relative to them. threads started by a unit don't inherit its filesystem.
+// permissions aren't checked.
+#if t1_VFS
+#define t1_VFS_FD_BASE (1 << 28)
+#define t1_VFS_MAX_SYMLINKS 40
+
+enum t1_vfs_node_type : u8
+{
+    t1_vfs_file,
+    t1_vfs_directory,
+    t1_vfs_symlink
+};
+
+struct t1_vfs_node;
+
+struct t1_vfs_entry
+{
+    char *name;
+    t1_vfs_node *node;
+};
+
+struct t1_vfs_node
+{
+    t1_vfs_node_type type;
+    u32 links;      // directory entries pointing to the node
+    u32 references; // open descriptors and working directory
+    uid_t uid;
+    gid_t gid;
+    t1_array<char> data;            // contents of a file, target of a symlink
+    t1_array<t1_vfs_entry> entries; // of a directory
+    t1_vfs_node *parent;            // of a directory
+};
+
+struct t1_vfs_descriptor
+{
+    t1_vfs_node *node; // nullptr if unused
+    u64 offset;
+    int flags;
+};
+
+struct t1_vfs_stats
+{
+    u64 opens;
+    u64 closes;
+    u64 reads;
+    u64 writes;
+    u64 bytes_read;
+    u64 bytes_written;
+    u64 fsyncs;
+    u64 renames;
+    u64 unlinks;
+};
+
+struct t1_vfs
+{
+    u32 lock;
+    t1_vfs_node *root;
+    t1_vfs_node *cwd;
+    t1_array<t1_vfs_descriptor> descriptors;
+    t1_vfs_stats stats;
+};
+
+// ----- kernel calls, for everything not handled by a mounted filesystem -----
+#define _t1_sys(...) ::syscall(__VA_ARGS__)
+
+// ----- nodes -----
+static t1_vfs_node *_t1_vfs_new_node(t1_vfs_node_type type, t1_vfs_node *parent)
+{
+    t1_vfs_node *n = t1_reallocate_memory<t1_vfs_node>(nullptr, 1);
+    ::memset((void*)n, 0, sizeof(t1_vfs_node));
+
+    n->type = type;
+    n->parent = parent != nullptr ? parent : n;
+    init(&n->data);
+    init(&n->entries);
+
+    return n;
+}
+
+static void _t1_vfs_delete_node(t1_vfs_node *n)
+{
+    for (u64 i = 0; i < n->entries.size; ++i)
+    {
+        t1_vfs_entry *e = n->entries.data + i;
+        ::free(e->name);
+
+        if (--e->node->links == 0 && e->node->references == 0)
+            _t1_vfs_delete_node(e->node);
+    }
+
+    free(&n->entries);
+    free(&n->data);
+    t1_free_memory(n);
+}
+
+// deletes n if nothing refers to it anymore
+static void _t1_vfs_release(t1_vfs_node *n)
+{
+    if (n->links == 0 && n->references == 0)
+        _t1_vfs_delete_node(n);
+}
+
+static t1_vfs_entry *_t1_vfs_find_entry(t1_vfs_node *dir, const char *name, u64 len)
+{
+    for (u64 i = 0; i < dir->entries.size; ++i)
+    {
+        t1_vfs_entry *e = dir->entries.data + i;
+
+        if (::strncmp(e->name, name, len) == 0 && e->name[len] == '\0')
+            return e;
+    }
+
+    return nullptr;
+}
+
+static void _t1_vfs_add_entry(t1_vfs_node *dir, const char *name, t1_vfs_node *node)
+{
+    u64 len = strlen(name);
+    char *copy = (char*)::malloc(len + 1);
+    ::memcpy(copy, name, len + 1);
+
+    t1_add_at_end(&dir->entries, t1_vfs_entry{copy, node});
+    node->links++;
+
+    if (node->type == t1_vfs_directory)
+        node->parent = dir;
+}
+
+// removes the entry without releasing its node
+static t1_vfs_node *_t1_vfs_remove_entry(t1_vfs_node *dir, t1_vfs_entry *e)
+{
+    t1_vfs_node *node = e->node;
+
+    ::free(e->name);
+    *e = dir->entries[dir->entries.size - 1];
+    dir->entries.size--;
+    node->links--;
+
+    return node;
+}
+
+// ----- paths -----
+static t1_vfs_node *_t1_vfs_lookup(t1_vfs *vfs, t1_vfs_node *start, const char *path, bool follow, int *err, u32 depth = 0);
+
+// splits path into the directory holding its last component and the name of
+// the component, following symlinks on the way. returns 0 or an errno value.
+static int _t1_vfs_walk(t1_vfs *vfs, t1_vfs_node *start, const char *path, t1_vfs_node **dir, char *name, u32 depth)
+{
+    if (path == nullptr)
+        return EFAULT;
+
+    if (path[0] == '\0')
+        return ENOENT;
+
+    if (depth > t1_VFS_MAX_SYMLINKS)
+        return ELOOP;
+
+    t1_vfs_node *cur = path[0] == '/' ? vfs->root : start;
+    const char *p = path;
+
+    while (true)
+    {
+        while (*p == '/')
+            p++;
+
+        const char *end = p;
+
+        while (*end != '\0' && *end != '/')
+            end++;
+
+        u64 len = (u64)(end - p);
+
+        if (len > 255)
+            return ENAMETOOLONG;
+
+        const char *next = end;
+
+        while (*next == '/')
+            next++;
+
+        // last component (trailing slashes are ignored)
+        if (*next == '\0')
+        {
+            ::memcpy(name, p, len);
+            name[len] = '\0';
+            *dir = cur;
+            return 0;
+        }
+
+        if (len == 1 && p[0] == '.')
+            ;
+        else if (len == 2 && p[0] == '.' && p[1] == '.')
+            cur = cur->parent;
+        else
+        {
+            t1_vfs_entry *e = _t1_vfs_find_entry(cur, p, len);
+
+            if (e == nullptr)
+                return ENOENT;
+
+            t1_vfs_node *n = e->node;
+
+            if (n->type == t1_vfs_symlink)
+            {
+                char target[4096];
+                u64 tlen = n->data.size < sizeof(target) - 1 ? n->data.size : sizeof(target) - 1;
+                ::memcpy(target, n->data.data, tlen);
+                target[tlen] = '\0';
+
+                t1_vfs_node *tdir;
+                char tname[256];
+                int err = _t1_vfs_walk(vfs, cur, target, &tdir, tname, depth + 1);
+
+                if (err != 0)
+                    return err;
+
+                if (tname[0] == '\0' || strcmp(tname, ".") == 0)
+                    n = tdir;
+                else if (strcmp(tname, "..") == 0)
+                    n = tdir->parent;
+                else
+                {
+                    t1_vfs_entry *te = _t1_vfs_find_entry(tdir, tname, strlen(tname));
+
+                    if (te == nullptr)
+                        return ENOENT;
+
+                    n = te->node;
+
+                    // symlink to a symlink
+                    if (n->type == t1_vfs_symlink)
+                    {
+                        n = _t1_vfs_lookup(vfs, tdir, tname, true, &err, depth + 1);
+
+                        if (n == nullptr)
+                            return err;
+                    }
+                }
+            }
+
+            if (n->type != t1_vfs_directory)
+                return ENOTDIR;
+
+            cur = n;
+        }
+
+        p = next;
+    }
+}
+
+// finds the node at path, nullptr with *err set if there is none.
+static t1_vfs_node *_t1_vfs_lookup(t1_vfs *vfs, t1_vfs_node *start, const char *path, bool follow, int *err, u32 depth)
+{
+    t1_vfs_node *dir;
+    char name[256];
+
+    *err = _t1_vfs_walk(vfs, start, path, &dir, name, depth);
+
+    if (*err != 0)
+        return nullptr;
+
+    if (name[0] == '\0' || strcmp(name, ".") == 0)
+        return dir;
+
+    if (strcmp(name, "..") == 0)
+        return dir->parent;
+
+    t1_vfs_entry *e = _t1_vfs_find_entry(dir, name, strlen(name));
+
+    if (e == nullptr)
+    {
+        *err = ENOENT;
+        return nullptr;
+    }
+
+    t1_vfs_node *n = e->node;
+
+    if (follow && n->type == t1_vfs_symlink)
+    {
+        if (depth >= t1_VFS_MAX_SYMLINKS)
+        {
+            *err = ELOOP;
+            return nullptr;
+        }
+
+        char target[4096];
+        u64 len = n->data.size < sizeof(target) - 1 ? n->data.size : sizeof(target) - 1;
+        ::memcpy(target, n->data.data, len);
+        target[len] = '\0';
+
+        return _t1_vfs_lookup(vfs, dir, target, true, err, depth + 1);
+    }
+
+    // a trailing slash requires a directory
+    u64 plen = strlen(path);
+
+    if (plen > 0 && path[plen - 1] == '/' && n->type != t1_vfs_directory)
+    {
+        *err = ENOTDIR;
+        return nullptr;
+    }
+
+    return n;
+}
+
+static bool _t1_vfs_is_special_name(const char *name)
+{
+    return name[0] == '\0' || strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+}
+
+// ----- descriptors -----
+static t1_vfs_descriptor *_t1_vfs_get_descriptor(t1_vfs *vfs, int fd)
+{
+    if (fd < t1_VFS_FD_BASE || (u64)(fd - t1_VFS_FD_BASE) >= vfs->descriptors.size)
+        return nullptr;
+
+    t1_vfs_descriptor *d = vfs->descriptors.data + (fd - t1_VFS_FD_BASE);
+    return d->node != nullptr ? d : nullptr;
+}
+
+static int _t1_vfs_add_descriptor(t1_vfs *vfs, t1_vfs_node *node, int flags)
+{
+    u64 i = 0;
+
+    // lowest free descriptor, like the kernel
+    while (i < vfs->descriptors.size && vfs->descriptors[i].node != nullptr)
+        i++;
+
+    if (i == vfs->descriptors.size)
+        t1_add_at_end(&vfs->descriptors);
+
+    vfs->descriptors[i] = t1_vfs_descriptor{node, 0, flags};
+    node->references++;
+
+    return t1_VFS_FD_BASE + (int)i;
+}
+
+// the directory *at calls start at, nullptr with *err set if dirfd is invalid
+static t1_vfs_node *_t1_vfs_start(t1_vfs *vfs, int dirfd, int *err)
+{
+    if (dirfd == AT_FDCWD)
+        return vfs->cwd;
+
+    t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, dirfd);
+
+    if (d == nullptr)
+        *err = EBADF;
+    else if (d->node->type != t1_vfs_directory)
+        *err = ENOTDIR;
+    else
+        return d->node;
+
+    return nullptr;
+}
+
+// whether a call with dirfd and path goes to the mounted filesystem
+static inline t1_vfs *_t1_vfs_for(int dirfd, const char *path)
+{
+    t1_vfs *vfs = _t1_current_vfs;
+
+    if (vfs == nullptr)
+        return nullptr;
+
+    if (dirfd == AT_FDCWD || dirfd >= t1_VFS_FD_BASE || (path != nullptr && path[0] == '/'))
+        return vfs;
+
+    return nullptr;
+}
+
+static inline t1_vfs *_t1_vfs_for_fd(int fd)
+{
+    return fd >= t1_VFS_FD_BASE ? _t1_current_vfs : nullptr;
+}
+
+static inline int _t1_vfs_fail(int err)
+{
+    errno = err;
+    return -1;
+}
+
+// ----- file contents -----
+static void _t1_vfs_resize(t1_vfs_node *n, u64 size)
+{
+    if (size > n->data.size)
+    {
+        u64 old_size = n->data.size;
+        t1_add_elements(&n->data, size - old_size);
+        ::memset(n->data.data + old_size, 0, size - old_size);
+    }
+    else
+        n->data.size = size;
+}
+
+static s64 _t1_vfs_read_at(t1_vfs *vfs, t1_vfs_node *n, void *buf, u64 size, u64 offset)
+{
+    if (n->type == t1_vfs_directory)
+        return _t1_vfs_fail(EISDIR);
+
+    u64 count = 0;
+
+    if (offset < n->data.size)
+    {
+        count = n->data.size - offset < size ? n->data.size - offset : size;
+        ::memcpy(buf, n->data.data + offset, count);
+    }
+
+    vfs->stats.reads++;
+    vfs->stats.bytes_read += count;
+
+    return (s64)count;
+}
+
+static s64 _t1_vfs_write_at(t1_vfs *vfs, t1_vfs_node *n, const void *buf, u64 size, u64 offset)
+{
+    if (offset + size > n->data.size)
+        _t1_vfs_resize(n, offset + size);
+
+    if (size > 0)
+        ::memcpy(n->data.data + offset, buf, size);
+
+    vfs->stats.writes++;
+    vfs->stats.bytes_written += size;
+
+    return (s64)size;
+}
+
+// ----- operations, called with the lock held -----
+// opens path relative to the directory start
+static int _t1_vfs_open_at(t1_vfs *vfs, t1_vfs_node *start, const char *path, int flags, mode_t mode)
+{
+    (void)mode;
+
+#ifdef O_TMPFILE
+    if ((flags & O_TMPFILE) == O_TMPFILE)
+        return _t1_vfs_fail(EOPNOTSUPP);
+#endif
+
+    t1_vfs_node *dir;
+    char name[256];
+    int err = _t1_vfs_walk(vfs, start, path, &dir, name, 0);
+
+    if (err != 0)
+        return _t1_vfs_fail(err);
+
+    t1_vfs_node *n = nullptr;
+
+    if (flags & O_CREAT)
+    {
+        if (name[0] == '\0' || strcmp(name, ".") == 0)
+            return _t1_vfs_fail(EISDIR);
+
+        if (strcmp(name, "..") == 0)
+            return _t1_vfs_fail(EISDIR);
+
+        t1_vfs_entry *e = _t1_vfs_find_entry(dir, name, strlen(name));
+        n = e != nullptr ? e->node : nullptr;
+
+        if (n != nullptr && (flags & O_EXCL))
+            return _t1_vfs_fail(EEXIST);
+
+        if (n != nullptr && n->type == t1_vfs_symlink)
+        {
+            if (flags & O_NOFOLLOW)
+                return _t1_vfs_fail(ELOOP);
+
+            n = _t1_vfs_lookup(vfs, dir, name, true, &err);
+
+            // dangling symlinks create their target, relative targets are
+            // relative to the directory of the symlink
+            if (n == nullptr && err == ENOENT)
+            {
+                char target[4096];
+                u64 len = e->node->data.size < sizeof(target) - 1 ? e->node->data.size : sizeof(target) - 1;
+                ::memcpy(target, e->node->data.data, len);
+                target[len] = '\0';
+
+                return _t1_vfs_open_at(vfs, dir, target, flags & ~O_EXCL, mode);
+            }
+
+            if (n == nullptr)
+                return _t1_vfs_fail(err);
+        }
+
+        if (n == nullptr)
+        {
+            n = _t1_vfs_new_node(t1_vfs_file, nullptr);
+            _t1_vfs_add_entry(dir, name, n);
+        }
+    }
+    else
+    {
+        n = _t1_vfs_lookup(vfs, start, path, !(flags & O_NOFOLLOW), &err);
+
+        if (n == nullptr)
+            return _t1_vfs_fail(err);
+
+        if (n->type == t1_vfs_symlink)
+            return _t1_vfs_fail(ELOOP);
+    }
+
+    int access_mode = flags & O_ACCMODE;
+
+    if ((flags & O_DIRECTORY) && n->type != t1_vfs_directory)
+        return _t1_vfs_fail(ENOTDIR);
+
+    if (n->type == t1_vfs_directory && access_mode != O_RDONLY)
+        return _t1_vfs_fail(EISDIR);
+
+    if ((flags & O_TRUNC) && n->type == t1_vfs_file && access_mode != O_RDONLY)
+        n->data.size = 0;
+
+    vfs->stats.opens++;
+
+    return _t1_vfs_add_descriptor(vfs, n, flags);
+}
+
+static int _t1_vfs_open(t1_vfs *vfs, int dirfd, const char *path, int flags, mode_t mode)
+{
+    int err = 0;
+    t1_vfs_node *start = _t1_vfs_start(vfs, dirfd, &err);
+
+    if (start == nullptr)
+        return _t1_vfs_fail(err);
+
+    return _t1_vfs_open_at(vfs, start, path, flags, mode);
+}
+
+static int _t1_vfs_close(t1_vfs *vfs, int fd)
+{
+    t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, fd);
+
+    if (d == nullptr)
+        return _t1_vfs_fail(EBADF);
+
+    t1_vfs_node *n = d->node;
+    d->node = nullptr;
+    n->references--;
+    _t1_vfs_release(n);
+
+    vfs->stats.closes++;
+
+    return 0;
+}
+
+static s64 _t1_vfs_read(t1_vfs *vfs, int fd, void *buf, u64 size, s64 offset)
+{
+    t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, fd);
+
+    if (d == nullptr || (d->flags & O_ACCMODE) == O_WRONLY)
+        return _t1_vfs_fail(EBADF);
+
+    if (offset >= 0)
+        return _t1_vfs_read_at(vfs, d->node, buf, size, (u64)offset);
+
+    s64 n = _t1_vfs_read_at(vfs, d->node, buf, size, d->offset);
+
+    if (n > 0)
+        d->offset += (u64)n;
+
+    return n;
+}
+
+static s64 _t1_vfs_write(t1_vfs *vfs, int fd, const void *buf, u64 size, s64 offset)
+{
+    t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, fd);
+
+    if (d == nullptr || (d->flags & O_ACCMODE) == O_RDONLY)
+        return _t1_vfs_fail(EBADF);
+
+    if (offset >= 0)
+        return _t1_vfs_write_at(vfs, d->node, buf, size, (u64)offset);
+
+    if (d->flags & O_APPEND)
+        d->offset = d->node->data.size;
+
+    s64 n = _t1_vfs_write_at(vfs, d->node, buf, size, d->offset);
+
+    if (n > 0)
+        d->offset += (u64)n;
+
+    return n;
+}
+
+static s64 _t1_vfs_lseek(t1_vfs *vfs, int fd, s64 offset, int whence)
+{
+    t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, fd);
+
+    if (d == nullptr)
+        return _t1_vfs_fail(EBADF);
+
+    s64 base = whence == SEEK_SET ? 0
+             : whence == SEEK_CUR ? (s64)d->offset
+             : whence == SEEK_END ? (s64)d->node->data.size
+             : -1;
+
+    if (base < 0 || base + offset < 0)
+        return _t1_vfs_fail(EINVAL);
+
+    d->offset = (u64)(base + offset);
+    return (s64)d->offset;
+}
+
+static int _t1_vfs_mkdir(t1_vfs *vfs, int dirfd, const char *path)
+{
+    int err = 0;
+    t1_vfs_node *start = _t1_vfs_start(vfs, dirfd, &err);
+
+    if (start == nullptr)
+        return _t1_vfs_fail(err);
+
+    t1_vfs_node *dir;
+    char name[256];
+    err = _t1_vfs_walk(vfs, start, path, &dir, name, 0);
+
+    if (err != 0)
+        return _t1_vfs_fail(err);
+
+    if (_t1_vfs_is_special_name(name) || _t1_vfs_find_entry(dir, name, strlen(name)) != nullptr)
+        return _t1_vfs_fail(EEXIST);
+
+    _t1_vfs_add_entry(dir, name, _t1_vfs_new_node(t1_vfs_directory, dir));
+    return 0;
+}
+
+static int _t1_vfs_unlink(t1_vfs *vfs, int dirfd, const char *path, bool directory)
+{
+    int err = 0;
+    t1_vfs_node *start = _t1_vfs_start(vfs, dirfd, &err);
+
+    if (start == nullptr)
+        return _t1_vfs_fail(err);
+
+    t1_vfs_node *dir;
+    char name[256];
+    err = _t1_vfs_walk(vfs, start, path, &dir, name, 0);
+
+    if (err != 0)
+        return _t1_vfs_fail(err);
+
+    if (_t1_vfs_is_special_name(name))
+        return _t1_vfs_fail(directory ? (name[0] == '.' && name[1] == '\0' ? EINVAL : ENOTEMPTY) : EISDIR);
+
+    t1_vfs_entry *e = _t1_vfs_find_entry(dir, name, strlen(name));
+
+    if (e == nullptr)
+        return _t1_vfs_fail(ENOENT);
+
+    if (directory)
+    {
+        if (e->node->type != t1_vfs_directory)
+            return _t1_vfs_fail(ENOTDIR);
+
+        if (e->node->entries.size > 0)
+            return _t1_vfs_fail(ENOTEMPTY);
+    }
+    else if (e->node->type == t1_vfs_directory)
+        return _t1_vfs_fail(EISDIR);
+
+    _t1_vfs_release(_t1_vfs_remove_entry(dir, e));
+    vfs->stats.unlinks++;
+
+    return 0;
+}
+
+static int _t1_vfs_rename(t1_vfs *vfs, int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, unsigned int flags)
+{
+    int err = 0;
+    t1_vfs_node *old_start = _t1_vfs_start(vfs, old_dirfd, &err);
+    t1_vfs_node *new_start = old_start != nullptr ? _t1_vfs_start(vfs, new_dirfd, &err) : nullptr;
+
+    if (new_start == nullptr)
+        return _t1_vfs_fail(err);
+
+    t1_vfs_node *old_dir;
+    t1_vfs_node *new_dir;
+    char old_name[256];
+    char new_name[256];
+
+    err = _t1_vfs_walk(vfs, old_start, old_path, &old_dir, old_name, 0);
+
+    if (err == 0)
+        err = _t1_vfs_walk(vfs, new_start, new_path, &new_dir, new_name, 0);
+
+    if (err != 0)
+        return _t1_vfs_fail(err);
+
+    if (_t1_vfs_is_special_name(old_name) || _t1_vfs_is_special_name(new_name))
+        return _t1_vfs_fail(EBUSY);
+
+    t1_vfs_entry *from = _t1_vfs_find_entry(old_dir, old_name, strlen(old_name));
+
+    if (from == nullptr)
+        return _t1_vfs_fail(ENOENT);
+
+    t1_vfs_node *node = from->node;
+
+    // a directory can't move into itself
+    if (node->type == t1_vfs_directory)
+        for (t1_vfs_node *d = new_dir; ; d = d->parent)
+        {
+            if (d == node)
+                return _t1_vfs_fail(EINVAL);
+
+            if (d == d->parent)
+                break;
+        }
+
+    t1_vfs_entry *to = _t1_vfs_find_entry(new_dir, new_name, strlen(new_name));
+
+#ifdef RENAME_EXCHANGE
+    if (flags & RENAME_EXCHANGE)
+    {
+        if (to == nullptr)
+            return _t1_vfs_fail(ENOENT);
+
+        t1_vfs_node *other = to->node;
+        from->node = other;
+        to->node = node;
+
+        if (other->type == t1_vfs_directory)
+            other->parent = old_dir;
+
+        if (node->type == t1_vfs_directory)
+            node->parent = new_dir;
+
+        vfs->stats.renames++;
+        return 0;
+    }
+#endif
+
+    if (to != nullptr)
+    {
+        if (to->node == node)
+            return 0;
+
+#ifdef RENAME_NOREPLACE
+        if (flags & RENAME_NOREPLACE)
+            return _t1_vfs_fail(EEXIST);
+#endif
+
+        if (node->type == t1_vfs_directory && to->node->type != t1_vfs_directory)
+            return _t1_vfs_fail(ENOTDIR);
+
+        if (node->type != t1_vfs_directory && to->node->type == t1_vfs_directory)
+            return _t1_vfs_fail(EISDIR);
+
+        if (to->node->type == t1_vfs_directory && to->node->entries.size > 0)
+            return _t1_vfs_fail(ENOTEMPTY);
+
+        _t1_vfs_release(_t1_vfs_remove_entry(new_dir, to));
+
+        // removing may have moved the entry
+        from = _t1_vfs_find_entry(old_dir, old_name, strlen(old_name));
+    }
+
+    node->references++;
+    _t1_vfs_remove_entry(old_dir, from);
+    _t1_vfs_add_entry(new_dir, new_name, node);
+    node->references--;
+
+    vfs->stats.renames++;
+    return 0;
+}
+
+static int _t1_vfs_link(t1_vfs *vfs, int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, bool follow)
+{
+    int err = 0;
+    t1_vfs_node *old_start = _t1_vfs_start(vfs, old_dirfd, &err);
+    t1_vfs_node *new_start = old_start != nullptr ? _t1_vfs_start(vfs, new_dirfd, &err) : nullptr;
+
+    if (new_start == nullptr)
+        return _t1_vfs_fail(err);
+
+    t1_vfs_node *node = _t1_vfs_lookup(vfs, old_start, old_path, follow, &err);
+
+    if (node == nullptr)
+        return _t1_vfs_fail(err);
+
+    if (node->type == t1_vfs_directory)
+        return _t1_vfs_fail(EPERM);
+
+    t1_vfs_node *dir;
+    char name[256];
+    err = _t1_vfs_walk(vfs, new_start, new_path, &dir, name, 0);
+
+    if (err != 0)
+        return _t1_vfs_fail(err);
+
+    if (_t1_vfs_is_special_name(name) || _t1_vfs_find_entry(dir, name, strlen(name)) != nullptr)
+        return _t1_vfs_fail(EEXIST);
+
+    _t1_vfs_add_entry(dir, name, node);
+    return 0;
+}
+
+static int _t1_vfs_symlink(t1_vfs *vfs, const char *target, int dirfd, const char *path)
+{
+    int err = 0;
+    t1_vfs_node *start = _t1_vfs_start(vfs, dirfd, &err);
+
+    if (start == nullptr)
+        return _t1_vfs_fail(err);
+
+    if (target == nullptr)
+        return _t1_vfs_fail(EFAULT);
+
+    if (target[0] == '\0')
+        return _t1_vfs_fail(ENOENT);
+
+    t1_vfs_node *dir;
+    char name[256];
+    err = _t1_vfs_walk(vfs, start, path, &dir, name, 0);
+
+    if (err != 0)
+        return _t1_vfs_fail(err);
+
+    if (_t1_vfs_is_special_name(name) || _t1_vfs_find_entry(dir, name, strlen(name)) != nullptr)
+        return _t1_vfs_fail(EEXIST);
+
+    t1_vfs_node *n = _t1_vfs_new_node(t1_vfs_symlink, nullptr);
+    u64 len = strlen(target);
+    ::memcpy(t1_add_elements(&n->data, len), target, len);
+    _t1_vfs_add_entry(dir, name, n);
+
+    return 0;
+}
+
+static s64 _t1_vfs_readlink(t1_vfs *vfs, int dirfd, const char *path, char *buf, u64 size)
+{
+    int err = 0;
+    t1_vfs_node *start = _t1_vfs_start(vfs, dirfd, &err);
+    t1_vfs_node *n = start != nullptr ? _t1_vfs_lookup(vfs, start, path, false, &err) : nullptr;
+
+    if (n == nullptr)
+        return _t1_vfs_fail(err);
+
+    if (n->type != t1_vfs_symlink)
+        return _t1_vfs_fail(EINVAL);
+
+    u64 len = n->data.size < size ? n->data.size : size;
+    ::memcpy(buf, n->data.data, len);
+
+    return (s64)len;
+}
+
+// the path of dir, written backwards from end. returns the start or nullptr.
+static char *_t1_vfs_path_of(t1_vfs_node *dir, char *buf, char *end)
+{
+    char *p = end;
+    *--p = '\0';
+
+    if (dir->parent == dir)
+    {
+        *--p = '/';
+        return p;
+    }
+
+    for (t1_vfs_node *n = dir; n->parent != n; n = n->parent)
+    {
+        const char *name = "";
+
+        for (u64 i = 0; i < n->parent->entries.size; ++i)
+            if (n->parent->entries[i].node == n)
+                name = n->parent->entries[i].name;
+
+        u64 len = strlen(name);
+
+        if ((u64)(p - buf) < len + 1)
+            return nullptr;
+
+        p -= len;
+        ::memcpy(p, name, len);
+        *--p = '/';
+    }
+
+    return p;
+}
+
+static void _t1_vfs_set_cwd(t1_vfs *vfs, t1_vfs_node *dir)
+{
+    dir->references++;
+    t1_vfs_node *old = vfs->cwd;
+    vfs->cwd = dir;
+    old->references--;
+    _t1_vfs_release(old);
+}
+
+// ----- filesystems -----
+static void init(t1_vfs *vfs)
+{
+    vfs->lock = 0;
+    vfs->root = _t1_vfs_new_node(t1_vfs_directory, nullptr);
+    vfs->root->links = 1;
+    vfs->root->references = 1;
+    vfs->cwd = vfs->root;
+    vfs->root->references++;
+    init(&vfs->descriptors);
+    vfs->stats = t1_vfs_stats{};
+}
+
+static void free(t1_vfs *vfs)
+{
+    if (_t1_current_vfs == vfs)
+        _t1_current_vfs = nullptr;
+
+    if (vfs->root == nullptr)
+        return;
+
+    for (u64 i = 0; i < vfs->descriptors.size; ++i)
+        if (vfs->descriptors[i].node != nullptr)
+        {
+            vfs->descriptors[i].node->references--;
+            _t1_vfs_release(vfs->descriptors[i].node);
+        }
+
+    free(&vfs->descriptors);
+
+    vfs->cwd->references--;
+    _t1_vfs_release(vfs->cwd);
+
+    vfs->root->links = 0;
+    vfs->root->references = 0;
+    _t1_vfs_delete_node(vfs->root);
+
+    vfs->root = nullptr;
+    vfs->cwd = nullptr;
+}
+
+// makes the shadowed functions on this thread use vfs (nullptr: the real
+// filesystem), returns the previously mounted filesystem.
+static t1_vfs *t1_vfs_mount(t1_vfs *vfs)
+{
+    t1_vfs *previous = _t1_current_vfs;
+    _t1_current_vfs = vfs;
+    return previous;
+}
+
+[[maybe_unused]] static t1_vfs *t1_vfs_mounted()
+{
+    return _t1_current_vfs;
+}
+
+// creates the directory path and its parents, returns false if a part of
+// the path exists and is not a directory.
+static bool t1_vfs_make_directories(t1_vfs *vfs, const char *path)
+{
+    _t1_spin_lock(&vfs->lock);
+
+    char partial[4096];
+    u64 len = strlen(path);
+    bool ok = len < sizeof(partial);
+
+    for (u64 i = 1; ok && i <= len; ++i)
+    {
+        if (i < len && path[i] != '/')
+            continue;
+
+        ::memcpy(partial, path, i);
+        partial[i] = '\0';
+
+        int err = 0;
+        t1_vfs_node *n = _t1_vfs_lookup(vfs, vfs->cwd, partial, true, &err);
+
+        if (n == nullptr)
+            ok = _t1_vfs_mkdir(vfs, AT_FDCWD, partial) == 0;
+        else
+            ok = n->type == t1_vfs_directory;
+    }
+
+    _t1_spin_unlock(&vfs->lock);
+
+    return ok;
+}
+
+// creates or replaces the file at path including its parent directories,
+// doesn't count in the stats.
+static bool t1_vfs_write_file(t1_vfs *vfs, const char *path, const void *data, u64 size)
+{
+    const char *slash = strrchr(path, '/');
+
+    if (slash != nullptr && slash != path
+     && !t1_vfs_make_directories(vfs, t1_tprintf("%.*s", (int)(slash - path), path).data))
+        return false;
+
+    _t1_spin_lock(&vfs->lock);
+
+    t1_vfs_stats stats = vfs->stats;
+    int fd = _t1_vfs_open(vfs, AT_FDCWD, path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd != -1 && _t1_vfs_write(vfs, fd, data, size, -1) == (s64)size;
+
+    if (fd != -1)
+        _t1_vfs_close(vfs, fd);
+
+    vfs->stats = stats;
+
+    _t1_spin_unlock(&vfs->lock);
+
+    return ok;
+}
+
+// the contents of the file at path, nullptr if there is none. points into
+// the filesystem, valid until the file is changed.
+static const char *t1_vfs_file_data(t1_vfs *vfs, const char *path, u64 *size)
+{
+    _t1_spin_lock(&vfs->lock);
+
+    int err = 0;
+    t1_vfs_node *n = _t1_vfs_lookup(vfs, vfs->cwd, path, true, &err);
+
+    _t1_spin_unlock(&vfs->lock);
+
+    if (n == nullptr || n->type != t1_vfs_file)
+        return nullptr;
+
+    if (size != nullptr)
+        *size = n->data.size;
+
+    return n->data.data != nullptr ? n->data.data : "";
+}
+
+[[maybe_unused]] static bool t1_vfs_exists(t1_vfs *vfs, const char *path)
+{
+    _t1_spin_lock(&vfs->lock);
+
+    int err = 0;
+    bool ret = _t1_vfs_lookup(vfs, vfs->cwd, path, false, &err) != nullptr;
+
+    _t1_spin_unlock(&vfs->lock);
+
+    return ret;
+}
+
+// size of the file at path, -1 if there is none
+static s64 t1_vfs_file_size(t1_vfs *vfs, const char *path)
+{
+    u64 size = 0;
+    return t1_vfs_file_data(vfs, path, &size) != nullptr ? (s64)size : -1;
+}
+
+// number of open descriptors, e.g. to check that none leaked
+static u64 t1_vfs_open_files(t1_vfs *vfs)
+{
+    _t1_spin_lock(&vfs->lock);
+
+    u64 count = 0;
+
+    for (u64 i = 0; i < vfs->descriptors.size; ++i)
+        count += vfs->descriptors[i].node != nullptr;
+
+    _t1_spin_unlock(&vfs->lock);
+
+    return count;
+}
+
+struct _t1_vfs_mount_scope
+{
+    t1_vfs *previous;
+    bool once;
+
+    _t1_vfs_mount_scope(t1_vfs *vfs) : previous(t1_vfs_mount(vfs)), once(true) {}
+    ~_t1_vfs_mount_scope() { t1_vfs_mount(previous); }
+};
+
+// t1_with_vfs(&fs) { ... } mounts fs for the block
+#define t1_with_vfs(VFS) \
+    for (_t1_vfs_mount_scope JOIN(_t1_vfs_scope, __LINE__){VFS}; JOIN(_t1_vfs_scope, __LINE__).once; JOIN(_t1_vfs_scope, __LINE__).once = false)
+
+// define_vfs_test(NAME) runs its body with a fresh filesystem `vfs` mounted
+#define define_vfs_test(NAME) \
+    static void JOIN3(test_, NAME, _vfs)(t1_vfs *vfs);\
+    static void JOIN3(test_, NAME, _f)()\
+    {\
+        t1_vfs vfs;\
+        init(&vfs);\
+        defer { free(&vfs); };\
+        t1_with_vfs(&vfs) JOIN3(test_, NAME, _vfs)(&vfs);\
+    }\
+    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
+            t1_unit{#NAME, JOIN3(test_, NAME, _f), t1_get_filename(__FILE__), __LINE__}); } \
+    static void JOIN3(test_, NAME, _vfs)([[maybe_unused]] t1_vfs *vfs)
+
+[[maybe_unused]] static bool t1_assert_vfs_file_(const t1_assert_info &info, t1_vfs *vfs, const char *path,
+                                                  const void *expected_data, u64 expected_size)
+{
+    t1_atomic_add(&t1_tests::total_asserts, 1u);
+
+    u64 size = 0;
+    const char *actual = t1_vfs_file_data(vfs, path, &size);
+    const char *expected = (const char*)expected_data;
+
+    if (actual != nullptr && size == expected_size && (size == 0 || memcmp(actual, expected, size) == 0))
+        return true;
+
+    t1_atomic_add(&t1_tests::total_asserts_failed, 1u);
+    t1_tests::current_unit_failed = true;
+
+    printf("\n[%s%s:%d%s %s%s%s] %sassert failed:%s\n  assert_vfs_file(%s, %s)\n",
+           t1_COLOR_SOURCE, info.file, info.line,
+           t1_COLOR_RESET, t1_COLOR_TEST_NAME, t1_current_unit_label(),
+           t1_COLOR_RESET,
+           t1_COLOR_EXCEPTION, t1_COLOR_RESET,
+           info.str1, info.str2);
+
+    if (actual == nullptr)
+    {
+        printf("  %s%s%s is not a file\n", t1_COLOR_SOURCE, path, t1_COLOR_RESET);
+        return false;
+    }
+
+    printf("  %s%s%s differs (%s-expected%s, %s+actual%s)\n",
+           t1_COLOR_SOURCE, path, t1_COLOR_RESET,
+           t1_COLOR_CHECK_EXPECTED, t1_COLOR_RESET, t1_COLOR_CHECK_ACTUAL, t1_COLOR_RESET);
+
+    bool binary = (expected_size > 0 && memchr(expected, '\0', expected_size) != nullptr)
+               || (size > 0 && memchr(actual, '\0', size) != nullptr);
+
+    if (binary)
+    {
+        u64 common = expected_size < size ? expected_size : size;
+        u64 offset = 0;
+
+        while (offset < common && expected[offset] == actual[offset])
+            offset++;
+
+        printf("  binary data differs at offset %#llx (expected %llu bytes, got %llu)\n",
+               (unsigned long long)offset, (unsigned long long)expected_size, (unsigned long long)size);
+    }
+    else
+        t1_print_diff(expected, expected_size, actual, size);
+
+    return false;
+}
+
+// passes if the file at PATH in VFS contains exactly the SIZE bytes at DATA
+#define assert_vfs_file(VFS, PATH, DATA, SIZE)\
+    {\
+        if (!t1_assert_vfs_file_(t1_assert_info{t1_get_filename(__FILE__), __LINE__, #VFS ", " #PATH, #DATA ", " #SIZE}, VFS, PATH, DATA, SIZE) && t1_tests::stop_on_fail)\
+            return;\
+    }
+
+// ----- the shadowed functions -----
+#define _t1_VFS_CALL(VFS, EXPR) \
+    _t1_spin_lock(&(VFS)->lock);\
+    auto _t1_vfs_ret = EXPR;\
+    _t1_spin_unlock(&(VFS)->lock);\
+    return _t1_vfs_ret
+
+// whether open gets a mode argument. O_TMPFILE includes O_DIRECTORY, which
+// doesn't take one on its own.
+static inline bool _t1_open_has_mode(int flags)
+{
+    return (flags & O_CREAT) || (flags & O_TMPFILE) == O_TMPFILE;
+}
+
+extern "C" int openat(int dirfd, const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    if (_t1_open_has_mode(flags))
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+
+    _t1_INJECT_FAULT(t1_sys_open, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(dirfd, path))
+    {
+        _t1_VFS_CALL(vfs, _t1_vfs_open(vfs, dirfd, path, flags, mode));
+    }
+
+    return (int)_t1_sys(SYS_openat, dirfd, path, flags, mode);
+}
+
+extern "C" int open(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    if (_t1_open_has_mode(flags))
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+
+    return openat(AT_FDCWD, path, flags, mode);
+}
+
+extern "C" int close(int fd)
+{
+    _t1_INJECT_FAULT(t1_sys_close, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_VFS_CALL(vfs, _t1_vfs_close(vfs, fd));
+    }
+
+    return (int)_t1_sys(SYS_close, fd);
+}
+
+extern "C" ssize_t read(int fd, void *buf, size_t size)
+{
+    _t1_INJECT_FAULT(t1_sys_read, &size, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_VFS_CALL(vfs, (ssize_t)_t1_vfs_read(vfs, fd, buf, size, -1));
+    }
+
+    return (ssize_t)_t1_sys(SYS_read, fd, buf, size);
+}
+
+extern "C" ssize_t write(int fd, const void *buf, size_t size)
+{
+    _t1_INJECT_FAULT(t1_sys_write, &size, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_VFS_CALL(vfs, (ssize_t)_t1_vfs_write(vfs, fd, buf, size, -1));
+    }
+
+    return (ssize_t)_t1_sys(SYS_write, fd, buf, size);
+}
+
+extern "C" ssize_t pread64(int fd, void *buf, size_t size, off64_t offset)
+{
+    if (offset < 0)
+        return _t1_vfs_fail(EINVAL);
+
+    _t1_INJECT_FAULT(t1_sys_pread, &size, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_VFS_CALL(vfs, (ssize_t)_t1_vfs_read(vfs, fd, buf, size, offset));
+    }
+
+    return (ssize_t)_t1_sys(SYS_pread64, fd, buf, size, offset);
+}
+
+extern "C" ssize_t pwrite64(int fd, const void *buf, size_t size, off64_t offset)
+{
+    if (offset < 0)
+        return _t1_vfs_fail(EINVAL);
+
+    _t1_INJECT_FAULT(t1_sys_pwrite, &size, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_VFS_CALL(vfs, (ssize_t)_t1_vfs_write(vfs, fd, buf, size, offset));
+    }
+
+    return (ssize_t)_t1_sys(SYS_pwrite64, fd, buf, size, offset);
+}
+
+extern "C" off_t lseek(int fd, off_t offset, int whence) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_lseek, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_VFS_CALL(vfs, (off_t)_t1_vfs_lseek(vfs, fd, offset, whence));
+    }
+
+    return (off_t)_t1_sys(SYS_lseek, fd, offset, whence);
+}
+
+extern "C" int mkdirat(int dirfd, const char *path, mode_t mode) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_mkdir, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(dirfd, path))
+    {
+        _t1_VFS_CALL(vfs, _t1_vfs_mkdir(vfs, dirfd, path));
+    }
+
+    return (int)_t1_sys(SYS_mkdirat, dirfd, path, mode);
+}
+
+extern "C" int mkdir(const char *path, mode_t mode) _t1_THROW
+{
+    return mkdirat(AT_FDCWD, path, mode);
+}
+
+extern "C" int renameat2(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, unsigned int flags) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_rename, nullptr, -1);
+
+    t1_vfs *old_vfs = _t1_vfs_for(old_dirfd, old_path);
+    t1_vfs *new_vfs = _t1_vfs_for(new_dirfd, new_path);
+
+    if (old_vfs != new_vfs)
+        return _t1_vfs_fail(EXDEV);
+
+    if (old_vfs != nullptr)
+    {
+        _t1_VFS_CALL(old_vfs, _t1_vfs_rename(old_vfs, old_dirfd, old_path, new_dirfd, new_path, flags));
+    }
+
+    return (int)_t1_sys(SYS_renameat2, old_dirfd, old_path, new_dirfd, new_path, flags);
+}
+
+extern "C" int renameat(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path) _t1_THROW
+{
+    return renameat2(old_dirfd, old_path, new_dirfd, new_path, 0);
+}
+
+extern "C" int rename(const char *old_path, const char *new_path) _t1_THROW
+{
+    return renameat2(AT_FDCWD, old_path, AT_FDCWD, new_path, 0);
+}
+
+extern "C" int access(const char *path, int mode) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_access, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(AT_FDCWD, path))
+    {
+        int err = 0;
+        _t1_spin_lock(&vfs->lock);
+        bool found = _t1_vfs_lookup(vfs, vfs->cwd, path, true, &err) != nullptr;
+        _t1_spin_unlock(&vfs->lock);
+
+        return found ? 0 : _t1_vfs_fail(err);
+    }
+
+    return (int)_t1_sys(SYS_faccessat, AT_FDCWD, path, mode);
+}
+
+extern "C" int fchownat(int dirfd, const char *path, uid_t owner, gid_t group, int flags) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_chown, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(dirfd, path))
+    {
+        int err = 0;
+        _t1_spin_lock(&vfs->lock);
+
+        t1_vfs_node *start = _t1_vfs_start(vfs, dirfd, &err);
+        t1_vfs_node *n = start != nullptr ? _t1_vfs_lookup(vfs, start, path, !(flags & AT_SYMLINK_NOFOLLOW), &err) : nullptr;
+
+        if (n != nullptr)
+        {
+            if (owner != (uid_t)-1)
+                n->uid = owner;
+
+            if (group != (gid_t)-1)
+                n->gid = group;
+        }
+
+        _t1_spin_unlock(&vfs->lock);
+
+        return n != nullptr ? 0 : _t1_vfs_fail(err);
+    }
+
+    return (int)_t1_sys(SYS_fchownat, dirfd, path, owner, group, flags);
+}
+
+extern "C" int chown(const char *path, uid_t owner, gid_t group) _t1_THROW
+{
+    return fchownat(AT_FDCWD, path, owner, group, 0);
+}
+
+extern "C" int fchown(int fd, uid_t owner, gid_t group) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_chown, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_spin_lock(&vfs->lock);
+        t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, fd);
+
+        if (d != nullptr && owner != (uid_t)-1)
+            d->node->uid = owner;
+
+        if (d != nullptr && group != (gid_t)-1)
+            d->node->gid = group;
+
+        _t1_spin_unlock(&vfs->lock);
+
+        return d != nullptr ? 0 : _t1_vfs_fail(EBADF);
+    }
+
+    return (int)_t1_sys(SYS_fchown, fd, owner, group);
+}
+
+extern "C" int chdir(const char *path) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_chdir, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(AT_FDCWD, path))
+    {
+        int err = 0;
+        _t1_spin_lock(&vfs->lock);
+
+        t1_vfs_node *n = _t1_vfs_lookup(vfs, vfs->cwd, path, true, &err);
+
+        if (n != nullptr && n->type != t1_vfs_directory)
+        {
+            n = nullptr;
+            err = ENOTDIR;
+        }
+
+        if (n != nullptr)
+            _t1_vfs_set_cwd(vfs, n);
+
+        _t1_spin_unlock(&vfs->lock);
+
+        return n != nullptr ? 0 : _t1_vfs_fail(err);
+    }
+
+    return (int)_t1_sys(SYS_chdir, path);
+}
+
+extern "C" int fchdir(int fd) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_chdir, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_spin_lock(&vfs->lock);
+
+        t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, fd);
+        int err = d == nullptr ? EBADF : d->node->type != t1_vfs_directory ? ENOTDIR : 0;
+
+        if (err == 0)
+            _t1_vfs_set_cwd(vfs, d->node);
+
+        _t1_spin_unlock(&vfs->lock);
+
+        return err == 0 ? 0 : _t1_vfs_fail(err);
+    }
+
+    return (int)_t1_sys(SYS_fchdir, fd);
+}
+
+extern "C" char *getcwd(char *buf, size_t size) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_getcwd, nullptr, nullptr);
+
+    char path[4096];
+    char *p = nullptr;
+
+    if (t1_vfs *vfs = _t1_current_vfs)
+    {
+        _t1_spin_lock(&vfs->lock);
+        p = _t1_vfs_path_of(vfs->cwd, path, path + sizeof(path));
+        _t1_spin_unlock(&vfs->lock);
+
+        if (p == nullptr)
+        {
+            errno = ENAMETOOLONG;
+            return nullptr;
+        }
+    }
+    else
+    {
+        if (_t1_sys(SYS_getcwd, path, sizeof(path)) < 0)
+            return nullptr;
+
+        p = path;
+    }
+
+    u64 len = strlen(p) + 1;
+
+    // glibc extension: allocate if buf is nullptr
+    if (buf == nullptr)
+    {
+        if (size != 0 && size < len)
+        {
+            errno = ERANGE;
+            return nullptr;
+        }
+
+        buf = (char*)::malloc(size != 0 ? size : len);
+
+        if (buf == nullptr)
+            return nullptr;
+    }
+    else if (size < len)
+    {
+        errno = size == 0 ? EINVAL : ERANGE;
+        return nullptr;
+    }
+
+    ::memcpy(buf, p, len);
+    return buf;
+}
+
+extern "C" int linkat(int old_dirfd, const char *old_path, int new_dirfd, const char *new_path, int flags) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_link, nullptr, -1);
+
+    t1_vfs *old_vfs = _t1_vfs_for(old_dirfd, old_path);
+    t1_vfs *new_vfs = _t1_vfs_for(new_dirfd, new_path);
+
+    if (old_vfs != new_vfs)
+        return _t1_vfs_fail(EXDEV);
+
+    if (old_vfs != nullptr)
+    {
+        _t1_VFS_CALL(old_vfs, _t1_vfs_link(old_vfs, old_dirfd, old_path, new_dirfd, new_path, (flags & AT_SYMLINK_FOLLOW) != 0));
+    }
+
+    return (int)_t1_sys(SYS_linkat, old_dirfd, old_path, new_dirfd, new_path, flags);
+}
+
+extern "C" int link(const char *old_path, const char *new_path) _t1_THROW
+{
+    return linkat(AT_FDCWD, old_path, AT_FDCWD, new_path, 0);
+}
+
+extern "C" int symlinkat(const char *target, int new_dirfd, const char *link_path) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_symlink, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(new_dirfd, link_path))
+    {
+        _t1_VFS_CALL(vfs, _t1_vfs_symlink(vfs, target, new_dirfd, link_path));
+    }
+
+    return (int)_t1_sys(SYS_symlinkat, target, new_dirfd, link_path);
+}
+
+extern "C" int symlink(const char *target, const char *link_path) _t1_THROW
+{
+    return symlinkat(target, AT_FDCWD, link_path);
+}
+
+extern "C" ssize_t readlinkat(int dirfd, const char *path, char *buf, size_t size) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_readlink, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(dirfd, path))
+    {
+        _t1_VFS_CALL(vfs, (ssize_t)_t1_vfs_readlink(vfs, dirfd, path, buf, size));
+    }
+
+    return (ssize_t)_t1_sys(SYS_readlinkat, dirfd, path, buf, size);
+}
+
+extern "C" ssize_t readlink(const char *path, char *buf, size_t size) _t1_THROW
+{
+    return readlinkat(AT_FDCWD, path, buf, size);
+}
+
+extern "C" int unlinkat(int dirfd, const char *path, int flags) _t1_THROW
+{
+    _t1_INJECT_FAULT((flags & AT_REMOVEDIR) ? t1_sys_rmdir : t1_sys_unlink, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(dirfd, path))
+    {
+        _t1_VFS_CALL(vfs, _t1_vfs_unlink(vfs, dirfd, path, (flags & AT_REMOVEDIR) != 0));
+    }
+
+    return (int)_t1_sys(SYS_unlinkat, dirfd, path, flags);
+}
+
+extern "C" int unlink(const char *path) _t1_THROW
+{
+    return unlinkat(AT_FDCWD, path, 0);
+}
+
+extern "C" int rmdir(const char *path) _t1_THROW
+{
+    return unlinkat(AT_FDCWD, path, AT_REMOVEDIR);
+}
+
+extern "C" int chroot(const char *path) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_chroot, nullptr, -1);
+
+    if (_t1_current_vfs != nullptr)
+        return _t1_vfs_fail(EPERM);
+
+    return (int)_t1_sys(SYS_chroot, path);
+}
+
+static int _t1_vfs_sync(int fd)
+{
+    t1_vfs *vfs = _t1_vfs_for_fd(fd);
+    _t1_spin_lock(&vfs->lock);
+
+    bool valid = _t1_vfs_get_descriptor(vfs, fd) != nullptr;
+
+    if (valid)
+        vfs->stats.fsyncs++;
+
+    _t1_spin_unlock(&vfs->lock);
+
+    return valid ? 0 : _t1_vfs_fail(EBADF);
+}
+
+extern "C" int fsync(int fd)
+{
+    _t1_INJECT_FAULT(t1_sys_fsync, nullptr, -1);
+
+    if (_t1_vfs_for_fd(fd) != nullptr)
+        return _t1_vfs_sync(fd);
+
+    return (int)_t1_sys(SYS_fsync, fd);
+}
+
+extern "C" int fdatasync(int fd)
+{
+    _t1_INJECT_FAULT(t1_sys_fsync, nullptr, -1);
+
+    if (_t1_vfs_for_fd(fd) != nullptr)
+        return _t1_vfs_sync(fd);
+
+    return (int)_t1_sys(SYS_fdatasync, fd);
+}
+
+extern "C" void sync() _t1_THROW
+{
+    if (_t1_current_vfs == nullptr)
+        _t1_sys(SYS_sync);
+}
+
+static int _t1_vfs_truncate(t1_vfs_node *n, off_t length)
+{
+    if (length < 0)
+        return _t1_vfs_fail(EINVAL);
+
+    if (n->type == t1_vfs_directory)
+        return _t1_vfs_fail(EISDIR);
+
+    _t1_vfs_resize(n, (u64)length);
+    return 0;
+}
+
+extern "C" int truncate(const char *path, off_t length) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_truncate, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for(AT_FDCWD, path))
+    {
+        int err = 0;
+        _t1_spin_lock(&vfs->lock);
+
+        t1_vfs_node *n = _t1_vfs_lookup(vfs, vfs->cwd, path, true, &err);
+        int ret = n != nullptr ? _t1_vfs_truncate(n, length) : _t1_vfs_fail(err);
+
+        _t1_spin_unlock(&vfs->lock);
+
+        return ret;
+    }
+
+    return (int)_t1_sys(SYS_truncate, path, length);
+}
+
+extern "C" int ftruncate(int fd, off_t length) _t1_THROW
+{
+    _t1_INJECT_FAULT(t1_sys_truncate, nullptr, -1);
+
+    if (t1_vfs *vfs = _t1_vfs_for_fd(fd))
+    {
+        _t1_spin_lock(&vfs->lock);
+
+        t1_vfs_descriptor *d = _t1_vfs_get_descriptor(vfs, fd);
+        int ret = d == nullptr ? _t1_vfs_fail(EBADF)
+                : (d->flags & O_ACCMODE) == O_RDONLY ? _t1_vfs_fail(EINVAL)
+                : _t1_vfs_truncate(d->node, length);
+
+        _t1_spin_unlock(&vfs->lock);
+
+        return ret;
+    }
+
+    return (int)_t1_sys(SYS_ftruncate, fd, length);
+}
+#endif // t1_VFS
+
+// ---------- ASYNC TESTS ----------
+// define_async_test units are C++20 coroutines which may co_await
+//
+//     t1_wait_readable(fd, timeout_ms) / t1_wait_writable(fd, timeout_ms)
+//         -> true if fd is ready, false on timeout (-1 = no timeout)
+//     t1_sleep(ms)
+//     other coroutines returning t1_async_task
+//
+// all selected async units run concurrently on a single epoll loop after the
+// regular units. inside coroutines, use the co_assert_* forms of the asserts
+// (they co_return instead of return with --break).
+#if t1_ASYNC
+struct _t1_async_unit;
+
+struct t1_async_task
+{
+    struct promise_type
+    {
+        _t1_async_unit *unit; // only set for the top level coroutine of a unit
+        std::coroutine_handle<> continuation;
+
+        t1_async_task get_return_object()
+        {
+            return t1_async_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct final_awaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept;
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+
+        // no exceptions
+        void unhandled_exception() { ::abort(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+
+    t1_async_task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    t1_async_task(t1_async_task &&other) : handle(other.handle) { other.handle = nullptr; }
+    t1_async_task(const t1_async_task&) = delete;
+
+    ~t1_async_task()
+    {
+        // top level coroutines are destroyed by the loop
+        if (handle && handle.promise().unit == nullptr)
+            handle.destroy();
+    }
+
+    // awaiting a task starts it and resumes the awaiting coroutine when it's done
+    bool await_ready() { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    void await_resume() {}
+};
+
+struct t1_async_wait
+{
+    std::coroutine_handle<> handle;
+    _t1_async_unit *unit;
+    int fd;            // -1 for sleeps
+    int registered_fd; // fd or a dup of it, as registered with epoll
+    u32 events;
+    s64 deadline;      // nanoseconds, -1 = none
+    bool ready;
+};
+
+struct _t1_async_unit
+{
+    t1_unit *unit;
+    std::coroutine_handle<t1_async_task::promise_type> handle;
+    t1_async_wait *pending; // what the unit is currently waiting for
+    timespec start_time;
+    double seconds;
+    bool failed;
+    bool done;
+};
+
+struct _t1_async_loop
+{
+    int epoll_fd;
+    t1_array<t1_async_wait*> waits;
+    _t1_async_unit *current; // unit being resumed
+    u64 running;
+};
+
+static _t1_async_loop *_t1_get_async_loop()
+{
+    static _t1_async_loop _loop{-1, {}, nullptr, 0};
+    return &_loop;
+}
+
+static s64 _t1_async_now()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (s64)t.tv_sec * t1_NANOSECONDS_IN_A_SECOND + t.tv_nsec;
+}
+
+// resumes a coroutine of unit, attributing asserts to it
+static void _t1_async_resume(_t1_async_unit *u, std::coroutine_handle<> h)
+{
+    _t1_async_loop *loop = _t1_get_async_loop();
+
+    loop->current = u;
+    t1_tests::current_unit = u->unit;
+    t1_tests::current_unit_failed = u->failed;
+
+    h.resume();
+
+    u->failed = t1_tests::current_unit_failed;
+    loop->current = nullptr;
+}
+
+static void _t1_async_finish(_t1_async_unit *u)
+{
+    timespec end_time;
+    t1_get_time(&end_time);
+
+    u->seconds = t1_get_seconds_difference(&u->start_time, &end_time);
+    u->done = true;
+    _t1_get_async_loop()->running--;
+}
+
+inline std::coroutine_handle<> t1_async_task::promise_type::final_awaiter::await_suspend(std::coroutine_handle<promise_type> h) noexcept
+{
+    promise_type &p = h.promise();
+
+    if (p.continuation)
+        return p.continuation;
+
+    if (p.unit != nullptr)
+        _t1_async_finish(p.unit);
+
+    return std::noop_coroutine();
+}
+
+static void _t1_async_remove_wait(t1_async_wait *w)
+{
+    _t1_async_loop *loop = _t1_get_async_loop();
+
+    for (u64 i = 0; i < loop->waits.size; ++i)
+    if (loop->waits[i] == w)
+    {
+        loop->waits[i] = loop->waits[loop->waits.size - 1];
+        loop->waits.size--;
+        break;
+    }
+
+    if (w->registered_fd != -1)
+    {
+        ::epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, w->registered_fd, nullptr);
+
+        if (w->registered_fd != w->fd)
+            ::close(w->registered_fd);
+
+        w->registered_fd = -1;
+    }
+
+    if (w->unit != nullptr)
+        w->unit->pending = nullptr;
+}
+
+struct t1_async_wait_awaiter
+{
+    t1_async_wait wait;
+
+    bool await_ready() { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        _t1_async_loop *loop = _t1_get_async_loop();
+
+        wait.handle = h;
+        wait.unit = loop->current;
+        wait.registered_fd = -1;
+        wait.ready = false;
+
+        if (wait.fd != -1)
+        {
+            epoll_event ev{};
+            ev.events = wait.events;
+            ev.data.ptr = &wait;
+
+            int fd = wait.fd;
+
+            // another unit might already wait for the same fd
+            if (::epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+            {
+                fd = ::dup(wait.fd);
+
+                if (fd == -1 || ::epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+                {
+                    if (fd != -1)
+                        ::close(fd);
+
+                    // report as ready, the following I/O call will fail
+                    wait.ready = true;
+                    return false;
+                }
+            }
+
+            wait.registered_fd = fd;
+        }
+
+        if (wait.unit != nullptr)
+            wait.unit->pending = &wait;
+
+        t1_add_at_end(&loop->waits, &wait);
+        return true;
+    }
+
+    bool await_resume() { return wait.ready; }
+};
+
+static s64 _t1_async_deadline(s64 timeout_ms)
+{
+    if (timeout_ms < 0)
+        return -1;
+
+    return _t1_async_now() + timeout_ms * 1000000;
+}
+
+[[maybe_unused]] static t1_async_wait_awaiter t1_wait_readable(int fd, s64 timeout_ms = -1)
+{
+    return t1_async_wait_awaiter{t1_async_wait{nullptr, nullptr, fd, -1, EPOLLIN | EPOLLRDHUP, _t1_async_deadline(timeout_ms), false}};
+}
+
+[[maybe_unused]] static t1_async_wait_awaiter t1_wait_writable(int fd, s64 timeout_ms = -1)
+{
+    return t1_async_wait_awaiter{t1_async_wait{nullptr, nullptr, fd, -1, EPOLLOUT, _t1_async_deadline(timeout_ms), false}};
+}
+
+[[maybe_unused]] static t1_async_wait_awaiter t1_sleep(s64 ms)
+{
+    return t1_async_wait_awaiter{t1_async_wait{nullptr, nullptr, -1, -1, 0, _t1_async_deadline(ms < 0 ? 0 : ms), false}};
+}
+
+static void _t1_async_report(_t1_async_unit *u)
+{
+    if (u->failed)
+    {
+        t1_tests::total_units_failed++;
+        return;
+    }
+
+    if (t1_tests::verbose)
+        printf("%s %s %s... %spasses%s (%.12fs)", t1_COLOR_TEST_NAME, u->unit->name, t1_COLOR_RESET,
+               t1_COLOR_PASSED, t1_COLOR_RESET, u->seconds);
+}
+
+// evaluates the death checks of the unit once it's done, like those of
+// synchronous units
+static void _t1_async_complete(_t1_async_unit *u)
+{
+    t1_tests::current_unit = u->unit;
+    t1_tests::current_unit_failed = u->failed;
+    t1_wait_deaths(u->unit);
+    u->failed = t1_tests::current_unit_failed;
+
+    if (u->done)
+        _t1_async_report(u);
+}
+
+static void t1_run_async_units()
+{
+    _t1_async_loop *loop = _t1_get_async_loop();
+
+    t1_array<_t1_async_unit> units;
+    init(&units);
+    defer { free(&units); };
+
+    for (u64 i = 0; i < t1_tests::units.size; ++i)
+    {
+        t1_unit *unit = t1_tests::units.data + i;
+
+        if (unit->async_func != nullptr && t1_tests::is_selected(unit))
+            t1_add_at_end(&units, _t1_async_unit{unit, nullptr, nullptr, {}, 0.0, false, false});
+    }
+
+    if (units.size == 0)
+        return;
+
+    if (loop->epoll_fd == -1)
+        loop->epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+
+    // units must not move while running
+    for (u64 i = 0; i < units.size; ++i)
+    {
+        _t1_async_unit *u = units.data + i;
+
+        t1_tests::total_units++;
+        loop->running++;
+
+        t1_get_time(&u->start_time);
+        t1_async_task task = u->unit->async_func();
+        u->handle = task.handle;
+        u->handle.promise().unit = u;
+
+        _t1_async_resume(u, u->handle);
+
+        if (u->done)
+            _t1_async_complete(u);
+    }
+
+    epoll_event events[64];
+
+    while (loop->running > 0)
+    {
+        s64 now = _t1_async_now();
+        s64 next_deadline = -1;
+
+        for (u64 i = 0; i < loop->waits.size; ++i)
+        {
+            s64 d = loop->waits[i]->deadline;
+
+            if (d != -1 && (next_deadline == -1 || d < next_deadline))
+                next_deadline = d;
+        }
+
+        if (loop->waits.size == 0)
+        {
+            // a unit awaited something that isn't driven by this loop
+            printf("%s%llu async unit(s) are suspended on something t1 cannot wait for%s\n",
+                   t1_COLOR_FAILED, (unsigned long long)loop->running, t1_COLOR_RESET);
+            break;
+        }
+
+        int timeout = -1;
+
+        if (next_deadline != -1)
+            timeout = next_deadline <= now ? 0 : (int)((next_deadline - now + 999999) / 1000000);
+
+        int n = ::epoll_wait(loop->epoll_fd, events, 64, timeout);
+
+        for (int i = 0; i < n; ++i)
+        {
+            t1_async_wait *w = (t1_async_wait*)events[i].data.ptr;
+            _t1_async_remove_wait(w);
+            w->ready = true;
+
+            _t1_async_unit *u = w->unit;
+            _t1_async_resume(u, w->handle);
+
+            if (u->done)
+                _t1_async_complete(u);
+        }
+
+        now = _t1_async_now();
+
+        for (u64 i = 0; i < loop->waits.size;)
+        {
+            t1_async_wait *w = loop->waits[i];
+
+            if (w->deadline == -1 || w->deadline > now)
+            {
+                ++i;
+                continue;
+            }
+
+            _t1_async_remove_wait(w);
+
+            // sleeps always succeed
+            w->ready = w->fd == -1;
+
+            _t1_async_unit *u = w->unit;
+            _t1_async_resume(u, w->handle);
+
+            if (u->done)
+                _t1_async_complete(u);
+
+            // waits may have changed, start over
+            i = 0;
+        }
+    }
+
+    for (u64 i = 0; i < units.size; ++i)
+    {
+        _t1_async_unit *u = units.data + i;
+
+        if (!u->done)
+        {
+            if (u->pending != nullptr)
+                _t1_async_remove_wait(u->pending);
+
+            _t1_async_complete(u);
+
+            t1_tests::total_units_failed++;
+        }
+
+        if (u->handle)
+            u->handle.destroy();
+
+        t1_tests::total_seconds += u->seconds;
+    }
+
+    loop->running = 0;
+    t1_tests::current_unit = nullptr;
+}
+
+#define define_async_test(NAME) \
+    static t1_async_task JOIN3(test_, NAME, _f)();\
+    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
+            t1_unit{#NAME, nullptr, t1_get_filename(__FILE__), __LINE__, JOIN3(test_, NAME, _f)}); } \
+    static t1_async_task JOIN3(test_, NAME, _f)()
+
+#define co_assert_equal(EXPR, EXPECTED) CO_ASSERT_GENERIC2(assert_equal_, EXPR, EXPECTED)
+#define co_assert_not_equal(EXPR, EXPECTED) CO_ASSERT_GENERIC2(assert_not_equal_, EXPR, EXPECTED)
+#define co_assert_greater(EXPR, EXPECTED) CO_ASSERT_GENERIC2(assert_greater_, EXPR, EXPECTED)
+#define co_assert_greater_or_equal(EXPR, EXPECTED) CO_ASSERT_GENERIC2(assert_greater_or_equal_, EXPR, EXPECTED)
+#define co_assert_less(EXPR, EXPECTED) CO_ASSERT_GENERIC2(assert_less_, EXPR, EXPECTED)
+#define co_assert_less_or_equal(EXPR, EXPECTED) CO_ASSERT_GENERIC2(assert_less_or_equal_, EXPR, EXPECTED)
+#else
+static void t1_run_async_units() {}
+#endif // t1_ASYNC
+
+static void t1_print_results(unsigned int failed, unsigned int total, const char *name)
+{
+    if (total == 0)
+    {
+        printf("%sno %s found%s\n", t1_COLOR_WARN, name, t1_COLOR_RESET);
+        return;
+    }
+
+    float pct = ((float)failed / (float)total) * 100;
+
+    printf("%s%u%s of %u (%s%.4f%%%s) %s failed\n",
+           (failed > 0 ? t1_COLOR_FAILED : t1_COLOR_PASSED),
+           failed, t1_COLOR_RESET, total,
+           (failed >= total ? t1_COLOR_FAILED : t1_COLOR_PASSED),
+           pct, t1_COLOR_RESET, name);
+}
+
+static int _t1_compare_repeat_results(const void *l, const void *r)
+{
+    const t1_repeat_result *a = (const t1_repeat_result*)l;
+    const t1_repeat_result *b = (const t1_repeat_result*)r;
+
+    // lower pass rate first, i.e. higher failure rate first
+    double fa = (double)a->iterations_failed / (double)(a->iterations > 0 ? a->iterations : 1);
+    double fb = (double)b->iterations_failed / (double)(b->iterations > 0 ? b->iterations : 1);
+
+    return (fa < fb) - (fa > fb);
+}
+
+// whether the unit both passed and failed while repeating. units that fail
+// every iteration are just failing.
+static bool t1_is_flaky(const t1_repeat_result *res)
+{
+    return res->iterations_failed > 0 && res->iterations_failed < res->iterations;
+}
+
+// prints units which passed and failed while repeating, least reliable first
+static void t1_print_flaky_units()
+{
+    t1_array<t1_repeat_result> *results = &t1_tests::repeat_results;
+
+    ::qsort(results->data, results->size, sizeof(t1_repeat_result), _t1_compare_repeat_results);
+
+    bool header_printed = false;
+
+    for (u64 i = 0; i < results->size; ++i)
+    {
+        t1_repeat_result *res = results->data + i;
+
+        if (!t1_is_flaky(res))
+            continue;
+
+        if (!header_printed)
+        {
+            printf("flaky units, least reliable first:\n");
+            header_printed = true;
+        }
+
+        printf("  %s%s%s: %s%llu%s of %llu iterations failed, first at iteration %llu (--seed %llu), median %.12fs\n",
+               t1_COLOR_TEST_NAME, res->unit->name, t1_COLOR_RESET,
+               t1_COLOR_FAILED, (unsigned long long)res->iterations_failed, t1_COLOR_RESET,
+               (unsigned long long)res->iterations,
+               (unsigned long long)res->first_failed_iteration,
+               (unsigned long long)res->first_failed_seed,
+               res->median_seconds);
+    }
+}
+
+static void t1_print_summary_of(const char *file)
+{
+    if ((t1_tests::verbose && t1_tests::last_passed) || t1_tests::repeat_results.size > 0)
+        printf("\n");
+
+    if (t1_tests::repeat_results.size > 0)
+        t1_print_flaky_units();
+
+    printf("summary of %s%s%s\n", t1_COLOR_SOURCE, file, t1_COLOR_RESET);
+
+    if (t1_tests::total_asserts > 0)
+        t1_print_results(t1_tests::total_asserts_failed, t1_tests::total_asserts, "asserts");
+
+    t1_print_results(t1_tests::total_units_failed, t1_tests::total_units, "units");
+    printf("total time: %.12fs\n", t1_tests::total_seconds);
+
+    if (t1_atomic_load(&t1_tests::unprintable_called))
+    {
+        printf("\n%sNOTE: One or more values could not be printed (%s<unprintable>%s), use\n"
+                "%sdefine_t1_to_string(YourType x, \"%%d\", x.field, ...)%s to enable printing values\n"
+                "of YourType. See %st1/tests/test5.cpp%s for an example.%s\n",
+                t1_COLOR_WARN,
+                t1_COLOR_FAILED, t1_COLOR_WARN,
+                t1_COLOR_SOURCE, t1_COLOR_WARN,
+                t1_COLOR_SOURCE, t1_COLOR_WARN,
+                t1_COLOR_RESET
+                );
+    }
+}
+
+// this is a macro because of __FILE__, duh
+#define t1_print_summary()\
+    t1_print_summary_of(__FILE__);
+
+static void t1_parse_arguments(int argc, const char *argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+
+        if (strcmp(arg, "-b") == 0 || strcmp(arg, "--break") == 0)
+            t1_tests::stop_on_fail = true;
+        else if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0)
+            t1_tests::verbose = true;
+        else if ((strcmp(arg, "-f") == 0 || strcmp(arg, "--filter") == 0) && i + 1 < argc)
+            t1_add_at_end(&t1_tests::filters, argv[++i]);
+        else if (strcmp(arg, "--repeat") == 0 && i + 1 < argc)
+            t1_tests::repeat_count = ::strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--until-fail") == 0)
+            t1_tests::until_fail = true;
+        else if ((strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0) && i + 1 < argc)
+            t1_tests::jobs = (u32)::strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--seed") == 0 && i + 1 < argc)
+            t1_tests::seed = ::strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--perf-counters") == 0)
+            t1_tests::perf_counters = true;
+        else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--capture") == 0)
+            t1_tests::capture_output = true;
+        else if (strcmp(arg, "--capture-limit") == 0 && i + 1 < argc)
+        {
+            t1_tests::capture_output = true;
+            t1_tests::capture_limit = ::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(arg, "--serve") == 0 && i + 1 < argc)
+            t1_tests::serve_path = argv[++i];
+        else if (strcmp(arg, "--connect") == 0 && i + 1 < argc)
+            t1_tests::connect_path = argv[++i];
+        else if (strcmp(arg, "--update-snapshots") == 0)
+            t1_tests::update_snapshots = true;
+        else if (strcmp(arg, "--async-output") == 0)
+            t1_tests::async_output = true;
+        else if (strcmp(arg, "--stress-jitter") == 0)
+            t1_tests::stress_jitter = true;
+        else if (strcmp(arg, "--profile") == 0)
+            t1_tests::profile_hz = t1_PROFILE_DEFAULT_HZ;
+        else if (strncmp(arg, "--profile=", 10) == 0)
+            t1_tests::profile_hz = (u32)::strtoul(arg + 10, nullptr, 10);
+        else if (strcmp(arg, "--journal") == 0 && i + 1 < argc)
+            t1_tests::journal_path = argv[++i];
+        else if (strcmp(arg, "--resume") == 0)
+            t1_tests::resume = true;
+        else if (strcmp(arg, "--list") == 0)
+            t1_tests::list_units = true;
+        else if (strcmp(arg, "--fuzz") == 0)
+        {
+            t1_tests::fuzz = true;
+            t1_tests::fuzz_seconds = t1_FUZZ_DEFAULT_SECONDS;
+        }
+        else if (strncmp(arg, "--fuzz=", 7) == 0)
+        {
+            t1_tests::fuzz = true;
+            t1_tests::fuzz_seconds = (u32)::strtoul(arg + 7, nullptr, 10);
+        }
+        else if (strcmp(arg, "--fuzz-runs") == 0 && i + 1 < argc)
+        {
+            t1_tests::fuzz = true;
+            t1_tests::fuzz_runs = ::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(arg, "--fuzz-workers") == 0 && i + 1 < argc)
+            t1_tests::fuzz_workers = (u32)::strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--fuzz-timeout") == 0 && i + 1 < argc)
+            t1_tests::fuzz_timeout = (u32)::strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--fuzz-minimize") == 0)
+            t1_tests::fuzz_minimize = true;
+        else if (strcmp(arg, "--coordinate") == 0 && i + 1 < argc)
+            t1_tests::coordinate_path = argv[++i];
+        else if (strcmp(arg, "--workers") == 0 && i + 1 < argc)
+            t1_tests::coordinate_workers = (s32)::strtol(argv[++i], nullptr, 10);
+        else if (strcmp(arg, "--worker") == 0 && i + 1 < argc)
+            t1_tests::worker_path = argv[++i];
+        else if (strcmp(arg, "--costs") == 0 && i + 1 < argc)
+            t1_tests::costs_path = argv[++i];
+        else if (strcmp(arg, "--record-impact") == 0)
+            t1_tests::record_impact = true;
+        else if (strcmp(arg, "--impact-index") == 0 && i + 1 < argc)
+            t1_tests::impact_index_path = argv[++i];
+        else if (strcmp(arg, "--changed") == 0 && i + 1 < argc)
+            t1_add_at_end(&t1_tests::changed, argv[++i]);
+        else if (strcmp(arg, "--changed-list") == 0 && i + 1 < argc)
+            t1_tests::changed_list_path = argv[++i];
+        else if (strcmp(arg, "--changed-binary") == 0)
+            t1_tests::changed_binary = true;
+    }
+}
+
+// reports options that can't work together or can't work at all, returns
+// false then
+static bool t1_check_arguments()
+{
+    // workers don't record, the coordinator doesn't run units
+    if (t1_tests::record_impact && (t1_tests::coordinate_path != nullptr || t1_tests::worker_path != nullptr))
+    {
+        printf("%s--record-impact can't be combined with --coordinate or --worker%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+        return false;
+    }
+
+    if (t1_tests::resume && t1_tests::units.size > 0 && !t1_journal_exists(t1_tests::get_journal_path()))
+    {
+        printf("%sthere is no journal to resume from at %s, runs only keep one with --journal%s\n",
+               t1_COLOR_FAILED, t1_tests::get_journal_path(), t1_COLOR_RESET);
+        return false;
+    }
+
+    return true;
+}
+
+// prints the selected units as "<name>\t<file>\t<line>" lines, nothing else.
+// used by t1_discover_tests in t1Config.cmake to register every unit as its
+// own CTest test.
+static void t1_list_units()
+{
+    for (u64 i = 0; i < t1_tests::units.size; ++i)
+    {
+        t1_unit *unit = t1_tests::units.data + i;
+
+        if (t1_tests::is_selected(unit))
+            printf("%s\t%s\t%u\n", unit->name, unit->file, unit->line);
+    }
+}
+
+// ---------- SERVE ----------
+// --serve <path> keeps the test executable (and whatever BEFORE_TESTS set
+// up) alive and runs the units on request. a request is a single line of
+// arguments, e.g. "-v -f parser_*\n", sent over the unix domain socket at
+// <path>. the output is streamed back in frames of a u32 length and that
+// many bytes, so it may contain any byte, then a frame of length 0 and a
+// byte with the exit status of the run. the request "quit" stops the server.
+// --connect <path> [args...] sends args to a server and prints the results.
+#define t1_SERVE_MAX_REQUEST_SIZE 4096
+#define t1_SERVE_MAX_REQUEST_ARGS 256
+
+struct _t1_saved_options
+{
+    bool stop_on_fail;
+    bool verbose;
+    u64 repeat_count;
+    bool until_fail;
+    u32 jobs;
+    u64 seed;
+    bool perf_counters;
+    bool capture_output;
+    u64 capture_limit;
+    bool update_snapshots;
+    bool stress_jitter;
+    u32 profile_hz;
+    const char *journal_path;
+    bool resume;
+    const char *serve_path;
+    const char *connect_path;
+    u64 filter_count;
+    bool record_impact;
+    const char *impact_index_path;
+    u64 changed_count;
+    const char *changed_list_path;
+    bool changed_binary;
+};
+
+static void _t1_save_options(_t1_saved_options *o)
+{
+    o->stop_on_fail = t1_tests::stop_on_fail;
+    o->verbose = t1_tests::verbose;
+    o->repeat_count = t1_tests::repeat_count;
+    o->until_fail = t1_tests::until_fail;
+    o->jobs = t1_tests::jobs;
+    o->seed = t1_tests::seed;
+    o->perf_counters = t1_tests::perf_counters;
+    o->capture_output = t1_tests::capture_output;
+    o->capture_limit = t1_tests::capture_limit;
+    o->update_snapshots = t1_tests::update_snapshots;
+    o->stress_jitter = t1_tests::stress_jitter;
+    o->profile_hz = t1_tests::profile_hz;
+    o->journal_path = t1_tests::journal_path;
+    o->resume = t1_tests::resume;
+    o->serve_path = t1_tests::serve_path;
+    o->connect_path = t1_tests::connect_path;
+    o->filter_count = t1_tests::filters.size;
+    o->record_impact = t1_tests::record_impact;
+    o->impact_index_path = t1_tests::impact_index_path;
+    o->changed_count = t1_tests::changed.size;
+    o->changed_list_path = t1_tests::changed_list_path;
+    o->changed_binary = t1_tests::changed_binary;
+}
+
+static void _t1_restore_options(const _t1_saved_options *o)
+{
+    t1_tests::stop_on_fail = o->stop_on_fail;
+    t1_tests::verbose = o->verbose;
+    t1_tests::repeat_count = o->repeat_count;
+    t1_tests::until_fail = o->until_fail;
+    t1_tests::jobs = o->jobs;
+    t1_tests::seed = o->seed;
+    t1_tests::perf_counters = o->perf_counters;
+    t1_tests::capture_output = o->capture_output;
+    t1_tests::capture_limit = o->capture_limit;
+    t1_tests::update_snapshots = o->update_snapshots;
+    t1_tests::stress_jitter = o->stress_jitter;
+    t1_tests::profile_hz = o->profile_hz;
+    t1_tests::journal_path = o->journal_path;
+    t1_tests::resume = o->resume;
+    t1_tests::serve_path = o->serve_path;
+    t1_tests::connect_path = o->connect_path;
+    t1_tests::filters.size = o->filter_count;
+    t1_tests::record_impact = o->record_impact;
+    t1_tests::impact_index_path = o->impact_index_path;
+    t1_tests::changed.size = o->changed_count;
+    t1_tests::changed_list_path = o->changed_list_path;
+    t1_tests::changed_binary = o->changed_binary;
+}
+
+// resets the results of a previous run
+static void t1_reset_results()
+{
+    t1_tests::last_passed = false;
+    t1_atomic_store(&t1_tests::unprintable_called, false);
+    t1_tests::total_units_failed = 0;
+    t1_tests::total_units = 0;
+    t1_tests::total_asserts_failed = 0;
+    t1_tests::total_asserts = 0;
+    t1_tests::total_seconds = 0.0;
+    t1_tests::repeat_results.size = 0;
+}
+
+#if t1_Linux || t1_Mac
+static bool _t1_write_all(int fd, const char *data, u64 size)
+{
+    while (size > 0)
+    {
+        s64 n = t1_io_write(fd, (void*)data, size);
+
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            return false;
+
+        data += n;
+        size -= (u64)n;
+    }
+
+    return true;
+}
+
+// returns false at the end of the stream
+static bool _t1_read_exact(int fd, void *data, u64 size)
+{
+    char *c = (char*)data;
+
+    while (size > 0)
+    {
+        s64 n = ::read(fd, c, size);
+
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            return false;
+
+        c += n;
+        size -= (u64)n;
+    }
+
+    return true;
+}
+
+static bool _t1_make_socket_address(const char *path, sockaddr_un *addr)
+{
+    ::memset(addr, 0, sizeof(sockaddr_un));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        printf("%ssocket path too long: %s%s\n", t1_COLOR_FAILED, path, t1_COLOR_RESET);
+        return false;
+    }
+
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+// splits the request in place
+static int _t1_split_request(char *request, const char **args, int max_args)
+{
+    // args[0] is the program name, like argv
+    int argc = 1;
+    args[0] = "t1";
+
+    char *c = request;
+
+    while (*c != '\0' && argc < max_args)
+    {
+        while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+            *c++ = '\0';
+
+        if (*c == '\0')
+            break;
+
+        args[argc++] = c;
+
+        while (*c != '\0' && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')
+            c++;
+    }
+
+    return argc;
+}
+
+struct _t1_serve_relay
+{
+    t1_thread thread;
+    int pipe_fd; // read end of what the run writes
+    int client;
+};
+
+// sends the output of the run to the client in frames
+static void _t1_serve_relay_output(void *arg)
+{
+    _t1_serve_relay *relay = (_t1_serve_relay*)arg;
+    char frame[sizeof(u32) + 4096];
+    bool connected = true;
+
+    while (true)
+    {
+        s64 n = ::read(relay->pipe_fd, frame + sizeof(u32), sizeof(frame) - sizeof(u32));
+
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            break;
+
+        // keeps draining when the client is gone so the run doesn't block
+        u32 size = (u32)n;
+        ::memcpy(frame, &size, sizeof(size));
+        connected = connected && _t1_write_all(relay->client, frame, sizeof(u32) + size);
+    }
+}
+
+// returns false if the server should stop
+static bool _t1_serve_request(int client, const char *file)
+{
+    char request[t1_SERVE_MAX_REQUEST_SIZE];
+    u64 size = 0;
+
+    // read until newline or EOF
+    while (size < sizeof(request) - 1)
+    {
+        s64 n = ::read(client, request + size, sizeof(request) - 1 - size);
+
+        if (n <= 0)
+            break;
+
+        size += (u64)n;
+
+        if (memchr(request, '\n', size) != nullptr)
+            break;
+    }
+
+    request[size] = '\0';
+
+    if (char *newline = strchr(request, '\n'))
+        *newline = '\0';
+
+    if (strcmp(request, "quit") == 0)
+        return false;
+
+    const char *args[t1_SERVE_MAX_REQUEST_ARGS];
+    int argc = _t1_split_request(request, args, t1_SERVE_MAX_REQUEST_ARGS);
+
+    _t1_saved_options saved;
+    _t1_save_options(&saved);
+
+    t1_reset_results();
+    t1_parse_arguments(argc, args);
+
+    // stream everything the run writes to the client
+    _t1_serve_relay relay{};
+    int fds[2];
+    bool relayed = ::pipe(fds) == 0;
+
+    if (relayed)
+    {
+        relay.pipe_fd = fds[0];
+        relay.client = client;
+        relayed = t1_thread_start(&relay.thread, _t1_serve_relay_output, &relay);
+
+        if (!relayed)
+        {
+            ::close(fds[0]);
+            ::close(fds[1]);
+        }
+    }
+
+    int saved_stdout = -1;
+    int saved_stderr = -1;
+
+    if (relayed)
+    {
+        ::fflush(nullptr);
+        t1_reporter_flush();
+        saved_stdout = ::dup(STDOUT_FILENO);
+        saved_stderr = ::dup(STDERR_FILENO);
+        ::dup2(fds[1], STDOUT_FILENO);
+        ::dup2(fds[1], STDERR_FILENO);
+        ::close(fds[1]);
+
+        // the index may have been recorded again since the server started
+        t1_tests::impacted.size = 0;
+        t1_select_impacted_units();
+
+        t1_tests::run();
+        t1_print_summary_of(file);
+
+        // the relay ends with the last write end
+        ::fflush(nullptr);
+        t1_reporter_flush();
+        ::dup2(saved_stdout, STDOUT_FILENO);
+        ::dup2(saved_stderr, STDERR_FILENO);
+        ::close(saved_stdout);
+        ::close(saved_stderr);
+
+        t1_thread_join(&relay.thread);
+        ::close(fds[0]);
+    }
+    else
+        t1_tests::total_units_failed = 1;
+
+    char trailer[sizeof(u32) + 1] = {};
+    trailer[sizeof(u32)] = (char)(t1_tests::total_units_failed > 0 ? 1 : 0);
+    _t1_write_all(client, trailer, sizeof(trailer));
+
+    _t1_restore_options(&saved);
+
+    return true;
+}
+#endif
+
+// returns the exit code
+static int t1_serve(const char *path, const char *file)
+{
+#if t1_Linux || t1_Mac
+    sockaddr_un addr;
+
+    if (!_t1_make_socket_address(path, &addr))
+        return 1;
+
+    int server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (server == -1)
+        return 1;
+
+    defer { ::close(server); };
+
+    // listens under a temporary name first so clients can connect as soon
+    // as path exists. only accessible by the user.
+    sockaddr_un listen_addr;
+    const char *listen_path = t1_tprintf("%s.%d", path, (int)::getpid()).data;
+
+    if (!_t1_make_socket_address(listen_path, &listen_addr))
+        return 1;
+
+    ::unlink(listen_path);
+    mode_t old_mask = ::umask(0077);
+    int bound = ::bind(server, (sockaddr*)&listen_addr, sizeof(listen_addr));
+    ::umask(old_mask);
+
+    // replaces the stale socket of a previous server
+    if (bound == -1 || ::listen(server, 16) == -1 || ::rename(listen_path, path) == -1)
+    {
+        ::unlink(listen_path);
+        printf("%scould not listen on %s%s\n", t1_COLOR_FAILED, path, t1_COLOR_RESET);
+        return 1;
+    }
+
+    defer { ::unlink(path); };
+
+    // clients may disconnect while results are streamed
+    ::signal(SIGPIPE, SIG_IGN);
+
+    printf("serving %s%s%s on %s%s%s\n", t1_COLOR_SOURCE, file, t1_COLOR_RESET,
+           t1_COLOR_SOURCE, path, t1_COLOR_RESET);
+
+    bool running = true;
+
+    while (running)
+    {
+        int client = ::accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (client == -1)
+            continue;
+
+        running = _t1_serve_request(client, file);
+        ::close(client);
+    }
+
+    return 0;
+#else
+    (void)path;
+    (void)file;
+    printf("%s--serve is not supported on this platform%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+    return 1;
+#endif
+}
+
+// sends the arguments (except --connect <path>) to the server at path,
+// returns the exit status of the remote run.
+static int t1_connect(const char *path, int argc, const char *argv[])
+{
+#if t1_Linux || t1_Mac
+    sockaddr_un addr;
+
+    if (!_t1_make_socket_address(path, &addr))
+        return 1;
+
+    int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (sock == -1)
+        return 1;
+
+    defer { ::close(sock); };
+
+    if (::connect(sock, (sockaddr*)&addr, sizeof(addr)) == -1)
+    {
+        printf("%scould not connect to %s%s\n", t1_COLOR_FAILED, path, t1_COLOR_RESET);
+        return 1;
+    }
+
+    char request[t1_SERVE_MAX_REQUEST_SIZE];
+    u64 size = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--connect") == 0)
+        {
+            i++;
+            continue;
+        }
+
+        u64 len = strlen(argv[i]);
+
+        if (size + len + 2 > sizeof(request))
+            break;
+
+        ::memcpy(request + size, argv[i], len);
+        size += len;
+        request[size++] = ' ';
+    }
+
+    request[size++] = '\n';
+
+    if (t1_io_write(sock, request, size) != (s64)size)
+        return 1;
+
+    char buf[4096];
+    u32 frame_size = 0;
+
+    // frames of output until the empty one, then the exit status
+    while (_t1_read_exact(sock, &frame_size, sizeof(frame_size)))
+    {
+        if (frame_size == 0)
+        {
+            u8 status = 1;
+            return _t1_read_exact(sock, &status, 1) ? status : 1;
+        }
+
+        while (frame_size > 0)
+        {
+            u32 n = frame_size < sizeof(buf) ? frame_size : (u32)sizeof(buf);
+
+            if (!_t1_read_exact(sock, buf, n))
+                return 1;
+
+            t1_io_write(_stdout(), buf, n);
+            frame_size -= n;
+        }
+    }
+
+    // the server went away
+    return 1;
+#else
+    (void)path;
+    (void)argc;
+    (void)argv;
+    printf("%s--connect is not supported on this platform%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+    return 1;
+#endif
+}
+
+// ---------- COORDINATOR ----------
+// --coordinate <path> runs the units in worker processes that pull them one
+// at a time from this process over the unix domain socket at <path>, so a
+// slow unit only keeps its own worker busy. the units that took longest in
+// previous runs (recorded in <test file>.costs, or --costs <path>) are
+// handed out first, units without a recorded time before all others.
+// --workers <n> forks n local workers after BEFORE_TESTS (default one per
+// processor, 0 = none). more workers can join with
+//
+//     test --worker <path> [options]
+//
+// e.g. from another sandbox that shares the socket's filesystem. they need
+// the same executable and the options that affect running a unit (-v,
+// --seed, --repeat...). the coordinator prints the output of every unit as
+// it arrives and merges the results into one summary. a unit whose worker
+// dies counts as failed, local workers that die are replaced (up to once
+// per unit). when no local worker is left, the remaining units fail.
+//
+// the protocol is line based: a worker sends "hello <unit count>", the
+// coordinator answers "run <index>" or "done", the worker answers "run" with
+// "result <index> <units> <units failed> <asserts> <asserts failed>
+// <seconds> <unprintable> <output size>" and the output, and so on. the
+// index after the last unit stands for all async units.
+#ifndef t1_WORKER_CONNECT_SECONDS
+#define t1_WORKER_CONNECT_SECONDS 10
+#endif
+#define t1_COORDINATOR_MAX_LINE 256
+
+#if t1_Linux
+// reads a line without the newline, returns false at the end of the stream
+static bool _t1_read_line(int fd, char *line, u64 size)
+{
+    u64 n = 0;
+
+    while (n < size - 1)
+    {
+        char c;
+        s64 r = ::read(fd, &c, 1);
+
+        if (r == -1 && errno == EINTR)
+            continue;
+
+        if (r <= 0)
+            return false;
+
+        if (c == '\n')
+            break;
+
+        line[n++] = c;
+    }
+
+    line[n] = '\0';
+    return true;
+}
+
+// runs the unit at index, or the async units if index is the unit count,
+// with fresh results. the output is collected in output.
+static void _t1_worker_run(u64 index, t1_array<char> *output)
+{
+    t1_reset_results();
+    output->size = 0;
+
+    bool captured = t1_capture_begin();
+
+    if (index == t1_tests::units.size)
+        t1_run_async_units();
+    else
+    {
+        t1_unit *unit = t1_tests::units.data + index;
+        t1_tests::total_units++;
+
+        if (t1_tests::repeat_count > 0 || t1_tests::until_fail)
+            t1_tests::run_repeated(unit);
+        else
+            t1_tests::run_single(unit);
+    }
+
+    if (!captured)
+        return;
+
+    t1_capture_end(false, 0, nullptr);
+
+    t1_output_capture *cap = _t1_get_output_capture();
+    s64 size = (s64)::lseek(cap->fd, 0, SEEK_END);
+
+    if (size <= 0)
+        return;
+
+    char *dst = t1_add_elements(output, (u64)size);
+    s64 read_size = ::pread(cap->fd, dst, (u64)size, 0);
+    output->size = read_size > 0 ? (u64)read_size : 0;
+}
+#endif
+
+// --worker <path>: runs the units the coordinator at path hands out until
+// there are none left. returns the exit code.
+static int t1_work(const char *path)
+{
+#if t1_Linux
+    sockaddr_un addr;
+
+    if (!_t1_make_socket_address(path, &addr))
+        return 1;
+
+    // the coordinator may not be listening yet
+    int sock = -1;
+
+    for (u32 attempt = 0; sock == -1 && attempt <= t1_WORKER_CONNECT_SECONDS * 10; ++attempt)
+    {
+        if (attempt > 0)
+            ::usleep(100000);
+
+        sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        if (sock != -1 && ::connect(sock, (sockaddr*)&addr, sizeof(addr)) == -1)
+        {
+            ::close(sock);
+            sock = -1;
+        }
+    }
+
+    if (sock == -1)
+    {
+        printf("%scould not connect to %s%s\n", t1_COLOR_FAILED, path, t1_COLOR_RESET);
+        return 1;
+    }
+
+    defer { ::close(sock); };
+
+    // of the units this worker ran
+    defer
+    {
+        if (t1_tests::profile_hz > 0)
+            t1_profile_write();
+    };
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    // the coordinator prints the output and keeps track of the results
+    t1_tests::capture_output = false;
+    t1_tests::journal_path = nullptr;
+    t1_tests::resume = false;
+
+    char line[t1_COORDINATOR_MAX_LINE];
+    ::snprintf(line, sizeof(line), "hello %llu\n", (unsigned long long)t1_tests::units.size);
+
+    if (!_t1_write_all(sock, line, strlen(line)))
+        return 1;
+
+    t1_array<char> output;
+    init(&output);
+    defer { free(&output); };
+
+    while (_t1_read_line(sock, line, sizeof(line)))
+    {
+        if (strncmp(line, "run ", 4) != 0)
+            break;
+
+        u64 index = ::strtoull(line + 4, nullptr, 10);
+
+        if (index > t1_tests::units.size)
+            break;
+
+        _t1_worker_run(index, &output);
+
+        ::snprintf(line, sizeof(line), "result %llu %u %u %u %u %.17g %d %llu\n",
+                   (unsigned long long)index,
+                   t1_tests::total_units, t1_tests::total_units_failed,
+                   t1_tests::total_asserts, t1_tests::total_asserts_failed,
+                   t1_tests::total_seconds, (int)t1_atomic_load(&t1_tests::unprintable_called),
+                   (unsigned long long)output.size);
+
+        if (!_t1_write_all(sock, line, strlen(line)) || !_t1_write_all(sock, output.data, output.size))
+            return 1;
+    }
+
+    return 0;
+#else
+    (void)path;
+    printf("%s--worker is not supported on this platform%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+    return 1;
 #endif
+}
+
+#if t1_Linux
+struct _t1_coordinator_job
+{
+    u64 index; // of the unit, the unit count for the async units
+    double cost;
+};
+
+struct _t1_coordinator_client
+{
+    int fd;      // -1 once closed
+    s64 job;     // index of the running unit, -1 if idle
+    t1_array<char> input;
+};
+
+struct _t1_coordinator
+{
+    t1_array<_t1_coordinator_job> jobs;
+    u64 next_job;
+    u64 running;
+    double *costs; // per unit, -1 = unknown
+    t1_array<_t1_coordinator_client> clients;
+};
+
+// expensive jobs first, unknown costs (-1) before all others
+static int _t1_compare_jobs(const void *l, const void *r)
+{
+    double a = ((const _t1_coordinator_job*)l)->cost;
+    double b = ((const _t1_coordinator_job*)r)->cost;
+
+    if (a < 0)
+        a = 1e300;
+
+    if (b < 0)
+        b = 1e300;
+
+    return (a < b) - (a > b);
+}
+
+// reads the "<seconds>\t<unit name>" lines of previous runs into costs
+static void _t1_load_costs(const char *path, double *costs)
+{
+    for (u64 i = 0; i < t1_tests::units.size; ++i)
+        costs[i] = -1;
+
+    t1_mapped_file f{};
+
+    if (path == nullptr || !t1_map_file(path, &f))
+        return;
+
+    defer { t1_unmap_file(&f); };
+
+    const char *p = f.data;
+    const char *end = f.data + f.size;
+
+    while (p < end)
+    {
+        const char *eol = (const char*)memchr(p, '\n', (u64)(end - p));
+
+        if (eol == nullptr)
+            eol = end;
+
+        const char *tab = (const char*)memchr(p, '\t', (u64)(eol - p));
+
+        if (tab != nullptr)
+        {
+            double seconds = ::strtod(p, nullptr);
+            const char *name = tab + 1;
+            u64 len = (u64)(eol - name);
+
+            for (u64 i = 0; i < t1_tests::units.size; ++i)
+            {
+                const char *unit_name = t1_tests::units.data[i].name;
+
+                if (costs[i] < 0 && strncmp(unit_name, name, len) == 0 && unit_name[len] == '\0')
+                {
+                    costs[i] = seconds;
+                    break;
+                }
+            }
+        }
+
+        p = eol + 1;
+    }
+}
+
+static void _t1_save_costs(const char *path, const double *costs)
+{
+    t1_array<char> text;
+    init(&text);
+    defer { free(&text); };
+
+    for (u64 i = 0; i < t1_tests::units.size; ++i)
+    {
+        if (costs[i] < 0)
+            continue;
+
+        t1_string line = t1_tprintf("%.9f\t%s\n", costs[i], t1_tests::units.data[i].name);
+        ::memcpy(t1_add_elements(&text, line.size), line.data, line.size);
+    }
+
+    if (!t1_write_file_atomic(path, text.data != nullptr ? text.data : "", text.size))
+        printf("%scould not write %s%s\n", t1_COLOR_WARN, path, t1_COLOR_RESET);
+}
+
+static bool _t1_coordinator_send(_t1_coordinator_client *c, const char *line)
+{
+    return _t1_write_all(c->fd, line, strlen(line));
+}
+
+// hands the next job to the client, or tells it there is none left
+static void _t1_coordinator_assign(_t1_coordinator *co, _t1_coordinator_client *c)
+{
+    if (co->next_job < co->jobs.size)
+    {
+        u64 index = co->jobs[co->next_job].index;
+
+        if (_t1_coordinator_send(c, t1_tprintf("run %llu\n", (unsigned long long)index).data))
+        {
+            c->job = (s64)index;
+            co->next_job++;
+            co->running++;
+        }
+
+        return;
+    }
+
+    _t1_coordinator_send(c, "done\n");
+    ::close(c->fd);
+    c->fd = -1;
+}
 
+// counts the jobs no worker is left for as failed
+static void _t1_coordinator_fail_remaining(_t1_coordinator *co)
+{
+    for (; co->next_job < co->jobs.size; co->next_job++)
+    {
+        u64 index = co->jobs[co->next_job].index;
+
+        if (index == t1_tests::units.size)
+            printf("%sno worker is left to run the async units%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+        else
+        {
+            t1_unit *unit = t1_tests::units.data + index;
+
+            printf("[%s%s:%u%s %s%s%s] %sno worker is left to run this unit%s\n",
+                   t1_COLOR_SOURCE, unit->file, unit->line, t1_COLOR_RESET,
+                   t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+                   t1_COLOR_FAILED, t1_COLOR_RESET);
+        }
+
+        t1_tests::total_units++;
+        t1_tests::total_units_failed++;
+        t1_tests::last_passed = false;
+    }
+}
+
+static void _t1_coordinator_disconnect(_t1_coordinator *co, _t1_coordinator_client *c)
+{
+    if (c->job >= 0)
+    {
+        if ((u64)c->job == t1_tests::units.size)
+            printf("%sa worker died while running the async units%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+        else
+        {
+            t1_unit *unit = t1_tests::units.data + c->job;
+
+            printf("[%s%s:%u%s %s%s%s] %sthe worker died while running this unit%s\n",
+                   t1_COLOR_SOURCE, unit->file, unit->line, t1_COLOR_RESET,
+                   t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET,
+                   t1_COLOR_FAILED, t1_COLOR_RESET);
+        }
+
+        t1_tests::total_units++;
+        t1_tests::total_units_failed++;
+        t1_tests::last_passed = false;
+        co->running--;
+        c->job = -1;
+    }
+
+    if (c->fd != -1)
+        ::close(c->fd);
+
+    c->fd = -1;
+}
+
+// handles the complete messages in the input of the client
+static void _t1_coordinator_receive(_t1_coordinator *co, _t1_coordinator_client *c)
+{
+    while (c->fd != -1)
+    {
+        char *eol = (char*)memchr(c->input.data, '\n', c->input.size);
+
+        if (eol == nullptr)
+        {
+            if (c->input.size > t1_COORDINATOR_MAX_LINE)
+                _t1_coordinator_disconnect(co, c);
+
+            return;
+        }
+
+        *eol = '\0';
+        u64 consumed = (u64)(eol - c->input.data) + 1;
+        const char *line = c->input.data;
+
+        if (strncmp(line, "hello ", 6) == 0)
+        {
+            u64 unit_count = ::strtoull(line + 6, nullptr, 10);
+
+            if (unit_count != t1_tests::units.size)
+            {
+                printf("%sa worker with %llu units connected, expected %llu, is it the same executable?%s\n",
+                       t1_COLOR_WARN, (unsigned long long)unit_count,
+                       (unsigned long long)t1_tests::units.size, t1_COLOR_RESET);
+
+                _t1_coordinator_send(c, "done\n");
+                _t1_coordinator_disconnect(co, c);
+                return;
+            }
+
+            _t1_coordinator_assign(co, c);
+        }
+        else if (strncmp(line, "result ", 7) == 0)
+        {
+            char *p = (char*)line + 7;
+            u64 index = ::strtoull(p, &p, 10);
+            u32 units = (u32)::strtoul(p, &p, 10);
+            u32 units_failed = (u32)::strtoul(p, &p, 10);
+            u32 asserts = (u32)::strtoul(p, &p, 10);
+            u32 asserts_failed = (u32)::strtoul(p, &p, 10);
+            double seconds = ::strtod(p, &p);
+            bool unprintable = ::strtoul(p, &p, 10) != 0;
+            u64 output_size = ::strtoull(p, &p, 10);
+
+            if (c->job < 0 || index != (u64)c->job)
+            {
+                _t1_coordinator_disconnect(co, c);
+                return;
+            }
+
+            // wait for the whole output
+            if (c->input.size < consumed + output_size)
+            {
+                *eol = '\n';
+                return;
+            }
+
+            t1_output_write(c->input.data + consumed, output_size);
+            consumed += output_size;
+
+            t1_tests::total_units += units;
+            t1_tests::total_units_failed += units_failed;
+            t1_tests::total_asserts += asserts;
+            t1_tests::total_asserts_failed += asserts_failed;
+            t1_tests::total_seconds += seconds;
+            if (unprintable)
+                t1_atomic_store(&t1_tests::unprintable_called, true);
+            t1_tests::last_passed = units_failed == 0;
+
+            if (index < t1_tests::units.size)
+                co->costs[index] = co->costs[index] < 0 ? seconds : (co->costs[index] + seconds) / 2;
+
+            co->running--;
+            c->job = -1;
+
+            _t1_coordinator_assign(co, c);
+        }
+        else
+        {
+            _t1_coordinator_disconnect(co, c);
+            return;
+        }
+
+        ::memmove(c->input.data, c->input.data + consumed, c->input.size - consumed);
+        c->input.size -= consumed;
+    }
+}
+
+// forks a worker connecting to path
+static int _t1_start_local_worker(const char *path, int server)
+{
+    t1_reporter_flush();
+    ::fflush(nullptr);
+
+    int pid = ::fork();
+
+    if (pid == 0)
+    {
+        _t1_reset_forked_process();
+        ::close(server);
+
+        int ret = t1_work(path);
+
+        ::fflush(nullptr);
+        ::_exit(ret);
+    }
+
+    return pid;
+}
+#endif
 
-struct t1_assert_info
+#if !t1_Windows
+// a forked process running units apart from this one, see t1_run_in_child.
+struct t1_child
 {
-    const char *file;
-    int line;
-    const char *str1; // the actual expression string
-    const char *str2; // the expected value string, if any
+    int pid;
+    int results; // read end of the pipe the results come back through
+    int output;  // file the output of the child goes to, -1 = /dev/null
 };
 
-struct t1_unit
+// forks a child which runs only units (all units of the process if units is
+// nullptr) with fresh results and no filters, then calls function and exits
+// with what it returned. the results_size bytes at results are sent back to
+// the parent when function returns, so function can fill them in. the
+// output of the child is discarded unless keep_output is set.
+template<typename F>
+static bool t1_start_child(t1_child *child, const t1_unit *units, u64 unit_count, F function,
+                           void *results, u64 results_size, bool keep_output)
 {
-    using FuncPtr = void(*)();
-    const char *name;
-    FuncPtr func;
-    const char *file;
-    unsigned int line;
-};
+    *child = t1_child{-1, -1, -1};
 
-struct t1_tests
-{
-    static t1_array<t1_unit> units;
-    static bool stop_on_fail;
-    static bool last_passed;
-    static bool verbose;
-    static bool current_unit_failed;
-    static bool unprintable_called;
-    static unsigned int total_units_failed;
-    static unsigned int total_units;
-    static unsigned int total_asserts_failed;
-    static unsigned int total_asserts;
-    static double total_seconds;
-    static t1_unit *current_unit;
+    if (keep_output)
+    {
+        char path[] = "/tmp/t1child.XXXXXX";
+        child->output = ::mkstemp(path);
 
-    static int add(const t1_unit &u)
+        if (child->output == -1)
+            return false;
+
+        ::unlink(path);
+    }
+
+    int fds[2];
+
+    if (::pipe(fds) == -1)
     {
-        t1_add_at_end(&units, u);
-        return 0;
+        if (child->output != -1)
+            ::close(child->output);
+
+        return false;
     }
 
-    static void run()
+    t1_reporter_flush();
+    ::fflush(nullptr);
+
+    int pid = ::fork();
+
+    if (pid == 0)
     {
-        for (u64 i = 0; i < units.size; ++i)
+        _t1_reset_forked_process();
+        ::close(fds[0]);
+
+        int output = keep_output ? child->output : ::open("/dev/null", O_WRONLY);
+        ::dup2(output, STDOUT_FILENO);
+        ::dup2(output, STDERR_FILENO);
+
+        if (units != nullptr)
         {
-            t1_unit *unit = units.data + i;
+            t1_tests::units.size = 0;
 
-            total_units++;
-            current_unit_failed = false;
-            current_unit = unit;
+            for (u64 i = 0; i < unit_count; ++i)
+                t1_tests::add(units[i]);
+        }
 
-            if (t1_tests::verbose)
-                printf("%s %s %s...", t1_COLOR_TEST_NAME, unit->name, t1_COLOR_RESET);
+        t1_tests::filters.size = 0;
+        t1_reset_results();
 
-            timespec start_time;
-            timespec end_time;
+        int ret = function();
 
-            t1_get_time(&start_time);
-            unit->func();
-            t1_get_time(&end_time);
+        ::fflush(nullptr);
+        _t1_write_all(fds[1], (const char*)results, results_size);
+        ::_exit(ret);
+    }
 
-            last_passed = !current_unit_failed;
-            double diff_seconds = t1_get_seconds_difference(&start_time, &end_time);
+    ::close(fds[1]);
 
-            total_seconds += diff_seconds;
+    if (pid == -1)
+    {
+        ::close(fds[0]);
 
-            if (last_passed)
-            {
-                if (t1_tests::verbose)
-                    printf(" %spasses%s (%.12fs)", t1_COLOR_PASSED, t1_COLOR_RESET, diff_seconds);
-            }
-            else
-                total_units_failed++;
-        }
+        if (child->output != -1)
+            ::close(child->output);
+
+        child->output = -1;
+        return false;
     }
-};
 
-t1_array<t1_unit> t1_tests::units{};
-bool t1_tests::stop_on_fail = false;
-bool t1_tests::last_passed = false;
-bool t1_tests::verbose = false;
-bool t1_tests::current_unit_failed = false;
-bool t1_tests::unprintable_called = false;
-unsigned int t1_tests::total_units_failed = 0;
-unsigned int t1_tests::total_units = 0;
-unsigned int t1_tests::total_asserts_failed = 0;
-unsigned int t1_tests::total_asserts = 0;
-double t1_tests::total_seconds = 0.0;
-t1_unit* t1_tests::current_unit = 0;
+    child->pid = pid;
+    child->results = fds[0];
 
-void t1_set_unprintable_was_called()
-{
-    t1_tests::unprintable_called = true;
+    return true;
 }
 
-#define ASSERT_FAILED2(INFO, ASRT, VALUE, EXPECTED, DESC)\
-{\
-    printf("\n[%s%s:%d%s %s%s%s] %sassert failed:%s\n  " ASRT "(%s, %s)\n  %s%s%s " DESC " %s%s%s\n",\
-           t1_COLOR_SOURCE, INFO.file, info.line,\
-           t1_COLOR_RESET, t1_COLOR_TEST_NAME, t1_tests::current_unit->name,\
-           t1_COLOR_RESET,\
-           t1_COLOR_EXCEPTION, t1_COLOR_RESET,\
-           INFO.str1, INFO.str2,\
-           t1_COLOR_CHECK_ACTUAL, t1_to_string(VALUE).data, t1_COLOR_RESET,\
-           t1_COLOR_CHECK_EXPECTED, t1_to_string(EXPECTED).data,\
-           t1_COLOR_RESET);\
-\
-    t1_tests::current_unit_failed = true;\
+// waits for child to exit, copies its results to results if it sent all of
+// them and its output to output (if kept). returns the exit code of the
+// child, 128 + the signal if it was killed or -1 if it couldn't be started.
+static int t1_wait_child(t1_child *child, void *results, u64 results_size, t1_array<char> *output)
+{
+    if (child->pid == -1)
+        return -1;
+
+    t1_array<char> received;
+    init(&received);
+    defer { free(&received); };
+
+    char buf[4096];
+    s64 n;
+
+    // children of the child may keep the pipe open, so don't wait for eof
+    while (received.size < results_size
+        && (n = ::read(child->results, buf, sizeof(buf))) != 0)
+    {
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n == -1)
+            break;
+
+        ::memcpy(t1_add_elements(&received, (u64)n), buf, (u64)n);
+    }
+
+    ::close(child->results);
+
+    int status = -1;
+
+    while (::waitpid(child->pid, &status, 0) == -1 && errno == EINTR)
+        ;
+
+    if (results_size > 0 && received.size == results_size)
+        ::memcpy(results, received.data, results_size);
+
+    if (child->output != -1)
+    {
+        if (output != nullptr && ::lseek(child->output, 0, SEEK_SET) == 0)
+            while ((n = ::read(child->output, buf, sizeof(buf))) > 0)
+                ::memcpy(t1_add_elements(output, (u64)n), buf, (u64)n);
+
+        ::close(child->output);
+    }
+
+    *child = t1_child{-1, -1, -1};
+
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1;
 }
 
-#define define_test(NAME) \
-    static void JOIN3(test_, NAME, _f)();\
-    namespace { static const auto JOIN(test_, NAME) = t1_tests::add(\
-            t1_unit{#NAME, JOIN3(test_, NAME, _f), t1_get_filename(__FILE__), __LINE__}); } \
-    static void JOIN3(test_, NAME, _f)()
+// runs function in a child with units, see t1_start_child, and waits for
+// it. the output of the child is appended to output unless it is nullptr.
+//
+//    u32 failed = 0;
+//    t1_run_in_child(units, 2, [&] { t1_tests::run(); failed = t1_tests::total_units_failed; return 0; },
+//                    &failed, sizeof(failed));
+template<typename F>
+static int t1_run_in_child(const t1_unit *units, u64 unit_count, F function,
+                           void *results = nullptr, u64 results_size = 0, t1_array<char> *output = nullptr)
+{
+    t1_child child;
 
-#define DEFINE_ASSERT_OP2(NAME, OP, FAILDESC)\
-template<typename T1, typename T2>\
-bool JOIN(NAME, _)(const t1_assert_info &info, T1 &&val, T2 &&expected)\
-{\
-    t1_tests::total_asserts++;\
-\
-    if (val OP expected)\
-        return true;\
-\
-    t1_tests::total_asserts_failed++;\
-    ASSERT_FAILED2(info, #NAME, val, expected, FAILDESC);\
-    return false;\
+    if (!t1_start_child(&child, units, unit_count, function, results, results_size, output != nullptr))
+        return -1;
+
+    return t1_wait_child(&child, results, results_size, output);
 }
+#endif
 
-DEFINE_ASSERT_OP2(assert_equal, ==, "does not equal expected value");
-DEFINE_ASSERT_OP2(assert_not_equal, !=, "equals unexpected value");
-DEFINE_ASSERT_OP2(assert_greater, >, "is not greater than");
-DEFINE_ASSERT_OP2(assert_greater_or_equal, >=, "is not greater or equal to");
-DEFINE_ASSERT_OP2(assert_less, <, "is not less than");
-DEFINE_ASSERT_OP2(assert_less_or_equal, <=, "is not less or equal to");
+// runs the selected units in workers, see COORDINATOR. adds their results
+// to the totals, returns 1 if the coordinator could not start.
+static int t1_coordinate(const char *path)
+{
+#if t1_Linux
+    t1_array<t1_unit> *units = &t1_tests::units;
 
+    _t1_coordinator co{};
+    init(&co.jobs);
+    init(&co.clients);
+    co.costs = t1_reallocate_memory<double>(nullptr, units->size + 1);
 
-// used internally
-#define ASSERT_GENERIC2(ASRT, EXPR, EXPECTED) \
-    {\
-        if (! ASRT(t1_assert_info{t1_get_filename(__FILE__), __LINE__, #EXPR, #EXPECTED}, EXPR, EXPECTED) && t1_tests::stop_on_fail)\
-            return;\
+    defer
+    {
+        for (u64 i = 0; i < co.clients.size; ++i)
+        {
+            if (co.clients[i].fd != -1)
+                ::close(co.clients[i].fd);
+
+            free(&co.clients[i].input);
+        }
+
+        free(&co.clients);
+        free(&co.jobs);
+        t1_free_memory(co.costs);
+    };
+
+    const char *costs_path = t1_tests::costs_path;
+
+    if (costs_path == nullptr && units->size > 0)
+        costs_path = t1_tprintf("%s.costs", units->data[0].file).data;
+
+    _t1_load_costs(costs_path, co.costs);
+
+    bool async_units = false;
+
+    for (u64 i = 0; i < units->size; ++i)
+    {
+        if (!t1_tests::is_selected(units->data + i))
+            continue;
+
+        if (units->data[i].async_func != nullptr)
+            async_units = true;
+        else
+            t1_add_at_end(&co.jobs, _t1_coordinator_job{i, co.costs[i]});
     }
 
-#define assert_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_equal_, EXPR, EXPECTED)
-#define assert_not_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_not_equal_, EXPR, EXPECTED)
-#define assert_greater(EXPR, EXPECTED) ASSERT_GENERIC2(assert_greater_, EXPR, EXPECTED)
-#define assert_greater_or_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_greater_or_equal_, EXPR, EXPECTED)
-#define assert_less(EXPR, EXPECTED) ASSERT_GENERIC2(assert_less_, EXPR, EXPECTED)
-#define assert_less_or_equal(EXPR, EXPECTED) ASSERT_GENERIC2(assert_less_or_equal_, EXPR, EXPECTED)
+    if (async_units)
+        t1_add_at_end(&co.jobs, _t1_coordinator_job{units->size, -1});
 
-static void t1_print_results(unsigned int failed, unsigned int total, const char *name)
-{
-    if (total == 0)
+    ::qsort(co.jobs.data, co.jobs.size, sizeof(_t1_coordinator_job), _t1_compare_jobs);
+
+    sockaddr_un addr;
+
+    if (!_t1_make_socket_address(path, &addr))
+        return 1;
+
+    int server = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (server == -1)
+        return 1;
+
+    defer { ::close(server); };
+
+    ::unlink(path);
+    mode_t old_mask = ::umask(0077);
+    int bound = ::bind(server, (sockaddr*)&addr, sizeof(addr));
+    ::umask(old_mask);
+
+    if (bound == -1 || ::listen(server, 64) == -1)
     {
-        printf("%sno %s found%s\n", t1_COLOR_WARN, name, t1_COLOR_RESET);
-        return;
+        printf("%scould not listen on %s%s\n", t1_COLOR_FAILED, path, t1_COLOR_RESET);
+        return 1;
     }
 
-    float pct = ((float)failed / (float)total) * 100;
+    defer { ::unlink(path); };
 
-    printf("%s%u%s of %u (%s%.4f%%%s) %s failed\n",
-           (failed > 0 ? t1_COLOR_FAILED : t1_COLOR_PASSED),
-           failed, t1_COLOR_RESET, total,
-           (failed >= total ? t1_COLOR_FAILED : t1_COLOR_PASSED),
-           pct, t1_COLOR_RESET, name);
-}
+    ::signal(SIGPIPE, SIG_IGN);
 
-// this is a macro because of __FILE__, duh
-#define t1_print_summary()\
-{\
-    if (t1_tests::verbose && t1_tests::last_passed)\
-        puts("");\
-\
-    printf("summary of %s%s%s\n", t1_COLOR_SOURCE, __FILE__, t1_COLOR_RESET);\
-\
-    if (t1_tests::total_asserts > 0)\
-        t1_print_results(t1_tests::total_asserts_failed, t1_tests::total_asserts, "asserts");\
-\
-    t1_print_results(t1_tests::total_units_failed, t1_tests::total_units, "units");\
-    printf("total time: %.12fs\n", t1_tests::total_seconds);\
-\
-    if (t1_tests::unprintable_called)\
-    {\
-        printf("\n%sNOTE: One or more values could not be printed (%s<unprintable>%s), use\n"\
-                "%sdefine_t1_to_string(YourType x, \"%%d\", x.field, ...)%s to enable printing values\n"\
-                "of YourType. See %st1/tests/test5.cpp%s for an example.%s\n",\
-                t1_COLOR_WARN,\
-                t1_COLOR_FAILED, t1_COLOR_WARN,\
-                t1_COLOR_SOURCE, t1_COLOR_WARN,\
-                t1_COLOR_SOURCE, t1_COLOR_WARN,\
-                t1_COLOR_RESET\
-                );\
-    }\
+    u64 local_workers = t1_tests::coordinate_workers < 0 ? t1_get_processor_count() : (u64)t1_tests::coordinate_workers;
+
+    if (local_workers > co.jobs.size)
+        local_workers = co.jobs.size;
+
+    // replacements for local workers that died, limited in case they can't work at all
+    u64 restarts_left = co.jobs.size;
+    u64 alive = 0;
+
+    for (u64 i = 0; i < local_workers; ++i)
+    {
+        if (_t1_start_local_worker(path, server) == -1)
+            printf("%scould not start a local worker%s\n", t1_COLOR_WARN, t1_COLOR_RESET);
+        else
+            alive++;
+    }
+
+    if (local_workers == 0 && co.jobs.size > 0)
+        printf("waiting for workers on %s%s%s\n", t1_COLOR_SOURCE, path, t1_COLOR_RESET);
+
+    t1_array<pollfd> fds;
+    init(&fds);
+    defer { free(&fds); };
+
+    while (co.next_job < co.jobs.size || co.running > 0)
+    {
+        int status = 0;
+
+        while (::waitpid(-1, &status, WNOHANG) > 0)
+        {
+            if (alive > 0)
+                alive--;
+
+            if (co.next_job < co.jobs.size && restarts_left > 0)
+            {
+                restarts_left--;
+
+                if (_t1_start_local_worker(path, server) != -1)
+                    alive++;
+            }
+        }
+
+        // nothing is left to run the remaining jobs
+        if (local_workers > 0 && alive == 0 && co.running == 0 && co.clients.size == 0)
+        {
+            _t1_coordinator_fail_remaining(&co);
+            break;
+        }
+
+        fds.size = 0;
+        t1_add_at_end(&fds, pollfd{server, POLLIN, 0});
+
+        for (u64 i = 0; i < co.clients.size; ++i)
+            t1_add_at_end(&fds, pollfd{co.clients[i].fd, POLLIN, 0});
+
+        if (::poll(fds.data, fds.size, 100) <= 0)
+            continue;
+
+        for (u64 i = 0; i < co.clients.size; ++i)
+        {
+            _t1_coordinator_client *c = co.clients.data + i;
+
+            if (fds[i + 1].revents == 0)
+                continue;
+
+            char buf[4096];
+            s64 n = ::read(c->fd, buf, sizeof(buf));
+
+            if (n == -1 && (errno == EINTR || errno == EAGAIN))
+                continue;
+
+            if (n <= 0)
+            {
+                _t1_coordinator_disconnect(&co, c);
+                continue;
+            }
+
+            ::memcpy(t1_add_elements(&c->input, (u64)n), buf, (u64)n);
+            _t1_coordinator_receive(&co, c);
+        }
+
+        // forget closed clients
+        u64 open_clients = 0;
+
+        for (u64 i = 0; i < co.clients.size; ++i)
+        {
+            if (co.clients[i].fd != -1)
+                co.clients[open_clients++] = co.clients[i];
+            else
+                free(&co.clients[i].input);
+        }
+
+        co.clients.size = open_clients;
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = ::accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+
+            if (fd != -1)
+            {
+                _t1_coordinator_client *c = t1_add_at_end(&co.clients);
+                c->fd = fd;
+                c->job = -1;
+                init(&c->input);
+            }
+        }
+    }
+
+    // workers that are still connected wait for their next unit
+    for (u64 i = 0; i < co.clients.size; ++i)
+        if (co.clients[i].fd != -1)
+        {
+            _t1_coordinator_send(co.clients.data + i, "done\n");
+            ::close(co.clients[i].fd);
+            co.clients[i].fd = -1;
+        }
+
+    while (::waitpid(-1, nullptr, 0) > 0)
+        ;
+
+    if (costs_path != nullptr)
+        _t1_save_costs(costs_path, co.costs);
+
+    return 0;
+#else
+    (void)path;
+    printf("%s--coordinate is not supported on this platform%s\n", t1_COLOR_FAILED, t1_COLOR_RESET);
+    return 1;
+#endif
 }
 
 void t1_nop(){}
@@ -999,28 +11331,85 @@ void t1_nop(){}
 #define define_test_main(BEFORE_TESTS, AFTER_TESTS) \
 int main(int argc, const char *argv[])\
 {\
-    for (int i = 1; i < argc; ++i)\
+    t1_parse_arguments(argc, argv);\
+\
+    if (t1_tests::connect_path != nullptr)\
+        return t1_connect(t1_tests::connect_path, argc, argv);\
+\
+    t1_select_impacted_units();\
+\
+    if (t1_tests::list_units)\
     {\
-        const char *arg = argv[i];\
+        t1_list_units();\
+        free(&t1_tests::units);\
+        free(&t1_tests::filters);\
+        free(&t1_tests::changed);\
+        free(&t1_tests::impacted);\
+        return 0;\
+    }\
 \
-        if (strcmp(arg, "-b") == 0 || strcmp(arg, "--break") == 0)\
-            t1_tests::stop_on_fail = true;\
-        else if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0)\
-            t1_tests::verbose = true;\
+    if (!t1_check_arguments())\
+    {\
+        free(&t1_tests::units);\
+        free(&t1_tests::filters);\
+        free(&t1_tests::changed);\
+        free(&t1_tests::impacted);\
+        return 1;\
     }\
+\
+    int ret = 0;\
 \
     BEFORE_TESTS();\
-    t1_tests::run();\
-    AFTER_TESTS();\
 \
-    t1_print_summary()\
+    if (t1_tests::async_output)\
+        t1_reporter_start();\
 \
-    free(&t1_tests::units);\
+    if (t1_tests::serve_path != nullptr)\
+        ret = t1_serve(t1_tests::serve_path, __FILE__);\
+    else if (t1_tests::coordinate_path != nullptr)\
+    {\
+        ret = t1_coordinate(t1_tests::coordinate_path);\
+        AFTER_TESTS();\
 \
-    if (t1_tests::total_units_failed > 0)\
-        return 1;\
+        t1_print_summary()\
+\
+        if (t1_tests::total_units_failed > 0)\
+            ret = 1;\
+    }\
+    else if (t1_tests::worker_path != nullptr)\
+    {\
+        ret = t1_work(t1_tests::worker_path);\
+        AFTER_TESTS();\
+    }\
+    else if (t1_tests::fuzz || t1_tests::fuzz_minimize)\
+    {\
+        ret = t1_fuzz();\
+        AFTER_TESTS();\
+    }\
+    else\
+    {\
+        t1_tests::run();\
+        AFTER_TESTS();\
+\
+        t1_print_summary()\
+\
+        if (t1_tests::total_units_failed > 0)\
+            ret = 1;\
+    }\
+\
+    if (t1_tests::serve_path != nullptr)\
+        AFTER_TESTS();\
+\
+    t1_reporter_stop();\
+    t1_perf_close(_t1_get_perf_group());\
+    free(&t1_tests::units);\
+    free(&t1_tests::filters);\
+    free(&t1_tests::repeat_results);\
+    free(&t1_tests::changed);\
+    free(&t1_tests::impacted);\
+    free(_t1_get_fuzz_targets());\
 \
-    return 0;\
+    return ret;\
 }
 
 #define define_default_test_main()\
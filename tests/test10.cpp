@@ -0,0 +1,68 @@
+
+#include <t1/t1.hpp>
+
+// runs the body once per line of corpus/sums.txt (relative to this file),
+// each line being "a b a+b". failing lines are reported with their index
+// and offset in the file.
+
+define_test_cases(sums, "corpus/sums.txt", t1_parse_lines)
+{
+    int a = 0;
+    int b = 0;
+    int sum = 0;
+
+    t1_string line = t1_tprintf("%.*s", (int)record.size, record.data);
+
+    assert_equal(sscanf(line.data, "%d %d %d", &a, &b, &sum), 3);
+    assert_equal(a + b, sum);
+}
+
+#if !t1_Windows
+static const char *truncated_corpus = "test10.truncated.tmp";
+
+static void count_case(const t1_record &)
+{
+    assert_equal(1, 1);
+}
+
+static void truncated_cases()
+{
+    t1_run_test_cases(__FILE__, truncated_corpus, t1_parse_u32le_length_prefixed, count_case);
+}
+
+define_test(truncated_record_fails)
+{
+    // "a", then a record of 10 bytes of which 3 are left
+    const char corpus[] = "\x01\0\0\0a\x0a\0\0\0xyz";
+    assert_equal(t1_write_file_atomic(truncated_corpus, corpus, sizeof(corpus) - 1), true);
+    defer { ::unlink(truncated_corpus); };
+
+    t1_unit units[] = {t1_unit{"truncated", truncated_cases, "test10.cpp", 1}};
+
+    t1_array<char> output;
+    init(&output);
+    defer { free(&output); };
+
+    u32 results[2] = {};
+    int status = t1_run_in_child(units, 1, [&]
+    {
+        t1_tests::run();
+        results[0] = t1_tests::total_units_failed;
+        results[1] = t1_tests::total_asserts;
+        return 0;
+    }, results, sizeof(results), &output);
+
+    t1_add_at_end(&output, '\0');
+
+    assert_equal(status, 0);
+    assert_equal(results[0], 1u);
+    assert_equal(results[1], 1u);
+
+    // the second case, after the 5 bytes of the first
+    assert_not_equal(strstr(output.data, "could not parse case 1"), nullptr);
+    assert_not_equal(strstr(output.data, "test10.truncated.tmp+0x5"), nullptr);
+    assert_not_equal(strstr(output.data, " of 2 cases of"), nullptr);
+}
+#endif
+
+define_default_test_main();
@@ -0,0 +1,20 @@
+
+#include <t1/t1.hpp>
+
+// compares output with the golden file snapshots/test11.cpp.report.snap,
+// run with --update-snapshots to rewrite it after intended changes.
+
+static t1_string make_report()
+{
+    return t1_tprintf("report\n"
+                      "  units: %d\n"
+                      "  failed: %d\n", 3, 0);
+}
+
+define_test(report)
+{
+    t1_string report = make_report();
+    assert_matches_snapshot("report", report.data, report.size);
+}
+
+define_default_test_main();
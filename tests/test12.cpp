@@ -0,0 +1,81 @@
+
+#include <t1/t1.hpp>
+
+// with --async-output, units only copy their output into a queue and a
+// reporter thread writes it, so slow terminals or pipes don't add to the
+// time of a unit.
+
+struct queue_test
+{
+    t1_spsc_queue queue;
+    u32 count;
+};
+
+static void produce(void *arg)
+{
+    queue_test *t = (queue_test*)arg;
+    u32 buf[37];
+    u32 next = 0;
+
+    // 37 * 4 bytes don't divide the queue size, so pushes cross its end
+    while (next < t->count)
+    {
+        u32 n = 0;
+
+        for (; n < 37 && next < t->count; ++n)
+            buf[n] = next++;
+
+        t1_spsc_push(&t->queue, (const char*)buf, n * sizeof(u32));
+    }
+}
+
+define_test(spsc_queue_keeps_order)
+{
+    queue_test t;
+    t.count = 200000;
+    assert_equal(init(&t.queue, 4096), true);
+
+    t1_thread producer;
+    assert_equal(t1_thread_start(&producer, produce, &t), true);
+
+    u32 expected = 0;
+    bool in_order = true;
+
+    while (expected < t.count)
+    {
+        t1_string pending = t1_spsc_peek(&t.queue);
+        u64 whole = pending.size - pending.size % sizeof(u32);
+
+        for (u64 i = 0; i < whole; i += sizeof(u32))
+        {
+            u32 x;
+            ::memcpy(&x, pending.data + i, sizeof(u32));
+            in_order &= x == expected++;
+        }
+
+        t1_spsc_pop(&t.queue, whole);
+    }
+
+    t1_thread_join(&producer);
+    free(&t.queue);
+
+    assert_equal(in_order, true);
+}
+
+define_test(output_is_queued)
+{
+    assert_equal(_t1_get_reporter()->running, true);
+    assert_not_equal(_t1_get_reporter_queue(), nullptr);
+
+    for (int i = 0; i < 1000; ++i)
+        printf("");
+
+    printf("this line is written by the reporter thread\n");
+}
+
+static void setup()
+{
+    t1_tests::async_output = true;
+}
+
+define_test_main(setup, t1_nop);
@@ -0,0 +1,54 @@
+
+#include <t1/t1.hpp>
+
+// define_stress_test runs its body on several threads at once, see
+// t1.hpp for details. --stress-jitter adds random delays.
+
+static u64 counter = 0;
+static u64 finished = 0;
+
+static void increment_twice(const t1_stress_context &)
+{
+    t1_atomic_add(&counter, (u64)1);
+    t1_stress_jitter();
+    t1_atomic_add(&counter, (u64)1);
+}
+
+// t1_run_stress_test is what define_stress_test calls
+define_test(atomic_counter)
+{
+    t1_run_stress_test(4, 10000, increment_twice);
+    assert_equal(counter, 2u * 4u * 10000u);
+}
+
+// every thread finished the previous iteration before any thread starts the next
+define_stress_test(barrier, 3, 1000)
+{
+    assert_equal(stress.thread_count, 3u);
+    assert_greater_or_equal(t1_atomic_load(&finished), stress.iteration * stress.thread_count);
+
+    t1_stress_jitter();
+    t1_atomic_add(&finished, (u64)1);
+}
+
+#if t1_Linux
+// threads are pinned to processors of the process's cpuset
+define_stress_test(pinned_to_allowed_processors, 2, 10)
+{
+    s32 processor = t1_allowed_processor(stress.thread);
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    assert_equal(sched_getaffinity(::getpid(), sizeof(set), &set), 0);
+    assert_greater_or_equal(processor, 0);
+    assert_equal(CPU_ISSET(processor, &set) != 0, true);
+    assert_equal(::sched_getcpu(), processor);
+}
+#endif
+
+static void setup()
+{
+    t1_tests::stress_jitter = true;
+}
+
+define_test_main(setup, t1_nop);
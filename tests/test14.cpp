@@ -0,0 +1,92 @@
+#include <t1/t1.hpp>
+
+// --profile[=hz] samples every unit and writes its stacks to
+// profile/<test file>.<unit>.folded after the run, e.g.
+//
+//    test14 --profile=499 --filter slow_unit
+//    flamegraph.pl profile/test14.cpp.slow_unit.folded > slow_unit.svg
+
+#if t1_PROFILER
+static volatile u64 sink = 0;
+
+// the profiler samples the cpu time of the thread, which is less than the
+// wall time when other processes run too
+[[gnu::noinline]] static void spin_for_a_while()
+{
+    timespec start;
+    timespec now;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+    do
+    {
+        for (int i = 0; i < 10000; ++i)
+            sink = sink + i;
+
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    }
+    while (t1_get_seconds_difference(&start, &now) < 0.2);
+}
+
+static void spinning_unit()
+{
+    spin_for_a_while();
+}
+
+define_test(profile_writes_folded_stacks)
+{
+    const char *path = t1_PROFILE_DIRECTORY "/test14.cpp.spinning.folded";
+    ::unlink(path);
+
+    t1_unit units[] = {t1_unit{"spinning", spinning_unit, "test14.cpp", 1}};
+
+    // runs its own unit with --profile, quietly
+    int status = t1_run_in_child(units, 1, []
+    {
+        const char *argv[] = {"test14", "--profile=997"};
+        t1_parse_arguments(2, argv);
+        t1_tests::run();
+        return 0;
+    });
+
+    assert_equal(status, 0);
+
+    t1_mapped_file folded{};
+    assert_equal(t1_map_file(path, &folded), true);
+    defer { t1_unmap_file(&folded); ::unlink(path); };
+
+    t1_array<char> text;
+    init(&text);
+    defer { free(&text); };
+
+    ::memcpy(t1_add_elements(&text, folded.size), folded.data, folded.size);
+    t1_add_at_end(&text, '\0');
+
+    // "root;...;leaf count" per line, the unit's function among the frames
+    assert_not_equal(strstr(text.data, "spin_for_a_while()"), (char*)nullptr);
+
+    u64 samples = 0;
+
+    for (char *line = text.data; *line != '\0';)
+    {
+        char *eol = strchr(line, '\n');
+        assert_not_equal(eol, (char*)nullptr);
+
+        if (eol == nullptr)
+            break;
+
+        *eol = '\0';
+        char *count = strrchr(line, ' ');
+        assert_not_equal(count, (char*)nullptr);
+
+        if (count != nullptr)
+            samples += ::strtoull(count + 1, nullptr, 10);
+
+        line = eol + 1;
+    }
+
+    // 0.2s of cpu time at 997 Hz are ~199 samples
+    assert_greater(samples, 100ull);
+}
+#endif
+
+define_default_test_main();
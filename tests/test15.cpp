@@ -0,0 +1,131 @@
+
+#include <t1/t1.hpp>
+
+// --journal <path> records the state of every unit while running, so that
+// after a crash
+//
+//    test15 --journal run.journal --resume
+//
+// skips the units that already ran and reports the one that was running.
+
+#if !t1_Windows
+define_test(journal_survives_crash)
+{
+    const char *path = "test15.journal.tmp";
+    t1_unit units[3] = {
+        t1_unit{"first", nullptr, "test15.cpp", 1},
+        t1_unit{"second", nullptr, "test15.cpp", 2},
+        t1_unit{"third", nullptr, "test15.cpp", 3}
+    };
+
+    int pid = ::fork();
+
+    if (pid == 0)
+    {
+        t1_journal j;
+
+        if (!t1_journal_open(&j, path, units, 3, false))
+            ::_exit(1);
+
+        t1_journal_begin_unit(j.records + 0);
+        t1_journal_end_unit(j.records + 0, true, 5, 0, 0.5);
+        t1_journal_begin_unit(j.records + 1);
+        ::abort();
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    assert_equal(WIFSIGNALED(status), true);
+
+    // a unit was added in front, records are matched by name
+    t1_unit resumed_units[4] = {
+        t1_unit{"new", nullptr, "test15.cpp", 1},
+        units[0], units[1], units[2]
+    };
+
+    t1_journal j;
+    assert_equal(t1_journal_open(&j, path, resumed_units, 4, true), true);
+
+    assert_equal(j.records[0].state, (u32)t1_journal_not_run);
+    assert_equal(j.records[1].state, (u32)t1_journal_passed);
+    assert_equal(j.records[1].asserts, 5u);
+    assert_equal(j.records[2].state, (u32)t1_journal_started);
+    assert_equal(j.records[3].state, (u32)t1_journal_not_run);
+
+    t1_journal_close(&j);
+
+    // without resume, everything starts over
+    assert_equal(t1_journal_open(&j, path, resumed_units, 4, false), true);
+    assert_equal(j.records[1].state, (u32)t1_journal_not_run);
+    t1_journal_close(&j);
+
+    ::unlink(path);
+}
+
+// units of the runs below, the child sends ran back
+static u32 ran = 0;
+static bool crash = false;
+
+static void first_unit()  { ran |= 1; assert_equal(1, 1); }
+static void second_unit() { ran |= 2; if (crash) ::abort(); }
+static void third_unit()  { ran |= 4; assert_equal(2, 2); }
+
+struct journaled_run
+{
+    int status;
+    u32 ran;
+    u32 units;
+    u32 units_failed;
+    u32 asserts;
+};
+
+// runs the three units in a child with the journal at path
+static journaled_run run_journaled(const char *path, bool resume, bool crashing)
+{
+    t1_unit units[] = {
+        t1_unit{"first", first_unit, "test15.cpp", 1},
+        t1_unit{"second", second_unit, "test15.cpp", 2},
+        t1_unit{"third", third_unit, "test15.cpp", 3}
+    };
+
+    journaled_run result{-1, 0, 0, 0, 0};
+    result.status = t1_run_in_child(units, 3, [&]
+    {
+        t1_tests::journal_path = path;
+        t1_tests::resume = resume;
+        crash = crashing;
+        t1_tests::run();
+
+        result.ran = ran;
+        result.units = t1_tests::total_units;
+        result.units_failed = t1_tests::total_units_failed;
+        result.asserts = t1_tests::total_asserts;
+        return 0;
+    }, &result, sizeof(result));
+
+    return result;
+}
+
+define_test(run_resumes_after_crash)
+{
+    const char *path = "test15.run.journal.tmp";
+    ::unlink(path);
+    defer { ::unlink(path); };
+
+    assert_equal(t1_journal_exists(path), false);
+
+    journaled_run crashed = run_journaled(path, false, true);
+    assert_equal(crashed.status, 128 + SIGABRT);
+    assert_equal(t1_journal_exists(path), true);
+
+    // first passed, second was running when the process died
+    journaled_run resumed = run_journaled(path, true, true);
+    assert_equal(resumed.status, 0);
+    assert_equal(resumed.ran, 4u);
+    assert_equal(resumed.units, 3u);
+    assert_equal(resumed.units_failed, 1u);
+    assert_equal(resumed.asserts, 2u);
+}
+#endif
+
+define_default_test_main();
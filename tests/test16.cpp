@@ -0,0 +1,93 @@
+
+#define t1_guard_allocations
+#include <t1/t1.hpp>
+
+// allocations made by units are placed in front of a guard page, so
+// overruns and uses after free crash immediately.
+
+static void overrun(u64 size)
+{
+    volatile char *p = (volatile char*)::malloc(size);
+    p[size] = 1;
+}
+
+static void use_after_free()
+{
+    volatile int *p = new int[4]{};
+    delete[] p;
+    p[1] = 2;
+}
+
+static void double_free()
+{
+    void *p = ::malloc(32);
+    ::free(p);
+    ::free(p);
+}
+
+static void read_past_input(const u8 *data, u64 size)
+{
+    volatile u8 byte = data[size];
+    (void)byte;
+}
+
+// fuzz inputs are run from guarded copies of exactly their size, also when
+// the corpus is replayed from mapped files
+static void fuzz_input_overread()
+{
+    t1_fuzz_target target{"overread", "test16.cpp", "test16.cpp", 1, read_past_input};
+    _t1_fuzz_state *s = _t1_fuzz_state_create(&target, ".", 0);
+    const u8 input[48] = {};
+
+    // --fuzz runs no units, allocations aren't guarded outside of them
+    _t1_set_allocation_tracking(false);
+    _t1_fuzz_execute(s, input, sizeof(input));
+}
+
+static void replayed_input_overread()
+{
+    const char input[32] = {};
+    _t1_fuzz_replay_body = read_past_input;
+    _t1_fuzz_replay_case(t1_record{input, sizeof(input), 0, 0, "input"});
+}
+
+define_test(guarded_memory_is_usable)
+{
+    char *p = (char*)::malloc(100);
+    ::memset(p, 'x', 100);
+    p = (char*)::realloc(p, 5000);
+    assert_equal(p[99], 'x');
+    ::free(p);
+
+    int *q = (int*)::calloc(10, sizeof(int));
+    assert_equal(q[9], 0);
+    ::free(q);
+
+    s64 *r = new s64(5);
+    assert_equal(*r, 5);
+    delete r;
+}
+
+define_test(overrun_is_caught)
+{
+    assert_death(overrun(48), t1_killed_by(SIGSEGV), "*heap buffer overflow*0 bytes after an allocation of 48 bytes*");
+    assert_death(overrun(4096), t1_killed_by(SIGSEGV), "*heap buffer overflow*");
+}
+
+define_test(fuzz_input_overread_is_caught)
+{
+    assert_death(fuzz_input_overread(), t1_killed_by(SIGSEGV), "*heap buffer overflow*0 bytes after an allocation of 48 bytes*");
+    assert_death(replayed_input_overread(), t1_killed_by(SIGSEGV), "*heap buffer overflow*0 bytes after an allocation of 32 bytes*");
+}
+
+define_test(use_after_free_is_caught)
+{
+    assert_death(use_after_free(), t1_killed_by(SIGSEGV), "*use after free*freed at*");
+}
+
+define_test(double_free_is_caught)
+{
+    assert_death(double_free(), t1_killed_by(SIGABRT), "*double free*");
+}
+
+define_default_test_main();
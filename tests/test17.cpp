@@ -0,0 +1,290 @@
+
+#include <t1/t1.hpp>
+
+// normal runs replay fuzz/test17.cpp.key_value, run with --fuzz=10 to
+// search for new inputs.
+
+struct key_value
+{
+    const u8 *key;
+    u64 key_size;
+    const u8 *value;
+    u64 value_size;
+};
+
+// parses "key=value;key=value...", returns the number of pairs or -1
+static s64 parse_pairs(const u8 *data, u64 size, key_value *out, u64 max)
+{
+    s64 count = 0;
+    u64 i = 0;
+
+    while (i < size)
+    {
+        if ((u64)count >= max)
+            return -1;
+
+        key_value *kv = out + count;
+        kv->key = data + i;
+
+        while (i < size && data[i] != '=')
+            i++;
+
+        if (i == size)
+            return -1;
+
+        kv->key_size = (u64)(data + i - kv->key);
+        kv->value = data + ++i;
+
+        while (i < size && data[i] != ';')
+            i++;
+
+        kv->value_size = (u64)(data + i - kv->value);
+        i++;
+        count++;
+    }
+
+    return count;
+}
+
+define_fuzz_target(key_value, data, size)
+{
+    key_value pairs[8];
+    s64 count = parse_pairs(data, size, pairs, 8);
+
+    if (count < 0)
+        return;
+
+    u64 total = 0;
+
+    for (s64 i = 0; i < count; ++i)
+        total += pairs[i].key_size + pairs[i].value_size + 1;
+
+    assert_less_or_equal(total, size);
+    assert_greater_or_equal(total + (u64)count, size);
+}
+
+// the fuzzer itself, run in a child in a temporary directory on targets
+// that aren't registered, so normal runs don't replay them.
+#if !t1_Windows
+static volatile u64 sink = 0;
+
+static void fails_on_magic(const u8 *data, u64 size)
+{
+    if (size >= 2 && data[0] == 'F' && data[1] == 'U')
+        assert_equal(size, 0ull);
+}
+
+static void crashes_on_c(const u8 *data, u64 size)
+{
+    if (size > 0 && data[0] == 'C')
+        ::abort();
+}
+
+static void hangs(const u8 *, u64 size)
+{
+    while (size > 0)
+        sink = sink + 1;
+}
+
+static void branches(const u8 *data, u64 size)
+{
+    if (size > 0 && data[0] == 'x')
+        sink = sink + 1;
+    else
+        sink = sink - 1;
+}
+
+struct fuzz_dir
+{
+    char path[64];
+    char corpus[128];
+    t1_array<char> output; // of the last fuzz_in_child
+};
+
+static void init(fuzz_dir *dir, const char *target)
+{
+    ::snprintf(dir->path, sizeof(dir->path), "/tmp/t1test17.XXXXXX");
+
+    if (::mkdtemp(dir->path) == nullptr)
+        dir->path[0] = '\0';
+
+    ::snprintf(dir->corpus, sizeof(dir->corpus), "%s/fuzz/test17.cpp.%s", dir->path, target);
+    init(&dir->output);
+}
+
+static void list(fuzz_dir *dir, t1_array<const char*> *paths)
+{
+    init(paths);
+    _t1_list_corpus_files(dir->corpus, paths);
+}
+
+static void free_paths(t1_array<const char*> *paths)
+{
+    for (u64 i = 0; i < paths->size; ++i)
+        ::free((void*)paths->data[i]);
+
+    free(paths);
+}
+
+static void free(fuzz_dir *dir)
+{
+    t1_array<const char*> paths;
+    list(dir, &paths);
+
+    for (u64 i = 0; i < paths.size; ++i)
+        ::unlink(paths[i]);
+
+    free_paths(&paths);
+
+    ::rmdir(dir->corpus);
+    ::rmdir(t1_tprintf("%s/fuzz", dir->path).data);
+    ::rmdir(dir->path);
+    free(&dir->output);
+}
+
+// runs t1_fuzz on target body with args in a child in dir, output goes to
+// dir->output. returns the exit code, or 128 + the signal.
+static int fuzz_in_child(fuzz_dir *dir, const char *target, t1_fuzz_function body, int argc, const char **argv)
+{
+    dir->output.size = 0;
+
+    return t1_run_in_child(nullptr, 0, [&]
+    {
+        if (::chdir(dir->path) != 0)
+            return 100;
+
+        t1_parse_arguments(argc, argv);
+        t1_tests::filters.size = 0;
+        _t1_get_fuzz_targets()->size = 0;
+        t1_add_fuzz_target(t1_fuzz_target{target, "test17.cpp", "test17.cpp", 1, body});
+
+        return t1_fuzz();
+    }, nullptr, 0, &dir->output);
+}
+
+static bool output_contains(const fuzz_dir *dir, const char *text)
+{
+    return ::memmem(dir->output.data, dir->output.size, text, strlen(text)) != nullptr;
+}
+
+// the first crash reproducer in the corpus, with the input mapped to out
+static bool map_crash(fuzz_dir *dir, t1_mapped_file *out)
+{
+    t1_array<const char*> paths;
+    list(dir, &paths);
+    defer { free_paths(&paths); };
+
+    for (u64 i = 0; i < paths.size; ++i)
+        if (strncmp(t1_get_filename(paths[i]), "crash-", 6) == 0)
+            return t1_map_file(paths[i], out);
+
+    return false;
+}
+
+define_test(crashing_input_is_written)
+{
+    fuzz_dir dir;
+    init(&dir, "crashes");
+    defer { free(&dir); };
+
+    const char *argv[] = {"test17", "--fuzz=30"};
+    assert_equal(fuzz_in_child(&dir, "crashes", crashes_on_c, 2, argv), 1);
+    assert_equal(output_contains(&dir, "fuzz input crashed, written to"), true);
+    assert_equal(output_contains(&dir, "fuzz worker killed by signal"), true);
+
+    t1_mapped_file crash;
+    assert_equal(map_crash(&dir, &crash), true);
+    assert_greater(crash.size, 0ull);
+    assert_equal(crash.data[0], 'C');
+    t1_unmap_file(&crash);
+}
+
+define_test(hanging_input_times_out)
+{
+    fuzz_dir dir;
+    init(&dir, "hangs");
+    defer { free(&dir); };
+
+    const char *argv[] = {"test17", "--fuzz=30", "--fuzz-timeout", "1"};
+    assert_equal(fuzz_in_child(&dir, "hangs", hangs, 4, argv), 1);
+    assert_equal(output_contains(&dir, "fuzz input timed out, written to"), true);
+
+    t1_mapped_file crash;
+    assert_equal(map_crash(&dir, &crash), true);
+    assert_greater(crash.size, 0ull);
+    t1_unmap_file(&crash);
+}
+
+define_test(workers_fuzz_in_parallel)
+{
+    fuzz_dir dir;
+    init(&dir, "branches");
+    defer { free(&dir); };
+
+    const char *argv[] = {"test17", "--fuzz-runs", "2000", "--fuzz-workers", "2"};
+    assert_equal(fuzz_in_child(&dir, "branches", branches, 5, argv), 0);
+    assert_equal(output_contains(&dir, " worker 0: 2000 runs"), true);
+    assert_equal(output_contains(&dir, " worker 1: 2000 runs"), true);
+}
+
+// these need the coverage of the FUZZING build
+#if t1_COVERAGE
+define_test(mutations_find_failing_input)
+{
+    fuzz_dir dir;
+    init(&dir, "magic");
+    defer { free(&dir); };
+
+    const char *argv[] = {"test17", "--fuzz=30"};
+    assert_equal(fuzz_in_child(&dir, "magic", fails_on_magic, 2, argv), 1);
+    assert_equal(output_contains(&dir, "found a failing input"), true);
+
+    t1_mapped_file crash;
+    assert_equal(map_crash(&dir, &crash), true);
+    assert_greater_or_equal(crash.size, 2ull);
+    assert_equal(::memcmp(crash.data, "FU", 2), 0);
+    t1_unmap_file(&crash);
+}
+
+define_test(minimize_keeps_inputs_adding_coverage)
+{
+    fuzz_dir dir;
+    init(&dir, "branches");
+    defer { free(&dir); };
+
+    t1_make_directory(t1_tprintf("%s/fuzz", dir.path).data);
+    t1_make_directory(dir.corpus);
+
+    const char *inputs[] = {"xa", "xb", "ya", "yb", "crash-0"};
+
+    for (const char *input : inputs)
+        t1_write_file_atomic(t1_tprintf("%s/%s", dir.corpus, input).data, input, 2);
+
+    const char *argv[] = {"test17", "--fuzz-minimize"};
+    assert_equal(fuzz_in_child(&dir, "branches", branches, 2, argv), 0);
+    assert_equal(output_contains(&dir, "kept 2 of 4 inputs"), true);
+
+    t1_array<const char*> paths;
+    list(&dir, &paths);
+    defer { free_paths(&paths); };
+
+    u32 x = 0;
+    u32 y = 0;
+    u32 crashes = 0;
+
+    for (u64 i = 0; i < paths.size; ++i)
+    {
+        const char *name = t1_get_filename(paths[i]);
+        x += name[0] == 'x';
+        y += name[0] == 'y';
+        crashes += name[0] == 'c';
+    }
+
+    assert_equal(x, 1u);
+    assert_equal(y, 1u);
+    assert_equal(crashes, 1u);
+}
+#endif
+#endif
+
+define_default_test_main();
@@ -0,0 +1,177 @@
+#define t1_shadow_stdlib
+#include <t1/t1.hpp>
+
+// with t1_shadow_stdlib, code under test calling open, write, rename etc.
+// works on an in-memory filesystem while one is mounted.
+
+#if t1_VFS
+static bool save_atomically(const char *path, const char *data)
+{
+    const char *tmp = t1_tprintf("%s.tmp", path).data;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1)
+        return false;
+
+    bool ok = write(fd, data, strlen(data)) == (ssize_t)strlen(data) && fsync(fd) == 0;
+    close(fd);
+
+    return ok && rename(tmp, path) == 0;
+}
+
+define_vfs_test(save_replaces_file)
+{
+    assert_equal(t1_vfs_write_file(vfs, "/etc/app.conf", "a=1", 3), true);
+
+    assert_equal(save_atomically("/etc/app.conf", "a=2\nb=3"), true);
+
+    assert_vfs_file(vfs, "/etc/app.conf", "a=2\nb=3", 7);
+    assert_equal(t1_vfs_exists(vfs, "/etc/app.conf.tmp"), false);
+    assert_equal(vfs->stats.fsyncs, 1u);
+    assert_equal(vfs->stats.renames, 1u);
+    assert_equal(t1_vfs_open_files(vfs), 0u);
+}
+
+define_vfs_test(read_write_seek)
+{
+    int fd = open("data", O_RDWR | O_CREAT | O_EXCL, 0600);
+    assert_greater_or_equal(fd, t1_VFS_FD_BASE);
+
+    assert_equal(write(fd, "hello world", 11), 11);
+    assert_equal(lseek(fd, 6, SEEK_SET), 6);
+
+    char buf[16] = {};
+    assert_equal(read(fd, buf, sizeof(buf)), 5);
+    assert_equal(strcmp(buf, "world"), 0);
+
+    assert_equal(pwrite64(fd, "W", 1, 6), 1);
+    assert_equal(ftruncate(fd, 7), 0);
+    assert_equal(close(fd), 0);
+    assert_vfs_file(vfs, "/data", "hello W", 7);
+
+    assert_equal(open("data", O_CREAT | O_EXCL | O_WRONLY, 0600), -1);
+    assert_equal(errno, EEXIST);
+    assert_equal(read(fd, buf, 1), -1);
+    assert_equal(errno, EBADF);
+
+    fd = open("data", O_WRONLY | O_APPEND);
+    assert_equal(write(fd, "!", 1), 1);
+    close(fd);
+    assert_vfs_file(vfs, "/data", "hello W!", 8);
+}
+
+define_vfs_test(directories_and_links)
+{
+    assert_equal(mkdir("/a", 0755), 0);
+    assert_equal(mkdir("/a/b", 0755), 0);
+    assert_equal(mkdir("/a/b", 0755), -1);
+    assert_equal(errno, EEXIST);
+    assert_equal(mkdir("/x/y", 0755), -1);
+    assert_equal(errno, ENOENT);
+
+    assert_equal(chdir("/a/b"), 0);
+    char cwd[64];
+    assert_equal(strcmp(getcwd(cwd, sizeof(cwd)), "/a/b"), 0);
+
+    assert_equal(t1_vfs_write_file(vfs, "file", "x", 1), true);
+    assert_equal(t1_vfs_exists(vfs, "/a/b/file"), true);
+    assert_equal(access("../b/./file", F_OK), 0);
+
+    assert_equal(symlink("/a/b", "/link"), 0);
+    assert_equal(access("/link/file", F_OK), 0);
+    char target[16] = {};
+    assert_equal(readlink("/link", target, sizeof(target)), 4);
+    assert_equal(strcmp(target, "/a/b"), 0);
+
+    assert_equal(link("/a/b/file", "/hard"), 0);
+    assert_equal(unlink("/a/b/file"), 0);
+    assert_vfs_file(vfs, "/hard", "x", 1);
+
+    assert_equal(rmdir("/a"), -1);
+    assert_equal(errno, ENOTEMPTY);
+    assert_equal(rename("/a", "/a/b/c"), -1);
+    assert_equal(errno, EINVAL);
+    assert_equal(unlink("/a"), -1);
+    assert_equal(errno, EISDIR);
+    assert_equal(rmdir("/a/b"), 0);
+    assert_equal(t1_vfs_exists(vfs, "/a/b"), false);
+}
+
+define_vfs_test(symlink_targets)
+{
+    assert_equal(mkdir("/dir", 0755), 0);
+
+    // creating through a dangling symlink creates its target, relative to
+    // the symlink's directory
+    assert_equal(symlink("target", "/dir/link"), 0);
+    int fd = open("/dir/link", O_WRONLY | O_CREAT, 0644);
+    assert_greater_or_equal(fd, t1_VFS_FD_BASE);
+    assert_equal(close(fd), 0);
+    assert_equal(t1_vfs_exists(vfs, "/dir/target"), true);
+    assert_equal(t1_vfs_exists(vfs, "/target"), false);
+
+    fd = open("/dir", O_RDONLY | O_DIRECTORY);
+    assert_greater_or_equal(fd, t1_VFS_FD_BASE);
+    assert_equal(close(fd), 0);
+
+    // a directory reached through two symlinks
+    t1_vfs_write_file(vfs, "/dir/f", "abc", 3);
+    t1_vfs_write_file(vfs, "/f", "xyz", 3);
+    assert_equal(symlink("/dir", "/l2"), 0);
+    assert_equal(symlink("/l2", "/l1"), 0);
+
+    fd = open("/l1/f", O_RDONLY);
+    assert_greater_or_equal(fd, t1_VFS_FD_BASE);
+
+    char buf[4] = {};
+    assert_equal(read(fd, buf, 3), 3);
+    assert_equal(strcmp(buf, "abc"), 0);
+    assert_equal(close(fd), 0);
+
+    // the last hop has to be a directory
+    assert_equal(symlink("/dir/f", "/l3"), 0);
+    assert_equal(symlink("/l3", "/l4"), 0);
+    assert_equal(access("/l4/f", F_OK), -1);
+    assert_equal(errno, ENOTDIR);
+}
+
+define_vfs_test(open_file_outlives_unlink)
+{
+    t1_vfs_write_file(vfs, "/f", "abc", 3);
+
+    int fd = open("/f", O_RDONLY);
+    assert_equal(unlink("/f"), 0);
+    assert_equal(t1_vfs_file_size(vfs, "/f"), -1);
+
+    char buf[4] = {};
+    assert_equal(read(fd, buf, 3), 3);
+    assert_equal(strcmp(buf, "abc"), 0);
+    assert_equal(close(fd), 0);
+}
+
+define_test(unmounted_uses_real_filesystem)
+{
+    assert_equal((void*)t1_vfs_mounted(), (void*)nullptr);
+
+    const char *path = "test18.tmp";
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert_greater_or_equal(fd, 0);
+    assert_less(fd, t1_VFS_FD_BASE);
+    assert_equal(write(fd, "disk", 4), 4);
+    assert_equal(close(fd), 0);
+
+    t1_vfs fs;
+    init(&fs);
+    defer { free(&fs); };
+
+    t1_with_vfs(&fs)
+    {
+        assert_equal(access(path, F_OK), -1);
+    }
+
+    assert_equal(access(path, F_OK), 0);
+    assert_equal(unlink(path), 0);
+}
+#endif
+
+define_default_test_main();
@@ -0,0 +1,153 @@
+#define t1_shadow_stdlib
+#include <t1/t1.hpp>
+
+// with t1_shadow_stdlib, a fault schedule makes the shadowed I/O functions
+// fail on purpose, here on top of an in-memory filesystem.
+
+#if t1_VFS
+// retries short writes and EINTR
+static bool write_all(int fd, const char *data, u64 size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, data, size);
+
+        if (n == -1 && errno == EINTR)
+            continue;
+
+        if (n <= 0)
+            return false;
+
+        data += n;
+        size -= (u64)n;
+    }
+
+    return true;
+}
+
+static bool save(const char *path, const char *data)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1)
+        return false;
+
+    bool ok = write_all(fd, data, strlen(data)) && fsync(fd) == 0;
+    close(fd);
+
+    return ok;
+}
+
+define_fault_test(nth_call_fails)
+{
+    t1_vfs vfs;
+    init(&vfs);
+    defer { free(&vfs); };
+
+    t1_fail_nth(faults, t1_sys_write, 2, ENOSPC);
+
+    t1_with_vfs(&vfs)
+    {
+        assert_equal(save("/a", "first"), true);
+        assert_equal(save("/b", "second"), false);
+        assert_equal(errno, ENOSPC);
+        assert_equal(save("/c", "third"), true);
+    }
+
+    assert_equal(t1_fault_calls(faults, t1_sys_write), 3u);
+    assert_equal(faults->log.size, 1u);
+    assert_equal(faults->log[0].number, 2u);
+    assert_equal(t1_vfs_file_size(&vfs, "/b"), 0);
+    assert_equal(t1_vfs_open_files(&vfs), 0u);
+}
+
+define_fault_test(fsync_fails)
+{
+    t1_vfs vfs;
+    init(&vfs);
+    defer { free(&vfs); };
+
+    t1_fail_nth(faults, t1_sys_fsync, 1, EIO);
+
+    t1_with_vfs(&vfs)
+    {
+        assert_equal(save("/a", "data"), false);
+        assert_equal(errno, EIO);
+    }
+
+    assert_equal(vfs.stats.fsyncs, 0u);
+    assert_equal(t1_vfs_open_files(&vfs), 0u);
+}
+
+define_fault_test(short_counts_and_eintr)
+{
+    t1_vfs vfs;
+    init(&vfs);
+    defer { free(&vfs); };
+
+    t1_short_randomly(faults, t1_sys_write, 0.5);
+    t1_fail_randomly(faults, t1_sys_write, 0.2, EINTR);
+
+    const char *text = "the quick brown fox jumps over the lazy dog";
+
+    t1_with_vfs(&vfs)
+    {
+        for (int i = 0; i < 20; ++i)
+            assert_equal(save("/f", text), true);
+    }
+
+    assert_vfs_file(&vfs, "/f", text, strlen(text));
+    assert_greater(faults->log.size, 0u);
+}
+
+define_fault_test(short_read_max_count)
+{
+    t1_vfs vfs;
+    init(&vfs);
+    defer { free(&vfs); };
+    t1_vfs_write_file(&vfs, "/f", "abcdef", 6);
+
+    t1_short_nth(faults, t1_sys_read, 1, 2);
+
+    char buf[8] = {};
+
+    t1_with_vfs(&vfs)
+    {
+        int fd = open("/f", O_RDONLY);
+        assert_equal(read(fd, buf, sizeof(buf)), 2);
+        assert_equal(read(fd, buf + 2, sizeof(buf) - 2), 4);
+        close(fd);
+    }
+
+    assert_equal(strcmp(buf, "abcdef"), 0);
+    assert_equal(faults->log[0].requested, 8u);
+    assert_equal(faults->log[0].count, 2u);
+}
+
+static u64 count_faults(u64 seed)
+{
+    t1_faults f;
+    init(&f, seed);
+    defer { free(&f); };
+    t1_fail_randomly(&f, t1_sys_any, 0.3, EIO);
+
+    u64 pattern = 0;
+
+    t1_with_faults(&f)
+    {
+        for (int i = 0; i < 64; ++i)
+            if (access("/", F_OK) == -1)
+                pattern |= 1ull << i;
+    }
+
+    return pattern;
+}
+
+define_test(same_seed_same_faults)
+{
+    assert_equal(count_faults(7), count_faults(7));
+    assert_not_equal(count_faults(7), count_faults(8));
+}
+#endif
+
+define_default_test_main();
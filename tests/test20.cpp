@@ -0,0 +1,169 @@
+// workers that can't connect give up right away
+#define t1_WORKER_CONNECT_SECONDS 0
+#include <t1/t1.hpp>
+
+// --coordinate <socket> hands the units out to worker processes one at a
+// time, slowest first, and merges their results:
+//
+//    test20 --coordinate /tmp/test20.sock --workers 4
+//
+// more workers can join with test20 --worker /tmp/test20.sock.
+
+#if t1_Linux
+static void coordinated_pass()
+{
+    assert_equal(1 + 1, 2);
+}
+
+static void coordinated_slow()
+{
+    ::usleep(20000);
+    assert_equal(2 * 2, 4);
+}
+
+static void coordinated_fail()
+{
+    assert_equal(1 + 1, 3);
+}
+
+static void coordinated_crash()
+{
+    ::abort();
+}
+
+define_test(coordinator_merges_results)
+{
+    const char *costs = "test20.costs.tmp";
+    ::unlink(costs);
+
+    t1_unit units[] = {
+        t1_unit{"pass", coordinated_pass, "test20.cpp", 1},
+        t1_unit{"slow", coordinated_slow, "test20.cpp", 2},
+        t1_unit{"fail", coordinated_fail, "test20.cpp", 3},
+        t1_unit{"crash", coordinated_crash, "test20.cpp", 4}
+    };
+
+    // coordinates its own units, quietly
+    u32 results[5] = {};
+    int status = t1_run_in_child(units, 4, [&]
+    {
+        t1_tests::coordinate_workers = 2;
+        t1_tests::costs_path = costs;
+
+        results[0] = (u32)t1_coordinate("test20.sock.tmp");
+        results[1] = t1_tests::total_units;
+        results[2] = t1_tests::total_units_failed;
+        results[3] = t1_tests::total_asserts;
+        results[4] = t1_tests::total_asserts_failed;
+        return 0;
+    }, results, sizeof(results));
+
+    assert_equal(status, 0);
+    assert_equal(results[0], 0u); // started
+    assert_equal(results[1], 4u); // units
+    assert_equal(results[2], 2u); // failed: fail and crash
+    assert_equal(results[3], 3u); // asserts
+    assert_equal(results[4], 1u); // asserts failed
+
+    // the time of every unit that finished is kept for the next run
+    t1_mapped_file f{};
+    assert_equal(t1_map_file(costs, &f), true);
+
+    if (f.data != nullptr)
+    {
+        t1_string text = t1_tprintf("%.*s", (int)f.size, f.data);
+        assert_not_equal((void*)strstr(text.data, "\tslow\n"), (void*)nullptr);
+        assert_equal((void*)strstr(text.data, "\tcrash\n"), (void*)nullptr);
+        t1_unmap_file(&f);
+    }
+
+    ::unlink(costs);
+}
+
+static const char *stuck_socket = "test20.stuck.sock.tmp";
+
+// replacement workers can't connect anymore
+static void coordinated_unlink_socket()
+{
+    ::unlink(stuck_socket);
+}
+
+// runs units with one local worker in a child, returns {started, units,
+// units failed}
+static void coordinate_in_child(const t1_unit *units, u32 unit_count, const char *costs, const char *socket, u32 *results)
+{
+    results[0] = 100;
+
+    t1_run_in_child(units, unit_count, [&]
+    {
+        // in case the coordinator never finishes
+        ::alarm(30);
+
+        t1_tests::coordinate_workers = 1;
+        t1_tests::costs_path = costs;
+
+        results[0] = (u32)t1_coordinate(socket);
+        results[1] = t1_tests::total_units;
+        results[2] = t1_tests::total_units_failed;
+        return 0;
+    }, results, 3 * sizeof(u32));
+}
+
+define_test(coordinator_fails_units_without_workers)
+{
+    // unlinking the socket runs first, then every crash takes the worker
+    // down and its replacements die right away
+    const char *costs = "test20.stuck.costs.tmp";
+    const char *known_costs = "9\tunlink\n1\tcrash1\n1\tcrash2\n1\tcrash3\n";
+    assert_equal(t1_write_file_atomic(costs, known_costs, strlen(known_costs)), true);
+    defer { ::unlink(costs); };
+
+    t1_unit units[] = {
+        t1_unit{"unlink", coordinated_unlink_socket, "test20.cpp", 1},
+        t1_unit{"crash1", coordinated_crash, "test20.cpp", 2},
+        t1_unit{"crash2", coordinated_crash, "test20.cpp", 3},
+        t1_unit{"crash3", coordinated_crash, "test20.cpp", 4}
+    };
+
+    u32 results[3] = {};
+    coordinate_in_child(units, 4, costs, stuck_socket, results);
+
+    assert_equal(results[0], 0u); // started and finished
+    assert_equal(results[1], 4u); // units
+    assert_equal(results[2], 3u); // failed: the crashes, run or not
+}
+
+#if t1_PROFILER
+static void coordinated_spin()
+{
+    timespec start;
+    timespec now;
+    t1_get_time(&start);
+
+    do
+        t1_get_time(&now);
+    while (t1_get_seconds_difference(&start, &now) < 0.1);
+}
+
+define_test(workers_write_profiles)
+{
+    const char *profile = t1_PROFILE_DIRECTORY "/test20.cpp.spin.folded";
+    const char *costs = "test20.profile.costs.tmp";
+    ::unlink(profile);
+    defer { ::unlink(profile); ::unlink(costs); };
+
+    t1_unit units[] = {t1_unit{"spin", coordinated_spin, "test20.cpp", 1}};
+
+    t1_tests::profile_hz = 997;
+    u32 results[3] = {};
+    coordinate_in_child(units, 1, costs, "test20.profile.sock.tmp", results);
+    t1_tests::profile_hz = 0;
+
+    assert_equal(results[0], 0u);
+    assert_equal(results[2], 0u);
+    assert_equal(::access(profile, F_OK), 0);
+}
+#endif
+#endif
+
+define_default_test_main();
@@ -0,0 +1,151 @@
+#include <t1/t1.hpp>
+
+// --record-impact records which functions each unit runs, later runs only
+// run the units that ran a changed function:
+//
+//    test21 --record-impact
+//    test21 --changed 'impact_parse*'
+//    test21 --changed-binary
+
+#if t1_IMPACT
+[[gnu::noinline]] static int impact_parse_number(const char *str)
+{
+    int n = 0;
+
+    while (*str >= '0' && *str <= '9')
+        n = n * 10 + (*str++ - '0');
+
+    return n;
+}
+
+[[gnu::noinline]] static int impact_format_number(int n, char *out)
+{
+    return ::snprintf(out, 16, "%d", n);
+}
+
+static void impact_parses()
+{
+    assert_equal(impact_parse_number("123"), 123);
+}
+
+static void impact_formats()
+{
+    char buf[16];
+    assert_equal(impact_format_number(42, buf), 2);
+}
+
+static void impact_both()
+{
+    char buf[16];
+    assert_equal(impact_format_number(impact_parse_number("7"), buf), 1);
+}
+
+define_test(impact_selects_units_of_changed_functions)
+{
+    const char *index = "test21.impact.tmp";
+    ::unlink(index);
+
+    t1_unit units[] = {
+        t1_unit{"parses", impact_parses, "test21.cpp", 1},
+        t1_unit{"formats", impact_formats, "test21.cpp", 2},
+        t1_unit{"both", impact_both, "test21.cpp", 3}
+    };
+
+    // records and selects its own units, quietly
+    u8 results[10] = {};
+    int status = t1_run_in_child(units, 3, [&]
+    {
+        // in case this run records too
+        _t1_impact_map = nullptr;
+        *_t1_get_impact_recorder() = _t1_impact_recorder{};
+
+        t1_tests::record_impact = true;
+        t1_tests::impact_index_path = index;
+        t1_tests::run();
+        t1_tests::record_impact = false;
+
+        // built without -fsanitize-coverage=trace-pc nothing is recorded
+        t1_mapped_file file{};
+
+        if (t1_map_file(index, &file))
+        {
+            const t1_impact_header *header = (const t1_impact_header*)file.data;
+            const t1_impact_unit *recorded = (const t1_impact_unit*)((const t1_impact_entry*)(header + 1) + header->entry_count);
+            results[9] = recorded[0].recorded;
+            t1_unmap_file(&file);
+        }
+
+        // by demangled name
+        t1_add_at_end(&t1_tests::changed, "impact_parse*");
+        t1_select_impacted_units();
+
+        for (u64 i = 0; i < 3 && t1_tests::impacted.size == 3; ++i)
+            results[i] = t1_tests::impacted[i];
+
+        // by mangled name
+        t1_tests::changed.size = 0;
+        t1_add_at_end(&t1_tests::changed, "_Z*impact_format_number*");
+        t1_select_impacted_units();
+
+        for (u64 i = 0; i < 3 && t1_tests::impacted.size == 3; ++i)
+            results[3 + i] = t1_tests::impacted[i];
+
+        // nothing changed since recording
+        t1_tests::changed.size = 0;
+        t1_tests::changed_binary = true;
+        t1_select_impacted_units();
+
+        for (u64 i = 0; i < 3 && t1_tests::impacted.size == 3; ++i)
+            results[6 + i] = t1_tests::impacted[i];
+
+        return 0;
+    }, results, sizeof(results));
+
+    assert_equal(status, 0);
+    ::unlink(index);
+
+    if (!results[9])
+    {
+        // every unit is selected
+        for (u64 i = 0; i < 9; ++i)
+            assert_equal(results[i], 1);
+
+        return;
+    }
+
+    // parses, formats, both
+    assert_equal(results[0], 1);
+    assert_equal(results[1], 0);
+    assert_equal(results[2], 1);
+
+    assert_equal(results[3], 0);
+    assert_equal(results[4], 1);
+    assert_equal(results[5], 1);
+
+    assert_equal(results[6], 0);
+    assert_equal(results[7], 0);
+    assert_equal(results[8], 0);
+}
+
+define_test(impact_is_not_recorded_by_workers)
+{
+    // checks quietly, exits with 0 if both combinations are rejected
+    int status = t1_run_in_child(nullptr, 0, []
+    {
+        t1_tests::record_impact = true;
+        t1_tests::coordinate_path = "test21.sock.tmp";
+        bool coordinated = t1_check_arguments();
+
+        t1_tests::coordinate_path = nullptr;
+        t1_tests::worker_path = "test21.sock.tmp";
+        bool worked = t1_check_arguments();
+
+        return coordinated || worked ? 1 : 0;
+    });
+
+    assert_equal(status, 0);
+}
+
+#endif
+
+define_default_test_main();
@@ -0,0 +1,65 @@
+#include <t1/t1.hpp>
+
+// --perf-counters measures every unit with the hardware counters of its
+// thread:
+//
+//    test22 --perf-counters -v
+
+[[gnu::noinline]] static u64 sum_of_squares(u64 n)
+{
+    volatile u64 sum = 0;
+
+    for (u64 i = 0; i < n; ++i)
+        sum = sum + i * i;
+
+    return sum;
+}
+
+define_test(perf_group_counts_instructions)
+{
+    t1_perf_group g{};
+
+    // e.g. perf_event_paranoid or no PMU in a VM
+    if (!t1_perf_open(&g))
+        return;
+
+    t1_perf_values values{};
+    t1_perf_start(&g);
+    sum_of_squares(100000);
+    t1_perf_stop(&g, &values);
+
+    int leader = g.leader;
+    t1_perf_close(&g);
+    assert_equal(::fcntl(leader, F_GETFD), -1);
+
+    if (!values.available[t1_perf_instructions])
+        return;
+
+    // at least an instruction per iteration
+    assert_greater_or_equal(values.values[t1_perf_instructions], 100000ull);
+}
+
+#if !t1_Windows
+define_test(unopened_perf_group_closes_nothing)
+{
+    int fds[2];
+    assert_equal(::pipe(fds), 0);
+
+    // in case stdin is closed already
+    bool borrowed = ::fcntl(0, F_GETFD) == -1 && ::dup2(fds[0], 0) == 0;
+
+    // e.g. the group of a thread that exits without having run a unit
+    t1_perf_group g{};
+    t1_perf_close(&g);
+
+    assert_not_equal(::fcntl(0, F_GETFD), -1);
+
+    if (borrowed)
+        ::close(0);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+#endif
+
+define_default_test_main();
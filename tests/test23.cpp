@@ -0,0 +1,106 @@
+#include <t1/t1.hpp>
+
+// --capture redirects stdout and stderr of every unit and only shows the
+// output of units that fail, after their name:
+//
+//    test23 --capture --capture-limit 4096
+
+#if t1_Linux
+static void quiet_unit()
+{
+    printf("output of the passing unit\n");
+    fprintf(stderr, "errors of the passing unit\n");
+    assert_equal(1, 1);
+}
+
+static void noisy_unit()
+{
+    printf("output of the failing unit\n");
+    fprintf(stderr, "errors of the failing unit\n");
+    assert_equal(1, 2);
+}
+
+define_test(capture_shows_output_of_failing_units)
+{
+    t1_unit units[] = {
+        t1_unit{"quiet", quiet_unit, "test23.cpp", 1},
+        t1_unit{"noisy", noisy_unit, "test23.cpp", 2}
+    };
+
+    t1_array<char> output;
+    init(&output);
+    defer { free(&output); };
+
+    // runs its own units, keeping the output
+    int status = t1_run_in_child(units, 2, []
+    {
+        t1_tests::capture_output = true;
+        t1_tests::run();
+        return 0;
+    }, nullptr, 0, &output);
+
+    t1_add_at_end(&output, '\0');
+    assert_equal(status, 0);
+
+    const char *begin = strstr(output.data, "captured output of noisy");
+    const char *end = strstr(output.data, "end of captured output of noisy");
+
+    assert_not_equal(begin, nullptr);
+    assert_not_equal(end, nullptr);
+
+    if (begin == nullptr || end == nullptr)
+        return;
+
+    const char *out = strstr(begin, "output of the failing unit");
+    const char *err = strstr(begin, "errors of the failing unit");
+
+    // both streams, between the markers of the failing unit
+    assert_not_equal(out, nullptr);
+    assert_not_equal(err, nullptr);
+    assert_less(out, end);
+    assert_less(err, end);
+
+    assert_equal(strstr(output.data, "captured output of quiet"), nullptr);
+    assert_equal(strstr(output.data, "of the passing unit"), nullptr);
+}
+
+static void fails_once()
+{
+    // ~250 bytes per iteration
+    for (int i = 0; i < 10; ++i)
+        printf("output of iteration %llu\n", (unsigned long long)t1_tests::current_iteration);
+
+    assert_not_equal(t1_tests::current_iteration, 50ull);
+}
+
+define_test(capture_of_repeated_units_shows_failing_iteration)
+{
+    t1_unit units[] = {t1_unit{"fails_once", fails_once, "test23.cpp", 1}};
+
+    t1_array<char> output;
+    init(&output);
+    defer { free(&output); };
+
+    // all iterations together have more output than the limit
+    int status = t1_run_in_child(units, 1, []
+    {
+        t1_tests::capture_output = true;
+        t1_tests::capture_limit = 4096;
+        t1_tests::repeat_count = 100;
+        t1_tests::jobs = 4;
+        t1_tests::run();
+        return 0;
+    }, nullptr, 0, &output);
+
+    t1_add_at_end(&output, '\0');
+    assert_equal(status, 0);
+
+    // only the failing iteration, whole
+    assert_not_equal(strstr(output.data, "output of iteration 50\n"), nullptr);
+    assert_not_equal(strstr(output.data, "assert_not_equal(t1_tests::current_iteration"), nullptr);
+    assert_equal(strstr(output.data, "output of iteration 49\n"), nullptr);
+    assert_equal(strstr(output.data, "bytes omitted"), nullptr);
+}
+#endif
+
+define_default_test_main();
@@ -0,0 +1,107 @@
+#include <t1/t1.hpp>
+
+// --serve keeps the executable running and runs the units a client asks
+// for, --connect is the client:
+//
+//    test24 --serve /tmp/test24.sock &
+//    test24 --connect /tmp/test24.sock -v -f "served_*"
+
+#if t1_Linux
+static void served_pass()
+{
+    assert_equal(1 + 1, 2);
+}
+
+static void served_binary_output()
+{
+    // output may contain any byte
+    t1_io_write(_stdout(), (void*)"zero\0byte", 9);
+    assert_equal(1 + 1, 3);
+}
+
+// runs t1_connect in a child, returns its exit status and output
+static int connect_with(const char *path, int argc, const char *argv[], t1_array<char> *output)
+{
+    return t1_run_in_child(nullptr, 0, [&] { return t1_connect(path, argc, argv); }, nullptr, 0, output);
+}
+
+static int connect_to(const char *path, const char *filter, t1_array<char> *output)
+{
+    const char *argv[] = {"test24", "-f", filter};
+    return connect_with(path, 3, argv, output);
+}
+
+static bool contains(const t1_array<char> *output, const char *str)
+{
+    return ::memmem(output->data, output->size, str, strlen(str)) != nullptr;
+}
+
+define_test(serve_runs_requested_units)
+{
+    const char *path = "test24.sock.tmp";
+    ::unlink(path);
+
+    t1_unit units[] = {
+        t1_unit{"served_pass", served_pass, "test24.cpp", 1},
+        t1_unit{"served_binary_output", served_binary_output, "test24.cpp", 2}
+    };
+
+    // serves its own units, quietly
+    t1_child server;
+    bool started = t1_start_child(&server, units, 2, [&] { return t1_serve(path, "test24.cpp"); },
+                                  nullptr, 0, false);
+    assert_equal(started, true);
+
+    // until the server listens
+    for (int i = 0; i < 500 && ::access(path, F_OK) != 0; ++i)
+        ::usleep(10000);
+
+    t1_array<char> output;
+    init(&output);
+    defer { free(&output); };
+
+    assert_equal(connect_to(path, "served_pass", &output), 0);
+    assert_equal(contains(&output, " of 1 ("), true);
+
+    output.size = 0;
+    assert_equal(connect_to(path, "served_binary_*", &output), 1);
+
+    const char *zero = (const char*)::memmem(output.data, output.size, "zero\0byte", 9);
+    assert_equal(zero != nullptr, true);
+
+    // the summary still follows
+    if (zero != nullptr)
+        assert_equal(::memmem(zero, (u64)(output.data + output.size - zero), "summary of", 10) != nullptr, true);
+
+    // the options of a request don't stick
+    output.size = 0;
+    assert_equal(connect_to(path, "*", &output), 1);
+    assert_equal(contains(&output, " of 2 ("), true);
+
+    // units are selected by impact per request
+    const char *impact[] = {"test24", "-f", "served_pass", "--changed", "served_*", "--impact-index", "test24.impact.tmp"};
+    output.size = 0;
+    assert_equal(connect_with(path, 7, impact, &output), 0);
+#if t1_IMPACT
+    assert_equal(contains(&output, "no impact index test24.impact.tmp"), true);
+#else
+    assert_equal(contains(&output, "impact analysis is not supported"), true);
+#endif
+
+    output.size = 0;
+    assert_equal(connect_to(path, "served_pass", &output), 0);
+    assert_equal(contains(&output, "impact"), false);
+
+    const char *quit = "quit";
+    int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    _t1_make_socket_address(path, &addr);
+    assert_equal(::connect(sock, (sockaddr*)&addr, sizeof(addr)), 0);
+    assert_equal(::write(sock, quit, 4), (ssize_t)4);
+    ::close(sock);
+
+    assert_equal(t1_wait_child(&server, nullptr, 0, nullptr), 0);
+}
+#endif
+
+define_default_test_main();
@@ -0,0 +1,93 @@
+
+#include <t1/t1.hpp>
+
+// units can be repeated in-process using --repeat N, --until-fail and
+// --jobs N, e.g.
+//
+//    test6 --repeat 1000 --jobs 0 --filter "flaky*"
+//
+// t1_tests::current_seed is different for every iteration and may be used
+// to seed random number generators, a failing iteration can be reproduced
+// by passing its seed with --seed.
+
+define_test(repeated)
+{
+    assert_equal(t1_tests::current_seed, t1_tests::seed + t1_tests::current_iteration);
+    assert_less(t1_tests::current_iteration, 100u);
+}
+
+define_test(other_unit)
+{
+    assert_equal(1, 1);
+}
+
+#if t1_Linux
+static void always_fails()
+{
+    assert_equal(1, 2);
+}
+
+static void fails_every_other_iteration()
+{
+    assert_equal(t1_tests::current_iteration % 2, 0u);
+}
+
+static void always_passes()
+{
+    assert_equal(1, 1);
+}
+
+define_test(flaky_units_are_detected)
+{
+    // once is enough
+    if (t1_tests::current_iteration != 0)
+        return;
+
+    t1_unit units[] = {
+        t1_unit{"always_fails", always_fails, "test6.cpp", 1},
+        t1_unit{"fails_every_other_iteration", fails_every_other_iteration, "test6.cpp", 2},
+        t1_unit{"always_passes", always_passes, "test6.cpp", 3}
+    };
+
+    // repeats its own units, quietly
+    u8 results[7] = {};
+    int status = t1_run_in_child(units, 3, [&]
+    {
+        t1_tests::repeat_count = 10;
+        t1_tests::jobs = 1;
+        t1_tests::run();
+
+        results[0] = (u8)t1_tests::repeat_results.size;
+
+        for (u64 i = 0; i < t1_tests::repeat_results.size && i < 3; ++i)
+        {
+            t1_repeat_result *res = t1_tests::repeat_results.data + i;
+            results[1 + i * 2] = (u8)res->iterations_failed;
+            results[2 + i * 2] = t1_is_flaky(res);
+        }
+
+        return 0;
+    }, results, sizeof(results));
+
+    assert_equal(status, 0);
+    assert_equal(results[0], 3);
+
+    // failing every iteration is not flaky
+    assert_equal(results[1], 10);
+    assert_equal(results[2], 0);
+
+    assert_equal(results[3], 5);
+    assert_equal(results[4], 1);
+
+    assert_equal(results[5], 0);
+    assert_equal(results[6], 0);
+}
+#endif
+
+static void setup()
+{
+    t1_tests::repeat_count = 100;
+    t1_tests::jobs = 4;
+}
+
+define_test_main(setup, t1_nop);
@@ -0,0 +1,117 @@
+
+// with t1_track_allocations defined, t1 counts the heap calls of every unit
+// and the allocation budget asserts can be used.
+#define t1_track_allocations
+#include <t1/t1.hpp>
+
+static int sum(int *values, int count)
+{
+    int ret = 0;
+
+    for (int i = 0; i < count; ++i)
+        ret += values[i];
+
+    return ret;
+}
+
+define_test(no_allocations)
+{
+    int values[4] = {1, 2, 3, 4};
+
+    assert_max_allocations(0)
+    {
+        assert_equal(sum(values, 4), 10);
+    }
+}
+
+define_test(bounded_allocations)
+{
+    assert_max_allocations(2)
+    assert_max_bytes_allocated(64)
+    {
+        int *a = new int[4];
+        int *b = (int*)::malloc(sizeof(int) * 4);
+
+        delete[] a;
+        ::free(b);
+    }
+}
+
+define_test(aligned_allocations)
+{
+    s64 live_bytes = _t1_get_allocation_state()->stats.live_bytes;
+
+    assert_max_allocations(3)
+    {
+        void *a = nullptr;
+        assert_equal(::posix_memalign(&a, 64, 100), 0);
+        void *b = ::aligned_alloc(128, 256);
+        void *c = ::memalign(32, 10);
+
+        assert_equal((u64)a % 64, 0ull);
+        assert_equal((u64)b % 128, 0ull);
+        assert_equal((u64)c % 32, 0ull);
+
+        ::free(a);
+        ::free(b);
+        ::free(c);
+    }
+
+    // freeing them doesn't subtract memory that wasn't counted
+    assert_equal(_t1_get_allocation_state()->stats.live_bytes, live_bytes);
+}
+
+define_test(async_output_is_not_counted)
+{
+    t1_reporter_start();
+
+    // the first output of the thread makes its queue
+    assert_max_allocations(0)
+    {
+        t1_output_write("\n", 1);
+    }
+}
+
+#if t1_Linux
+static void over_budget()
+{
+    assert_max_allocations(1)
+    {
+        int *a = new int;
+        int *b = new int;
+
+        delete a;
+        delete b;
+    }
+}
+
+define_test(exceeded_budget_fails)
+{
+    t1_unit units[] = {t1_unit{"over_budget", over_budget, "test7.cpp", 1}};
+
+    t1_array<char> output;
+    init(&output);
+    defer { free(&output); };
+
+    // runs its own unit, keeping the output
+    u32 results[2] = {};
+    int status = t1_run_in_child(units, 1, [&]
+    {
+        t1_tests::run();
+        results[0] = t1_tests::total_units_failed;
+        results[1] = t1_tests::total_asserts_failed;
+        return 0;
+    }, results, sizeof(results), &output);
+
+    t1_add_at_end(&output, '\0');
+
+    assert_equal(status, 0);
+    assert_equal(results[0], 1u);
+    assert_equal(results[1], 1u);
+
+    // the allocations of failing units are reported too, without -v
+    assert_not_equal(strstr(output.data, " 2 allocations, peak "), nullptr);
+}
+#endif
+
+define_default_test_main();
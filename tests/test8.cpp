@@ -0,0 +1,97 @@
+
+#include <t1/t1.hpp>
+
+// async units are coroutines which all run concurrently on one event loop,
+// so the sleeps below take ~50ms in total instead of ~100ms.
+
+define_async_test(sleeps)
+{
+    co_await t1_sleep(50);
+    co_assert_equal(1, 1);
+}
+
+define_async_test(other_sleeps)
+{
+    co_await t1_sleep(25);
+    co_await t1_sleep(25);
+    co_assert_equal(2, 2);
+}
+
+static t1_async_task write_later(int fd)
+{
+    co_await t1_sleep(10);
+    co_assert_equal(::write(fd, "hello", 5), 5);
+}
+
+define_async_test(pipe_readable)
+{
+    int fds[2];
+    co_assert_equal(::pipe(fds), 0);
+    defer { ::close(fds[0]); ::close(fds[1]); };
+
+    // nothing written yet
+    co_assert_equal(co_await t1_wait_readable(fds[0], 0), false);
+
+    co_await write_later(fds[1]);
+
+    co_assert_equal(co_await t1_wait_readable(fds[0], 1000), true);
+
+    char buf[8] = {};
+    co_assert_equal(::read(fds[0], buf, sizeof(buf)), 5);
+}
+
+define_test(regular)
+{
+    assert_equal(1, 1);
+}
+
+#if t1_Linux
+// death checks of async units are evaluated when the unit is done
+define_async_test(dies_asynchronously)
+{
+    assert_exit(::_exit(3), 3);
+    co_await t1_sleep(10);
+    co_assert_equal(1, 1);
+}
+
+static t1_async_task wrong_death()
+{
+    assert_exit(::_exit(4), 3);
+    co_await t1_sleep(20);
+}
+
+static t1_async_task right_death()
+{
+    co_await t1_sleep(10);
+    assert_exit(::_exit(3), 3);
+    co_await t1_sleep(20);
+}
+
+define_test(async_death_failures_count)
+{
+    t1_unit units[] = {
+        t1_unit{"wrong_death", nullptr, "test8.cpp", 1, wrong_death},
+        t1_unit{"right_death", nullptr, "test8.cpp", 2, right_death}
+    };
+
+    // runs its own units, quietly
+    u32 results[3] = {};
+    int status = t1_run_in_child(units, 2, [&]
+    {
+        t1_tests::run();
+        results[0] = t1_tests::total_units_failed;
+        results[1] = t1_tests::total_asserts;
+        results[2] = t1_tests::total_asserts_failed;
+        return 0;
+    }, results, sizeof(results));
+
+    assert_equal(status, 0);
+
+    // only the unit with the wrong expectation fails
+    assert_equal(results[0], 1u);
+    assert_equal(results[1], 2u);
+    assert_equal(results[2], 1u);
+}
+#endif
+
+define_default_test_main();
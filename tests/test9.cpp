@@ -0,0 +1,23 @@
+
+#include <t1/t1.hpp>
+#include <signal.h>
+
+// death checks run in forked children; all checks of a unit run
+// concurrently and are evaluated when the unit ends.
+
+static void crash()
+{
+    fprintf(stderr, "fatal: something went wrong\n");
+    ::abort();
+}
+
+define_test(deaths)
+{
+    assert_death(crash(), t1_killed_by(SIGABRT), "fatal: *wrong");
+    assert_death(::exit(3), t1_exited(3), nullptr);
+    assert_dies(crash());
+    assert_exit(::_exit(7), 7);
+    assert_signal(::raise(SIGTERM), SIGTERM);
+}
+
+define_default_test_main();